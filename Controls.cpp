@@ -10,13 +10,21 @@
 #include "Evaluator.h"
 #include "Interface.h"
 #include "Presets.h"
+#include "Tracing.h"
+#include <algorithm>
+#include <vector>
 
 #pragma region ITextEdit 
 ITextEdit::ITextEdit(IPlugBase* pPlug, IRECT pR, int paramIdx, IText* pText, const char* str, ETextEntryOptions textEntryOptions)
 	: IControl(pPlug, pR)
 	, mIdx(paramIdx)
-	, mStr(str, kExpressionLengthMax)
+	, mStr(str)
 {
+	if (mStr.size() > kExpressionLengthMax)
+	{
+		mStr.resize(kExpressionLengthMax);
+	}
+
 	mDisablePrompt = true;
 	mText = *pText;
 	mTextEntryLength = kExpressionLengthMax;
@@ -30,9 +38,9 @@ bool ITextEdit::Draw(IGraphics* pGraphics)
 	pGraphics->FillIRect(&mText.mTextEntryBGColor, &mRECT);
 	IRECT textRect = mRECT.GetHPadded(-3);
 
-	// copy into fixed-size buffer because DrawIText needs a non-const string
-	char textEditText[kExpressionLengthMax];
-	strncpy(textEditText, mStr.c_str(), kExpressionLengthMax - 1);
+	// copy into a buffer because DrawIText needs a non-const string
+	std::vector<char> textEditBuffer(mStr.c_str(), mStr.c_str() + mStr.size() + 1);
+	char* textEditText = textEditBuffer.data();
 
 #if defined(OS_OSX)
   // line spacing is too large when rendering on High Sierra (and presumably Mojave as well)
@@ -70,13 +78,18 @@ void ITextEdit::OnMouseDown(int x, int y, IMouseMod* pMod)
 	entryRect.L += 3;
 	entryTextStyle.mSize -= 4;
 #elif defined(OS_WIN)
-	size_t pos = mStr.find('\n');
-	while (pos != std::string::npos)
+	// build a new string rather than inserting in place, which would be quadratic for long programs
+	std::string windowsStr;
+	windowsStr.reserve(mStr.size() + mStr.size() / 16);
+	for (const char c : mStr)
 	{
-		mStr.replace(pos, 1, "\r\n");
-		// start searching from pos+2 because we inserted 2 characters and don't want to find the \n we just inserted
-		pos = mStr.find('\n', pos + 2);
+		if (c == '\n')
+		{
+			windowsStr += '\r';
+		}
+		windowsStr += c;
 	}
+	mStr.swap(windowsStr);
 	entryText = mStr.c_str();
 #endif
 	mPlug->GetGUI()->CreateTextEntry(this, &entryTextStyle, &entryRect, entryText);
@@ -92,12 +105,7 @@ void ITextEdit::TextFromTextEntry(const char* txt)
   // we always do this because we want to keep our input string clean.
   // just because we are on OSX doesn't mean a user can't load a file that contains \r\n
 	std::string input(txt);
-	size_t pos = input.find('\r');
-	while (pos != std::string::npos)
-	{
-		input.erase(pos, 1);
-		pos = input.find('\r');
-	}
+	input.erase(std::remove(input.begin(), input.end(), '\r'), input.end());
 
 	// don't set if it is the same, we don't want the project to become modified in this case
 	if (mStr != input)
@@ -234,6 +242,68 @@ void ConsoleText::SetTextFromPlug(const char * text)
 }
 #pragma  endregion ConsoleText
 
+#pragma region ConsoleTitle
+static const char* kConsoleModeTitles[kConsoleModeCount] = { "AUTO", "COST", "BLOCK TIME", "TRACE", "RECORD", "MEMORY" };
+ConsoleTitle::ConsoleTitle(IPlugBase* pPlug, IRECT rect, IText* textStyle, Interface* pInterface)
+	: IControl(pPlug, rect)
+	, mInterface(pInterface)
+	, mMode(kConsoleModeState)
+{
+	SetText(textStyle);
+	mDblAsSingleClick = true;
+}
+
+bool ConsoleTitle::Draw(IGraphics* pGraphics)
+{
+	pGraphics->DrawIText(&mText, const_cast<char*>(kConsoleModeTitles[mMode]), &mRECT);
+
+	return true;
+}
+
+void ConsoleTitle::OnMouseDown(int x, int y, IMouseMod* pMod)
+{
+	if (pMod->R)
+	{
+		switch (mMode)
+		{
+		case kConsoleModeLatency:
+			mInterface->ExportBlockTimes();
+			break;
+
+		case kConsoleModeTrace:
+			mInterface->ToggleTracing();
+			break;
+
+		case kConsoleModeRecord:
+			mInterface->ToggleRecording();
+			break;
+
+		case kConsoleModeMemory:
+			if (pMod->S)
+			{
+				mInterface->ToggleSharedMemory();
+			}
+			else
+			{
+				mInterface->ToggleSaveProgramMemory();
+			}
+			break;
+
+		case kConsoleModeCost:
+			mInterface->CycleValueWidth();
+			break;
+
+		default:
+			break;
+		}
+		return;
+	}
+
+	mMode = (ConsoleMode)((mMode + 1) % kConsoleModeCount);
+	SetDirty(false);
+}
+#pragma  endregion ConsoleTitle
+
 #pragma region EnumControl (used for RunMode)
 EnumControl::EnumControl(IPlugBase* pPlug, IRECT rect, int paramIdx, IText* textStyle)
 	: IControl(pPlug, rect, paramIdx)
@@ -306,6 +376,9 @@ Oscilloscope::~Oscilloscope()
 
 bool Oscilloscope::Draw(IGraphics* pGraphics)
 {
+	Tracing::SetThreadName("ui");
+	Tracing::Scope trace("scope redraw");
+
 	pGraphics->FillIRect(&mBackgroundColor, &mRECT, &mBlend);
 
 	DrawWaveform(pGraphics);
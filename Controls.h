@@ -88,6 +88,25 @@ private:
 	ITextControl  mText;
 };
 
+// title above the console that shows which ConsoleMode is active and cycles to the next one when clicked.
+// right-clicking it in the latency mode exports the block time histogram,
+// in the trace mode it starts or stops recording a trace,
+// and in the memory mode it toggles saving the program memory with the plugin state.
+class ConsoleTitle : public IControl
+{
+public:
+	ConsoleTitle(IPlugBase* pPlug, IRECT rect, IText* textStyle, Interface* pInterface);
+
+	bool Draw(IGraphics* pGraphics) override;
+	void OnMouseDown(int x, int y, IMouseMod* pMod) override;
+
+	ConsoleMode GetConsoleMode() const { return mMode; }
+
+private:
+	Interface* mInterface;
+	ConsoleMode mMode;
+};
+
 class EnumControl : public IControl
 {
 public:
@@ -115,6 +134,8 @@ public:
 	bool Draw(IGraphics* pGraphics) override;
 
 	void AddSample(double left, double right);
+	// bytes used by the sample buffer
+	size_t GetMemorySize() const { return mBufferSize * sizeof(double); }
 
 private:
 	
@@ -10,11 +10,34 @@
 #include "Interface.h"
 #include "IControl.h"
 #include "resource.h"
+#include "Tracing.h"
+#include "RealtimeCheck.h"
+#include "MemoryEncoding.h"
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+
+// how much weight the most recent block has in the running average of the dsp load
+static const double kLoadSmoothing = 0.05;
 
 #if SA_API
 static const char * kAboutBoxText = "Version " VST3_VER_STR "\nCreated by Damien Quartz\nBuilt on " __DATE__;
 #endif
 
+// enough room to hold every midi note without allocating on the audio thread,
+// unless the same note is held more than once.
+static const size_t kHeldNotesCapacity = 128;
+
+// how much memory a recording can use, which is over an hour of a typical session
+// but only a few minutes if the plugin is also receiving audio input.
+static const size_t kRecordingCapacity = 64 * 1024 * 1024;
+
+// footprint of every instance in the process, see GetProcessMemoryFootprint
+static std::atomic<size_t> sProcessFootprint(0);
+static std::atomic<int> sInstanceCount(0);
+
+static_assert(Program::RE_COUNT == Telemetry::kRuntimeErrorCount, "Telemetry::Counters::runtimeErrors needs a counter for every RuntimeError");
+
 Evaluator::Evaluator(IPlugInstanceInfo instanceInfo)
 	: IPLUG_CTOR(kNumParams, Presets::Count(), instanceInfo)
 	, mProgram(0)
@@ -26,9 +49,19 @@ Evaluator::Evaluator(IPlugInstanceInfo instanceInfo)
 	, mScopeUpdate(0)
 	, mRunMode(kRunModeAlways)
 	, mMidiNoteResetsTick(false)
+	, mLoadAverage(0)
+	, mLoadPeak(0)
+	, mPresetMemorySize(0)
+	, mOurStateIsValid(false)
+	, mRestoredMemoryIsPending(false)
 {
 	TRACE;
 
+	memset(&mTelemetryCounters, 0, sizeof(mTelemetryCounters));
+	memset(&mFootprint, 0, sizeof(mFootprint));
+	++sInstanceCount;
+	mNotes.reserve(kHeldNotesCapacity);
+
 	//arguments are: name, defaultVal, minVal, maxVal, step, label
 	GetParam(kGain)->InitDouble("volume", 50., 0., 100.0, 1, "%");
 
@@ -55,6 +88,18 @@ Evaluator::Evaluator(IPlugInstanceInfo instanceInfo)
 
 	GetParam(kMidiNoteResetsTime)->InitBool("midi note on sets t = 0", false);
 
+	GetParam(kSaveProgramMemory)->InitBool("save program memory", false);
+	GetParam(kSaveProgramMemory)->SetCanAutomate(false);
+
+	GetParam(kValueWidth)->InitEnum("value width", Program::VW_64, Program::VW_AUTO + 1);
+	GetParam(kValueWidth)->SetDisplayText(Program::VW_64, "64-bit");
+	GetParam(kValueWidth)->SetDisplayText(Program::VW_32, "32-bit");
+	GetParam(kValueWidth)->SetDisplayText(Program::VW_AUTO, "auto");
+	GetParam(kValueWidth)->SetCanAutomate(false);
+
+	GetParam(kSharedMemory)->InitBool("shared memory", false);
+	GetParam(kSharedMemory)->SetCanAutomate(false);
+
 	for (int i = 0; i < Presets::Count(); ++i)
 	{
 		MakePresetFromData(Presets::Get(i));
@@ -92,16 +137,31 @@ Evaluator::Evaluator(IPlugInstanceInfo instanceInfo)
 		mInterface->SetProgramName(preset.name);
 	}
 #endif
+
+	UpdateMemoryFootprint();
 }
 
 Evaluator::~Evaluator()
 {
+	sProcessFootprint -= mFootprint.total;
+	--sInstanceCount;
+
 	delete mInterface;
+	delete mProgram;
 }
 
 void Evaluator::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
 	// Mutex is already locked for us.
+	RealtimeCheck::Scope realtime;
+
+	Tracing::SetThreadName("audio");
+
+	// the program has started running, so any program compiled after this is a new one
+	mRestoredMemoryIsPending = false;
+	Tracing::Scope trace("process block");
+
+	const std::chrono::steady_clock::time_point blockStart = std::chrono::steady_clock::now();
 
 	const Program::Value range = (Program::Value)1 << mBitDepth;
 	const double mdenom = GetSampleRate() / 1000.0;
@@ -119,14 +179,46 @@ void Evaluator::ProcessDoubleReplacing(double** inputs, double** outputs, int nF
 	mProgram->Set('w', range);
 	mProgram->Set('~', (Program::Value)GetSampleRate());
 
+	// the bus is copied in before the block and the changes copied out after it,
+	// so the program sees the same values from other instances for the whole block.
+	const bool shareMemory = mProgramIsValid && GetParam(kSharedMemory)->Bool();
+	if (shareMemory)
+	{
+		mMemoryBus.Read(*mProgram, mProgramMemorySize);
+	}
+
 	double* in1 = inputs[0];
 	double* in2 = inputs[1];
 	double* out1 = outputs[0];
 	double* out2 = outputs[1];
 
-	Program::RuntimeError error = Program::RE_NONE;
+	// the program counts its runtime errors,
+	// so we compare with the counts from before this block to find out what happened during it.
+	uint64_t errorsBefore[Program::RE_COUNT];
+	for (int e = 0; e < Program::RE_COUNT; ++e)
+	{
+		errorsBefore[e] = mProgram->GetErrorCount((Program::RuntimeError)e);
+	}
+
 	ITimeInfo timeInfo;
 	GetTime(&timeInfo);
+
+	if (mRecorder.IsRecording())
+	{
+		Recording::BlockInfo block;
+		block.frameCount = nFrames;
+		block.hasInput = 0;
+		block.transportIsRunning = timeInfo.mTransportIsRunning;
+		block.sampleRate = GetSampleRate();
+		block.tempo = GetParam(kTempo)->Value();
+		block.samplePos = timeInfo.mSamplePos;
+		mRecorder.RecordBlock(block, inputs[0], inputs[1]);
+		if (shareMemory)
+		{
+			mRecorder.RecordBus(mMemoryBus.GetValues(), mMemoryBus.GetCount());
+		}
+	}
+
 	Program::Value results[2];
 	double left = 0;
 	double right = 0;
@@ -137,6 +229,12 @@ void Evaluator::ProcessDoubleReplacing(double** inputs, double** outputs, int nF
 			IMidiMsg* pMsg = mMidiQueue.Peek();
 			if (pMsg->mOffset > s) break;
 
+			if (mRecorder.IsRecording())
+			{
+				const Recording::MidiEvent event = { s, pMsg->mStatus, pMsg->mData1, pMsg->mData2 };
+				mRecorder.RecordMidi(event);
+			}
+
 			// To-do: Handle the MIDI message
 			switch (pMsg->StatusMsg())
 			{
@@ -212,7 +310,7 @@ void Evaluator::ProcessDoubleReplacing(double** inputs, double** outputs, int nF
 			mProgram->Set('q', (Program::Value)round(mTick / qdenom));
 			results[0] = (Program::Value)((*in1 + 1) * (range / 2));
 			results[1] = (Program::Value)((*in2 + 1) * (range / 2));
-			error = mProgram->Run(results, 2);
+			mProgram->Run(results, 2);
 			left = mGain * (-1.0 + 2.0*((double)(results[0] % range) / (range - 1)));
 			right = mGain * (-1.0 + 2.0*((double)(results[1] % range) / (range - 1)));
 			++mTick;
@@ -240,21 +338,124 @@ void Evaluator::ProcessDoubleReplacing(double** inputs, double** outputs, int nF
 		}
 	}
 
+	if (shareMemory)
+	{
+		mMemoryBus.Write(*mProgram, mProgramMemorySize);
+	}
+
 	mMidiQueue.Flush(nFrames);
 
+	if (mRecorder.IsRecording())
+	{
+		mRecorder.RecordOutput(outputs[0], outputs[1], nFrames);
+	}
+
+	bool hadErrors = false;
+	for (int e = 0; e < Program::RE_COUNT; ++e)
+	{
+		const uint64_t count = mProgram->GetErrorCount((Program::RuntimeError)e) - errorsBefore[e];
+		mTelemetryCounters.runtimeErrors[e] += count;
+		hadErrors = hadErrors || (e != Program::RE_NONE && count > 0);
+	}
+
+	// measure how long it took to generate the block compared to how long it will take to play it.
+	// this doesn't include updating the console, which is cheap compared to running the program.
+	if (nFrames > 0)
+	{
+		const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStart).count();
+		const double load = elapsed * GetSampleRate() / nFrames;
+		mBlockTimes.Record(elapsed);
+		mLoadAverage += (load - mLoadAverage) * kLoadSmoothing;
+		if (load > mLoadPeak)
+		{
+			mLoadPeak = load;
+		}
+
+		const uint64_t micros = (uint64_t)(elapsed * 1000000);
+		mTelemetryCounters.samplesRendered += nFrames;
+		mTelemetryCounters.blocksRendered += 1;
+		mTelemetryCounters.lastBlockMicros = micros;
+		mTelemetryCounters.maxBlockMicros = std::max(mTelemetryCounters.maxBlockMicros, micros);
+		mTelemetryCounters.averageLoad = mLoadAverage;
+		mTelemetry.Publish(mTelemetryCounters);
+	}
+
 	if (mProgramIsValid && mInterface != nullptr)
 	{
-		if (error == Program::RE_NONE)
+		if (!hadErrors)
 		{
-			mInterface->SetConsoleText(GetProgramState());
+			switch (mInterface->GetConsoleMode())
+			{
+			case kConsoleModeCost:
+				mInterface->SetConsoleText(mCostSummary.c_str());
+				break;
+
+			case kConsoleModeLatency:
+			{
+				static char summary[1024];
+				mBlockTimes.GetSummary(summary, sizeof(summary));
+				mInterface->SetConsoleText(summary);
+			}
+			break;
+
+			case kConsoleModeTrace:
+			{
+				static char status[256];
+				if (Tracing::IsRecording())
+				{
+					snprintf(status, sizeof(status), "recording: %u events\n\nright-click title to stop and save", Tracing::GetEventCount());
+				}
+				else
+				{
+					snprintf(status, sizeof(status), "not recording\n\nright-click title to start recording");
+				}
+				mInterface->SetConsoleText(status);
+			}
+			break;
+
+			case kConsoleModeMemory:
+			{
+				static char report[640];
+				GetMemoryReport(report, sizeof(report));
+				mInterface->SetConsoleText(report);
+			}
+			break;
+
+			case kConsoleModeRecord:
+			{
+				static char status[256];
+				if (mRecorder.IsRecording())
+				{
+					snprintf(status, sizeof(status), "recording: %u KB of %u KB\n\nright-click title to stop and save",
+						(unsigned)(mRecorder.GetSize() / 1024), (unsigned)(mRecorder.GetCapacity() / 1024));
+				}
+				else if (mRecorder.IsFull())
+				{
+					snprintf(status, sizeof(status), "recording is full\n\nright-click title to save it");
+				}
+				else
+				{
+					snprintf(status, sizeof(status), "not recording\n\nright-click title to start recording");
+				}
+				mInterface->SetConsoleText(status);
+			}
+			break;
+
+			default:
+				mInterface->SetConsoleText(GetProgramState());
+				break;
+			}
 		}
 		else
 		{
+			// counts are since the program was compiled, but we only show them while errors are still happening
 			static const int maxError = 1024;
 			static char errorDesc[maxError];
+			static char errorSummary[maxError];
+			mProgram->GetErrorSummary(errorSummary, maxError);
 			snprintf(errorDesc, maxError,
-				"Runtime Error: %s",
-				Program::GetErrorString(error));
+				"Runtime Error:\n\n%s",
+				errorSummary);
 			mInterface->SetConsoleText(errorDesc);
 		}
 
@@ -281,11 +482,124 @@ void Evaluator::Reset()
 	mMidiQueue.Resize(GetBlockSize());
 	mNotes.clear();
 	mScopeUpdate = 0;
+
+	if (mRecorder.IsRecording())
+	{
+		RecordState();
+	}
+
+	UpdateMemoryFootprint();
+}
+
+void Evaluator::StartRecording()
+{
+	// the audio thread waits on the lock, so the buffer is allocated before taking it,
+	// and the buffer of the last recording is freed with this one after letting go of it
+	std::vector<uint8_t> buffer(kRecordingCapacity);
+	IMutexLock lock(this);
+
+	mRecorder.Start(buffer);
+	// the parameters go first, because some of them, like the value width, decide how the program is compiled
+	for (int paramIdx = 0; paramIdx < kNumParams; ++paramIdx)
+	{
+		mRecorder.RecordParam(paramIdx, GetParam(paramIdx)->Value());
+	}
+	mRecorder.RecordParam(kTransportState, mTransport);
+	mRecorder.RecordProgram(mProgramText.c_str(), mProgramMemorySize, 0);
+	RecordState();
+	UpdateMemoryFootprint();
+}
+
+void Evaluator::StopRecording()
+{
+	IMutexLock lock(this);
+
+	mRecorder.Stop();
+	UpdateMemoryFootprint();
+}
+
+void Evaluator::RecordState()
+{
+	// we can't record the state of the random number generator, so we restart it from a seed we can record
+	const uint64_t seed = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	mProgram->SetRandomSeed(seed);
+
+	std::vector<uint8_t> notes;
+	for (const IMidiMsg& note : mNotes)
+	{
+		notes.push_back((uint8_t)note.NoteNumber());
+		notes.push_back((uint8_t)note.Velocity());
+	}
+
+	mRecorder.RecordState(mTick, seed, *mProgram, notes);
+}
+
+void Evaluator::UpdateMemoryFootprint()
+{
+	MemoryFootprint footprint;
+	footprint.instance = sizeof(Evaluator) + kNumParams * sizeof(IParam);
+	footprint.program = (mProgram != nullptr ? mProgram->GetFootprint() : 0) + mRestoredMemory.capacity() * sizeof(Program::Value);
+	footprint.source = mProgramText.capacity() + mCostSummary.capacity() + mOurState.Size();
+	footprint.scope = mInterface != nullptr ? mInterface->GetOscilloscopeMemorySize() : 0;
+	footprint.graphics = mInterface != nullptr ? sizeof(Interface) + mInterface->GetGraphicsMemorySize() : 0;
+	footprint.presets = mPresetMemorySize;
+	footprint.midi = mMidiQueue.GetSize() * sizeof(IMidiMsg) + mNotes.capacity() * sizeof(IMidiMsg);
+	footprint.recording = mRecorder.IsRecording() || mRecorder.IsFull() ? mRecorder.GetCapacity() : 0;
+	footprint.total = footprint.instance + footprint.program + footprint.source + footprint.scope
+		+ footprint.graphics + footprint.presets + footprint.midi + footprint.recording;
+
+	sProcessFootprint += footprint.total - mFootprint.total;
+	mFootprint = footprint;
+	mTelemetryCounters.memoryBytes = footprint.total;
+}
+
+void Evaluator::GetMemoryReport(char* text, size_t size)
+{
+	int instances = 0;
+	const size_t processTotal = GetProcessMemoryFootprint(&instances);
+	snprintf(text, size,
+		"this instance %8.1f KB\n"
+		"  program     %8.1f KB\n"
+		"  source      %8.1f KB\n"
+		"  scope       %8.1f KB\n"
+		"  graphics    %8.1f KB\n"
+		"  presets     %8.1f KB\n"
+		"  midi        %8.1f KB\n"
+		"  recording   %8.1f KB\n"
+		"  plugin      %8.1f KB\n"
+		"\n%d instance(s) %8.1f KB\n"
+		"\nprogram memory is %s with the project\nright-click title to change\n"
+		"\n@%llu to @%llu %s shared with other instances\nshift+right-click title to change",
+		mFootprint.total / 1024.0,
+		mFootprint.program / 1024.0,
+		mFootprint.source / 1024.0,
+		mFootprint.scope / 1024.0,
+		mFootprint.graphics / 1024.0,
+		mFootprint.presets / 1024.0,
+		mFootprint.midi / 1024.0,
+		mFootprint.recording / 1024.0,
+		mFootprint.instance / 1024.0,
+		instances, processTotal / 1024.0,
+		GetParam(kSaveProgramMemory)->Bool() ? "saved" : "not saved",
+		(unsigned long long)MemoryBus::GetAddress(mProgramMemorySize),
+		(unsigned long long)(MemoryBus::GetAddress(mProgramMemorySize) + std::min(MemoryBus::kSize, (size_t)mProgramMemorySize) - 1),
+		GetParam(kSharedMemory)->Bool() ? "are" : "are not");
+}
+
+// static
+size_t Evaluator::GetProcessMemoryFootprint(int* outInstanceCount)
+{
+	if (outInstanceCount != nullptr)
+	{
+		*outInstanceCount = sInstanceCount;
+	}
+	return sProcessFootprint;
 }
 
 void Evaluator::ProcessMidiMsg(IMidiMsg *pMsg)
 {
-	IMutexLock(this);
+	// Mutex is already locked for us.
+	RealtimeCheck::Scope realtime;
 
 	mMidiQueue.Add(pMsg);
 }
@@ -294,6 +608,11 @@ void Evaluator::OnParamChange(int paramIdx)
 {
 	IMutexLock lock(this);
 
+	if (mRecorder.IsRecording() && paramIdx < kNumParams)
+	{
+		mRecorder.RecordParam(paramIdx, GetParam(paramIdx)->Value());
+	}
+
 	switch (paramIdx)
 	{
 	case kGain:
@@ -314,15 +633,29 @@ void Evaluator::OnParamChange(int paramIdx)
 		mMidiNoteResetsTick = GetParam(kMidiNoteResetsTime)->Bool();
 		break;
 
+	// the width is chosen when compiling, so the program has to be compiled again
+	case kValueWidth:
+		if (mInterface != nullptr)
+		{
+			OnParamChange(kExpression);
+		}
+		break;
+
 	case kExpression:
 	{
+		Tracing::Scope trace("compile");
+		InvalidateSerializedState();
 		Program::CompileError error;
 		int errorPosition;
 		const char* programText = mInterface->GetProgramText();
 		// we get the memory size from the interface because we *might* expose this in the UI.
 		// but I'm not totally convinced there is much utility in doing so.
 		mProgramMemorySize = mInterface->GetProgramMemorySize();
-		mProgram = Program::Compile(programText, mProgramMemorySize, error, errorPosition);
+		delete mProgram;
+		mProgram = Program::Compile(programText, mProgramMemorySize, error, errorPosition, (Program::ValueWidth)GetParam(kValueWidth)->Int());
+		mProgramText = programText;
+		bool restoredMemory = false;
+		Tracing::Instant("program swap");
 		// we want to always have a program we can run,
 		// so if compilation fails, we create one that simply evaluates to silence.
 		mProgramIsValid = error == Program::CE_NONE;
@@ -354,14 +687,43 @@ void Evaluator::OnParamChange(int paramIdx)
 
 		// initializeeeee
 		mTick = 0;
+		mLoadAverage = 0;
+		mLoadPeak = 0;
+		mTelemetryCounters.programHash = mProgramIsValid ? Telemetry::Hash(programText) : 0;
 		if (mProgramIsValid)
 		{
+			mCostSummary = mProgram->GetCostSummary();
+			char width[128];
+			snprintf(width, sizeof(width), "\n\nvalues are %d-bit%s\nright-click title to change",
+				mProgram->GetValueWidth() == Program::VW_32 ? 32 : 64,
+				GetParam(kValueWidth)->Int() == Program::VW_AUTO ? " (auto)" : "");
+			mCostSummary += width;
+
+			if (mRestoredMemoryIsPending && mRestoredMemory.size() == mProgram->GetMemorySize())
+			{
+				mProgram->SetMemory(mRestoredMemory.data());
+				restoredMemory = true;
+			}
+
 			for (paramIdx = kVControl0; paramIdx <= kVControl7; ++paramIdx)
 			{
 				Program::Value vidx = paramIdx - kVControl0;
 				mProgram->SetVC(vidx, GetParam(paramIdx)->Int());
 			}
 		}
+
+		if (mRecorder.IsRecording())
+		{
+			const uint64_t seed = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+			mProgram->SetRandomSeed(seed);
+			mRecorder.RecordProgram(mProgramText.c_str(), mProgramMemorySize, seed);
+			// replay starts the program with cleared memory, so it needs the memory that was restored
+			if (restoredMemory)
+			{
+				RecordState();
+			}
+		}
+		UpdateMemoryFootprint();
 		RedrawParamControls();
 	}
 	break;
@@ -387,12 +749,18 @@ void Evaluator::OnParamChange(int paramIdx)
 		}
 
 		mTransport = newState;
+
+		if (mRecorder.IsRecording())
+		{
+			mRecorder.RecordParam(kTransportState, mTransport);
+		}
 	}
 	break;
 
 	default:
 		if (paramIdx >= kWatch && paramIdx < kWatch + kWatchNum && mInterface != nullptr)
 		{
+			InvalidateSerializedState();
 			SetWatchText(mInterface);
 			RedrawParamControls();
 		}
@@ -414,7 +782,11 @@ static const int kStateVCParams = kStateFirstVersion + 1;
 static const int kStateProgramName = kStateVCParams + 1;
 static const int kStateTempo = kStateProgramName + 1;
 static const int kStateMidiReset = kStateTempo + 1;
-static const int kStateVersion = kStateMidiReset;
+// kSaveProgramMemory was added and the compressed program memory follows the params
+static const int kStateProgramMemory = kStateMidiReset + 1;
+static const int kStateValueWidth = kStateProgramMemory + 1;
+static const int kStateSharedMemory = kStateValueWidth + 1;
+static const int kStateVersion = kStateSharedMemory;
 
 void Evaluator::MakePresetFromData(const Presets::Data& data)
 {
@@ -444,9 +816,13 @@ void Evaluator::MakePresetFromData(const Presets::Data& data)
 	}
 	chunk.PutStr(data.name);
 	IPlugBase::SerializeParams(&chunk);
+	// presets don't include program memory
+	int encodedSize = 0;
+	chunk.Put(&encodedSize);
 
 	// create it - const cast on data.name because this method take char*, even though it doesn't change it
 	MakePresetFromChunk(const_cast<char*>(data.name), &chunk);
+	mPresetMemorySize += chunk.Size();
 }
 
 void Evaluator::SerializeOurState(ByteChunk* pChunk)
@@ -462,15 +838,63 @@ void Evaluator::SerializeOurState(ByteChunk* pChunk)
 	pChunk->PutStr(mInterface->GetProgramName());
 }
 
+ByteChunk& Evaluator::GetOurState()
+{
+	if (!mOurStateIsValid)
+	{
+		// set this first so an invalidation that happens while we serialize isn't lost
+		mOurStateIsValid = true;
+		mOurState.Clear();
+		SerializeOurState(&mOurState);
+	}
+
+	return mOurState;
+}
+
 // this over-ridden method is called when the host is trying to store the plug-in state and needs to get the current data from your algorithm
 bool Evaluator::SerializeState(ByteChunk* pChunk)
 {
 	TRACE;
-	IMutexLock lock(this);
+	// the memory is allocated before locking so the audio thread doesn't wait for that either.
+	// its size can't change, because it comes from the interface, and memory of any other size wouldn't be loaded anyway.
+	std::vector<Program::Value> memory;
+	if (GetParam(kSaveProgramMemory)->Bool())
+	{
+		memory.resize(Program::GetTotalMemorySize(mInterface->GetProgramMemorySize()));
+	}
+	{
+		IMutexLock lock(this);
+
+		pChunk->PutChunk(&GetOurState());
 
-	SerializeOurState(pChunk);
+		if (!IPlugBase::SerializeParams(pChunk)) // must remember to call SerializeParams at the end
+		{
+			return false;
+		}
 
-	return IPlugBase::SerializeParams(pChunk); // must remember to call SerializeParams at the end
+		// only copy the memory while locked, so the audio thread doesn't wait for it to be encoded
+		if (mProgramIsValid && GetParam(kSaveProgramMemory)->Bool() && mProgram->GetMemorySize() == memory.size())
+		{
+			mProgram->GetMemory(memory.data());
+		}
+		else
+		{
+			memory.clear();
+		}
+	}
+
+	std::vector<uint8_t> encoded;
+	MemoryEncoding::Encode(memory.data(), memory.size(), encoded);
+	int encodedSize = (int)encoded.size();
+	pChunk->Put(&encodedSize);
+	if (encodedSize > 0)
+	{
+		int memorySize = (int)memory.size();
+		pChunk->Put(&memorySize);
+		pChunk->PutBytes(encoded.data(), encodedSize);
+	}
+
+	return true;
 }
 
 // this over-ridden method is called when the host is trying to load the plug-in state and you need to unpack the data into your algorithm
@@ -478,6 +902,7 @@ int Evaluator::UnserializeState(ByteChunk* pChunk, int startPos)
 {
 	TRACE;
 	IMutexLock lock(this);
+	Tracing::Scope trace("load state");
 
 	int version = 0;
 	int nextPos = pChunk->Get(&version, startPos);
@@ -551,17 +976,71 @@ int Evaluator::UnserializeState(ByteChunk* pChunk, int startPos)
 	const int numParams = version < kStateVCParams ? kScopeWindow + 1
 						: version < kStateTempo ? kVControl7 + 1
 						: version < kStateMidiReset ? kTempo + 1
+						: version < kStateProgramMemory ? kMidiNoteResetsTime + 1
+						: version < kStateValueWidth ? kSaveProgramMemory + 1
+						: version < kStateSharedMemory ? kValueWidth + 1
 						: kNumParams;
 
-	return IPlugBase::UnserializeParams(pChunk, startPos, numParams); // must remember to call UnserializeParams at the end
+	startPos = IPlugBase::UnserializeParams(pChunk, startPos, numParams); // must remember to call UnserializeParams at the end
+
+	mRestoredMemoryIsPending = false;
+	if (version >= kStateProgramMemory && startPos >= 0)
+	{
+		startPos = UnserializeProgramMemory(pChunk, startPos);
+	}
+
+	return startPos;
+}
+
+int Evaluator::UnserializeProgramMemory(ByteChunk* pChunk, int startPos)
+{
+	int encodedSize = 0;
+	startPos = pChunk->Get(&encodedSize, startPos);
+	if (startPos < 0 || encodedSize <= 0)
+	{
+		return startPos;
+	}
+
+	int memorySize = 0;
+	startPos = pChunk->Get(&memorySize, startPos);
+	if (startPos < 0 || encodedSize > pChunk->Size() - startPos || memorySize <= 0)
+	{
+		return -1;
+	}
+
+	// the size comes from the chunk, so don't allocate for it unless it's the size the program will have.
+	// memory saved by a plugin with a different amount of user memory is skipped.
+	if ((size_t)memorySize != Program::GetTotalMemorySize(mInterface->GetProgramMemorySize()))
+	{
+		return startPos + encodedSize;
+	}
+
+	Tracing::Scope trace("restore memory");
+	mRestoredMemory.resize(memorySize);
+	const uint8_t* encoded = pChunk->GetBytes() + startPos;
+	if (MemoryEncoding::Decode(encoded, encodedSize, mRestoredMemory.data(), mRestoredMemory.size()))
+	{
+		mRestoredMemoryIsPending = true;
+		if (mProgramIsValid && mRestoredMemory.size() == mProgram->GetMemorySize())
+		{
+			mProgram->SetMemory(mRestoredMemory.data());
+			if (mRecorder.IsRecording())
+			{
+				RecordState();
+			}
+		}
+	}
+
+	return startPos + encodedSize;
 }
 
 bool Evaluator::CompareState(const unsigned char* incomingState, int startPos)
 {
+	IMutexLock lock(this);
+
 	bool isEqual = true;
-	// create serialized representation of our string
-	ByteChunk chunk;
-	SerializeOurState(&chunk);
+	// serialized representation of our strings, which is only recreated when they change
+	ByteChunk& chunk = GetOurState();
 	// see if it's the same as the incoming state
 	int stateSize = chunk.Size();
 	isEqual = (memcmp(incomingState + startPos, chunk.GetBytes(), stateSize) == 0);
@@ -596,13 +1075,17 @@ const char * Evaluator::GetProgramState() const
 		"---------------------- ----------------------\n"
 		"t=%-20llu w=%-20llu\n"
 		"m=%-20llu n=%-20llu\n"
-		"q=%-20llu v=%-20llu\n",
+		"q=%-20llu v=%-20llu\n"
+		"\n"
+		"dsp load %5.1f%% (peak %5.1f%%)\n",
 		mProgram->Get('t'),
 		mProgram->Get('w'),
 		mProgram->Get('m'),
 		mProgram->Get('n'),
 		mProgram->Get('q'),
-		mProgram->Get('v')
+		mProgram->Get('v'),
+		mLoadAverage * 100,
+		mLoadPeak * 100
 		);
 
 	return state;
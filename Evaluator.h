@@ -12,7 +12,13 @@
 #include "Params.h"
 #include "Program.h"
 #include "Presets.h"
+#include "LatencyHistogram.h"
+#include "Telemetry.h"
+#include "Recording.h"
+#include "MemoryBus.h"
 #include "IMidiQueue.h"
+#include <atomic>
+#include <string>
 #include <vector>
 
 class Interface;
@@ -32,6 +38,9 @@ public:
 	bool SerializeState(ByteChunk* pChunk) override;
 	int UnserializeState(ByteChunk* pChunk, int startPos) override;
 	bool CompareState(const unsigned char* incomingState, int startPos) override;
+	// must be called when the program text, a watch, or the program name changes
+	// so that the next call to SerializeState or CompareState doesn't use stale text.
+	void InvalidateSerializedState() { mOurStateIsValid = false; }
 
 	// catch the About menu item to display what we wants in a box
 	bool HostRequestingAboutBox() override;
@@ -40,10 +49,45 @@ public:
 	const char * GetProgramState() const;
 	void SetWatchText(Interface* forInterface) const;
 
+	// how long each call to ProcessDoubleReplacing took, recorded on the audio thread
+	LatencyHistogram& GetBlockTimes() { return mBlockTimes; }
+
+	// record everything that affects the output so it can be played back with the replay tool
+	void StartRecording();
+	void StopRecording();
+	const Recording::Recorder& GetRecorder() const { return mRecorder; }
+
+	// bytes of memory used by each part of an instance
+	struct MemoryFootprint
+	{
+		size_t instance;	// the plugin object and its parameters
+		size_t program;		// the compiled program, see Program::GetFootprint
+		size_t source;		// the program text, its cost summary, and the cached serialized state
+		size_t scope;		// oscilloscope sample buffer
+		size_t graphics;	// window bitmap and loaded bitmaps
+		size_t presets;		// serialized factory presets
+		size_t midi;		// midi queue and held notes
+		size_t recording;	// input recording buffer, only while recording
+		size_t total;
+	};
+	// updated when the program is compiled, when the plugin is reset, and when recording starts or stops
+	const MemoryFootprint& GetMemoryFootprint() const { return mFootprint; }
+	// the sum of the total footprint of every instance in this process, and how many there are
+	static size_t GetProcessMemoryFootprint(int* outInstanceCount = nullptr);
+
 private:
 
 	void MakePresetFromData(const Presets::Data& data);
 	void SerializeOurState(ByteChunk* pChunk);
+	// SerializeOurState from the last time it was called, unless the state has been invalidated since then
+	ByteChunk& GetOurState();
+	// record what the program remembers between samples so the replay can pick up from here
+	void RecordState();
+	// read the memory saved by SerializeState, which must be the memory of the program in mProgramText
+	int UnserializeProgramMemory(ByteChunk* pChunk, int startPos);
+	// recalculate mFootprint and add the change to the process total
+	void UpdateMemoryFootprint();
+	void GetMemoryReport(char* text, size_t size);
 
 	// the UI
 	Interface*			mInterface;
@@ -54,6 +98,10 @@ private:
 	// will be false if user input produced a compilation error.
 	// we want to keep track of this so we don't update the UI in ProcessDoubleReplacing.
 	bool					mProgramIsValid;
+	// the source code mProgram was compiled from, which can be different from what is in the text box
+	std::string			mProgramText;
+	// shown in the console when it is in kConsoleModeCost, generated when the program is compiled
+	std::string			mCostSummary;
 	TransportState	    mTransport;
 	double				mGain;
 	int					mBitDepth;
@@ -63,6 +111,27 @@ private:
 	Program::Value		mTick;
 	IMidiQueue			mMidiQueue;
 	std::vector<IMidiMsg> mNotes;
+	// how much of the real-time budget ProcessDoubleReplacing uses, as a fraction of nFrames / sampleRate.
+	// the average is smoothed over recent blocks, the peak is the highest load since the program was compiled.
+	double				mLoadAverage;
+	double				mLoadPeak;
+	LatencyHistogram	mBlockTimes;
+	// published to shared memory at the end of every block, see Telemetry.h
+	Telemetry::Counters	mTelemetryCounters;
+	Telemetry::Publisher	mTelemetry;
+	Recording::Recorder	mRecorder;
+	// exchanges the end of program memory with other instances when kSharedMemory is on
+	MemoryBus::Port		mMemoryBus;
+	// bytes of all the preset chunks created in the constructor
+	size_t				mPresetMemorySize;
+	MemoryFootprint		mFootprint;
+	// cached by GetOurState, because some hosts call CompareState very often
+	ByteChunk			mOurState;
+	std::atomic<bool>	mOurStateIsValid;
+	// memory restored by UnserializeState, which is also given to programs compiled before the next block is processed,
+	// because some hosts reset the plugin after loading state, which recompiles the program.
+	std::vector<Program::Value> mRestoredMemory;
+	bool				mRestoredMemoryIsPending;
 };
 
 #endif
@@ -0,0 +1,178 @@
+//
+//  GeneratedProgram.cpp
+//  Evaluator
+//
+//  Runs programs from generated source that has been compiled into the binary or loaded from a shared library.
+//
+
+#include "GeneratedProgram.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace GeneratedProgram
+{
+	// the same memory as ProgramT, with the generated function in place of the interpreter
+	template<typename V>
+	class Generated : public Program
+	{
+	public:
+		// copying program keeps the instructions and debug info, so the disassembly and error lines are the same
+		Generated(const Program& program, GeneratedFunction inFunction)
+			: Program(program)
+			, function(inFunction)
+		{
+			runError = RE_NONE;
+			runCount = 0;
+			memset(errors, 0, sizeof(errors));
+			mem = new V[memSize];
+			memset(mem, 0, sizeof(V)*memSize);
+			// default sample rate so the F operator will function
+			Set('~', 44100);
+		}
+
+		~Generated()
+		{
+			delete[] mem;
+		}
+
+		RuntimeError Run(Value* results, const size_t size) override
+		{
+			++runCount;
+			runError = RE_NONE;
+			GeneratedFrame frame = { mem, cc, vc, results, size, Random, &rng, 0 };
+			const int error = function(&frame);
+			if (error != RE_NONE)
+			{
+				pc = frame.address;
+				Fault((RuntimeError)error);
+			}
+			return runError;
+		}
+
+		size_t GetFootprint() const override
+		{
+			return sizeof(Generated) + memSize * sizeof(V) + ops.capacity() * sizeof(Op) + opPositions.capacity() * sizeof(int) + lineStarts.capacity() * sizeof(int);
+		}
+
+		Value Peek(const Value address) const override { return mem[address%memSize]; }
+		void  Poke(const Value address, const Value value) override { mem[address%memSize] = (V)value; }
+
+		void GetMemory(Value* outValues) const override
+		{
+			std::copy(mem, mem + memSize, outValues);
+		}
+
+		void SetMemory(const Value* values) override
+		{
+			for (size_t i = 0; i < memSize; ++i)
+			{
+				mem[i] = (V)values[i];
+			}
+		}
+
+	private:
+		static uint64_t Random(void* rng)
+		{
+			return (*(std::default_random_engine*)rng)();
+		}
+
+		const GeneratedFunction function;
+		V* mem;
+	};
+
+	Program* Create(const Program& program, Program::GeneratedFunction function)
+	{
+		if (program.GetValueWidth() == Program::VW_32)
+		{
+			return new Generated<uint32_t>(program, function);
+		}
+		return new Generated<uint64_t>(program, function);
+	}
+
+	bool Build(const std::string& source, const char* libraryPath, std::string& outError)
+	{
+#if defined(_WIN32)
+		outError = "building generated programs isn't supported on Windows, build the source into a DLL and use Load";
+		return false;
+#else
+		const std::string sourcePath = std::string(libraryPath) + ".cpp";
+		FILE* file = fopen(sourcePath.c_str(), "w");
+		if (file == nullptr)
+		{
+			outError = "couldn't write " + sourcePath;
+			return false;
+		}
+		const bool written = fwrite(source.data(), 1, source.size(), file) == source.size();
+		if (fclose(file) != 0 || !written)
+		{
+			outError = "couldn't write " + sourcePath;
+			return false;
+		}
+
+		const char* compiler = getenv("CXX");
+		const std::string command = std::string(compiler != nullptr && compiler[0] != 0 ? compiler : "c++")
+			+ " -std=c++11 -O2 -shared -fPIC -o \"" + libraryPath + "\" \"" + sourcePath + "\" 2>&1";
+		FILE* pipe = popen(command.c_str(), "r");
+		if (pipe == nullptr)
+		{
+			outError = "couldn't run " + command;
+			return false;
+		}
+
+		std::string output;
+		char buffer[256];
+		size_t count;
+		while ((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+		{
+			output.append(buffer, count);
+		}
+		if (pclose(pipe) != 0)
+		{
+			outError = output.empty() ? "failed to run " + command : output;
+			return false;
+		}
+
+		outError.clear();
+		return true;
+#endif
+	}
+
+	Program::GeneratedFunction Load(const char* libraryPath, const char* functionName, std::string& outError)
+	{
+#if defined(_WIN32)
+		HMODULE library = LoadLibraryA(libraryPath);
+		if (library == nullptr)
+		{
+			outError = std::string("couldn't load ") + libraryPath;
+			return nullptr;
+		}
+		FARPROC symbol = GetProcAddress(library, functionName);
+#else
+		// a path without a slash would be searched for instead of opened
+		const std::string path = strchr(libraryPath, '/') == nullptr ? std::string("./") + libraryPath : std::string(libraryPath);
+		void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (library == nullptr)
+		{
+			outError = dlerror();
+			return nullptr;
+		}
+		void* symbol = dlsym(library, functionName);
+#endif
+		if (symbol == nullptr)
+		{
+			outError = std::string("couldn't find ") + functionName + " in " + libraryPath;
+			return nullptr;
+		}
+
+		outError.clear();
+		return (Program::GeneratedFunction)symbol;
+	}
+}
@@ -0,0 +1,30 @@
+//
+//  GeneratedProgram.h
+//  Evaluator
+//
+//  Runs the C++ that Program::GenerateSource makes from a program, so that programs can be built ahead of time
+//  instead of being interpreted. The generated source can be compiled into the binary like any other file,
+//  with the function declared as extern "C" int name(Program::GeneratedFrame*), or it can be built into
+//  a shared library with the system compiler while running and loaded from there.
+//
+
+#pragma once
+
+#include "Program.h"
+#include <string>
+
+namespace GeneratedProgram
+{
+	// a Program that calls function instead of interpreting the instructions of program, which it must have been generated from.
+	// it has its own memory, starting out the same as a newly compiled program, and reports errors on the same lines.
+	Program* Create(const Program& program, Program::GeneratedFunction function);
+
+	// build source, which can hold any number of generated functions, into a shared library at libraryPath.
+	// the source is saved next to it with .cpp added and built with $CXX, or c++ if that isn't set.
+	// outError gets the compiler output when it fails.
+	bool Build(const std::string& source, const char* libraryPath, std::string& outError);
+
+	// load a function from a shared library built by Build, which stays loaded until the process exits.
+	// returns nullptr and sets outError if the library or the function can't be loaded.
+	Program::GeneratedFunction Load(const char* libraryPath, const char* functionName, std::string& outError);
+}
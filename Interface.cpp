@@ -9,6 +9,7 @@
 #include "Evaluator.h"
 #include "IControl.h"
 #include "Controls.h"
+#include "Tracing.h"
 
 #if SA_API
 extern char *gINIPath;
@@ -374,6 +375,17 @@ static const char* kLanguageSyntaxTable[] =
 	"[0] = x", "assign the value of x to the left output",
 	"[1] = y", "assign the value of y to the right output",
 	"[*] = x", "assign the value of x to all outputs",
+	"every x {...}", "run the statements only when t is a multiple of x",
+	"repeat k (i) {...}", "run the statements k times with i from 0 to k-1",
+	"def fn(x) = ...;", "define a function, inlined wherever fn(y) is used",
+	"tap(a, n, d)", "the value from d samples ago in the ring buffer of n values at @a",
+	"rec(a, n, x)", "write x to the ring buffer of n values at @a, result is x",
+	"copy(a, b, n)", "copy n values of memory from @b to @a",
+	"fill(a, n, x)", "set n values of memory starting at @a to x",
+	"lpf(s, x, k)", "lowpass of x, moving k/256 of the way each sample, x < 2^48 (2^16 at 32 bits)",
+	"hpf(s, x, k)", "x minus lpf(s, x, k), a highpass, with x clamped like lpf",
+	"slew(s, x, r)", "move s towards x by at most r each sample",
+	"env(s, x, r)", "jump s up to x, otherwise fall towards x by r each sample",
 };
 
 static const int kLanguageSyntaxColumns = 2;
@@ -386,11 +398,13 @@ Interface::Interface(Evaluator* plug, IGraphics* pGraphics)
 	, textEdit(nullptr)
 	, programName(nullptr)
 	, consoleTextControl(nullptr)
+	, consoleTitle(nullptr)
 	, bitDepthControl(nullptr)
 	, oscilloscope(nullptr)
 	, transportButtons(nullptr)
 	, timeResetLabel(nullptr)
 	, timeResetToggle(nullptr)
+	, bitmapMemorySize(0)
 {
 	CreateControls(pGraphics);
 
@@ -443,7 +457,8 @@ void Interface::CreateControls(IGraphics* pGraphics)
 
 	//-- "window" displaying internal state of the expression
 	{
-		pGraphics->AttachControl(new ITextControl(mPlug, MakeIRect(kConsoleTitle), &kTitleTextStyle, "AUTO"));
+		consoleTitle = new ConsoleTitle(mPlug, MakeIRect(kConsoleTitle), &kTitleTextStyle, this);
+		pGraphics->AttachControl(consoleTitle);
 		IRECT LogRect = MakeIRect(kConsole);
 		consoleTextControl = new ConsoleText(mPlug, LogRect, &kConsoleTextStyle, &kConsoleBackgroundColor, kConsole_M);
 		pGraphics->AttachControl(consoleTextControl);
@@ -624,6 +639,8 @@ void Interface::CreateControls(IGraphics* pGraphics)
 		IBitmap buttonBack = pGraphics->LoadIBitmap(BUTTON_BACK_ID, BUTTON_BACK_FN);
 		int buttonX = kEditorWidth - kEditorMargin - buttonBack.W*2 - 10;
 		const int buttonY = kProgramText_Y - buttonBack.H - 5;
+		// IGraphics caches bitmaps by id, so loading this again below doesn't use more memory
+		bitmapMemorySize += buttonBack.W * buttonBack.H * 4;
 
 		pGraphics->AttachControl(new SaveButton(mPlug, buttonX, buttonY, &buttonBack, &kLabelTextStyle, this));
 
@@ -691,6 +708,7 @@ unsigned int Interface::GetProgramMemorySize() const
 void Interface::SetProgramName(const char* name)
 {
 	programName->SetTextFromPlug(const_cast<char*>(name));
+	mPlug->InvalidateSerializedState();
 }
 
 const char * Interface::GetProgramName() const
@@ -708,6 +726,16 @@ void Interface::SetConsoleText(const char * consoleText)
 	consoleTextControl->SetTextFromPlug(const_cast<char*>(consoleText));
 }
 
+ConsoleMode Interface::GetConsoleMode() const
+{
+	if (consoleTitle != nullptr)
+	{
+		return consoleTitle->GetConsoleMode();
+	}
+
+	return kConsoleModeState;
+}
+
 void Interface::SetWatchValue(int idx, const char * watchText)
 {
 	if ( idx >= 0 && idx < kWatchNum )
@@ -726,6 +754,16 @@ int Interface::GetOscilloscopeWidth() const
 	return oscilloscope->GetRECT()->W();
 }
 
+size_t Interface::GetOscilloscopeMemorySize() const
+{
+	return oscilloscope->GetMemorySize();
+}
+
+size_t Interface::GetGraphicsMemorySize() const
+{
+	return GUI_WIDTH * GUI_HEIGHT * 4 + bitmapMemorySize;
+}
+
 const char * Interface::GetWatch(int idx) const
 {
 	return watches[idx].var->GetText();
@@ -736,11 +774,13 @@ void Interface::SetWatch(int idx, const char * text)
 	if (idx >= 0 && idx < kWatchNum)
 	{
 		watches[idx].var->SetTextFromPlug(text);
+		mPlug->InvalidateSerializedState();
 	}
 }
 
 void Interface::LoadPreset(int idx)
 {
+	Tracing::Scope trace("load preset");
 	mPlug->RestorePreset(idx);
 	mPlug->InformHostOfProgramChange();
 }
@@ -780,3 +820,119 @@ bool Interface::GetSupportPath(WDL_String* outPath) const
 	return true;
 #endif
 }
+
+void Interface::ExportBlockTimes()
+{
+	static char msg[1024];
+	WDL_String csvPath("");
+	WDL_String jsonPath("");
+	bool success = GetSupportPath(&csvPath) && GetSupportPath(&jsonPath);
+
+	if (success)
+	{
+		csvPath.Append("/block_times.csv");
+		jsonPath.Append("/block_times.json");
+		const LatencyHistogram& blockTimes = mPlug->GetBlockTimes();
+		success = blockTimes.WriteCSV(csvPath.Get()) && blockTimes.WriteJSON(jsonPath.Get());
+	}
+
+	if (success)
+	{
+		mPlug->GetBlockTimes().Reset();
+		sprintf(msg, "Block times were saved to:\n%s\n%s", csvPath.Get(), jsonPath.Get());
+		mPlug->GetGUI()->ShowMessageBox(msg, "Block Times", MB_OK);
+	}
+	else
+	{
+		sprintf(msg, "Sorry, couldn't save block times to %s.", csvPath.Get());
+		mPlug->GetGUI()->ShowMessageBox(msg, "Error", MB_OK);
+	}
+}
+
+void Interface::ToggleTracing()
+{
+	if (!Tracing::IsRecording())
+	{
+		Tracing::Start();
+		return;
+	}
+
+	Tracing::Stop();
+
+	static char msg[1024];
+	WDL_String path("");
+	bool success = GetSupportPath(&path);
+	if (success)
+	{
+		path.Append("/trace.json");
+		success = Tracing::Write(path.Get());
+	}
+
+	if (success)
+	{
+		sprintf(msg, "The trace was saved to:\n%s\n\nOpen it with chrome://tracing or ui.perfetto.dev", path.Get());
+		mPlug->GetGUI()->ShowMessageBox(msg, "Trace", MB_OK);
+	}
+	else
+	{
+		sprintf(msg, "Sorry, couldn't save the trace to %s.", path.Get());
+		mPlug->GetGUI()->ShowMessageBox(msg, "Error", MB_OK);
+	}
+}
+
+void Interface::ToggleRecording()
+{
+	const Recording::Recorder& recorder = mPlug->GetRecorder();
+	if (!recorder.IsRecording() && !recorder.IsFull())
+	{
+		mPlug->StartRecording();
+		return;
+	}
+
+	mPlug->StopRecording();
+
+	static char msg[1024];
+	WDL_String path("");
+	bool success = GetSupportPath(&path);
+	if (success)
+	{
+		path.Append("/recording.evr");
+		success = recorder.Write(path.Get());
+	}
+
+	if (success)
+	{
+		sprintf(msg, "The recording was saved to:\n%s\n\nPlay it back with the replay tool", path.Get());
+		mPlug->GetGUI()->ShowMessageBox(msg, "Recording", MB_OK);
+	}
+	else
+	{
+		sprintf(msg, "Sorry, couldn't save the recording to %s.", path.Get());
+		mPlug->GetGUI()->ShowMessageBox(msg, "Error", MB_OK);
+	}
+}
+
+void Interface::ToggleSaveProgramMemory()
+{
+	IParam* param = mPlug->GetParam(kSaveProgramMemory);
+	param->Set(!param->Bool());
+	mPlug->OnParamChange(kSaveProgramMemory);
+	// we have to call this or else the host will not mark the project as modified
+	mPlug->InformHostOfParamChange(kSaveProgramMemory, param->GetNormalized());
+}
+
+void Interface::CycleValueWidth()
+{
+	IParam* param = mPlug->GetParam(kValueWidth);
+	param->Set((param->Int() + 1) % (Program::VW_AUTO + 1));
+	mPlug->OnParamChange(kValueWidth);
+	mPlug->InformHostOfParamChange(kValueWidth, param->GetNormalized());
+}
+
+void Interface::ToggleSharedMemory()
+{
+	IParam* param = mPlug->GetParam(kSharedMemory);
+	param->Set(!param->Bool());
+	mPlug->OnParamChange(kSharedMemory);
+	mPlug->InformHostOfParamChange(kSharedMemory, param->GetNormalized());
+}
@@ -14,6 +14,7 @@ class IGraphics;
 class ITextEdit;
 class ITextControl;
 class ConsoleText;
+class ConsoleTitle;
 class IControl;
 class Oscilloscope;
 class TransportButtons;
@@ -35,10 +36,15 @@ public:
 
 	void SetProgramText(const char * programText);
 	void SetConsoleText(const char * consoleText);
+	ConsoleMode GetConsoleMode() const;
 	void SetWatchValue(int idx, const char* watchText);
 
 	void UpdateOscilloscope(double left, double right);
 	int GetOscilloscopeWidth() const;
+	// bytes used by the oscilloscope's sample buffer
+	size_t GetOscilloscopeMemorySize() const;
+	// bytes used by the bitmap the window is drawn into and the bitmaps we load, at 1x scale
+	size_t GetGraphicsMemorySize() const;
 
 	const char * GetWatch(int idx) const;
 	void SetWatch(int idx, const char * text);
@@ -51,6 +57,18 @@ public:
 	void ToggleHelp();
 
 	bool GetSupportPath(WDL_String* outPath) const;
+	// write the block time histogram to the support path as csv and json, then reset it
+	void ExportBlockTimes();
+	// start recording a trace, or stop recording and save it to the support path
+	void ToggleTracing();
+	// start recording everything that affects the output, or stop recording and save it to the support path
+	void ToggleRecording();
+	// toggle whether the memory of the program is saved with the plugin state
+	void ToggleSaveProgramMemory();
+	// switch programs between 64-bit, 32-bit, and automatically chosen values
+	void CycleValueWidth();
+	// toggle whether the end of program memory is shared with other instances
+	void ToggleSharedMemory();
 
 	IGraphics* GetGUI() const { return mGraphics; }
 
@@ -64,12 +82,14 @@ private:
 	ITextEdit*		textEdit;
 	ITextControl*	programName;
 	ConsoleText*	consoleTextControl;
+	ConsoleTitle*	consoleTitle;
 	IControl*		bitDepthControl;
 	Oscilloscope*   oscilloscope;
 	TransportButtons* transportButtons;
 	IControl*		timeResetLabel;
 	IControl*		timeResetToggle;
 	IControl*		compilePrompt;
+	size_t			bitmapMemorySize;
 	
 	struct Watch
 	{
@@ -0,0 +1,171 @@
+//
+//  LatencyHistogram.cpp
+//  Evaluator
+//
+//  Counts how long the audio thread spends on each processed block.
+//
+
+#include "LatencyHistogram.h"
+#include <stdio.h>
+
+LatencyHistogram::LatencyHistogram()
+{
+	Reset();
+}
+
+void LatencyHistogram::Record(double seconds)
+{
+	const uint32_t micros = seconds > 0 ? (uint32_t)(seconds * 1000000.0) : 0;
+
+	// the bucket is the number of bits needed to represent the duration
+	int bucket = 0;
+	while (bucket < kBucketCount - 1 && (micros >> bucket) != 0)
+	{
+		++bucket;
+	}
+
+	mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	uint32_t max = mMaxMicroseconds.load(std::memory_order_relaxed);
+	while (micros > max && !mMaxMicroseconds.compare_exchange_weak(max, micros, std::memory_order_relaxed))
+	{
+	}
+}
+
+void LatencyHistogram::Reset()
+{
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		mBuckets[i].store(0, std::memory_order_relaxed);
+	}
+	mMaxMicroseconds.store(0, std::memory_order_relaxed);
+}
+
+uint32_t LatencyHistogram::GetCount(int bucket) const
+{
+	if (bucket >= 0 && bucket < kBucketCount)
+	{
+		return mBuckets[bucket].load(std::memory_order_relaxed);
+	}
+
+	return 0;
+}
+
+uint64_t LatencyHistogram::GetTotalCount() const
+{
+	uint64_t total = 0;
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		total += GetCount(i);
+	}
+	return total;
+}
+
+uint32_t LatencyHistogram::GetMaxMicroseconds() const
+{
+	return mMaxMicroseconds.load(std::memory_order_relaxed);
+}
+
+// static
+uint32_t LatencyHistogram::GetBucketLimit(int bucket)
+{
+	return (uint32_t)1 << bucket;
+}
+
+void LatencyHistogram::GetSummary(char* text, size_t size) const
+{
+	// the console has room for a header, a footer, and this many buckets.
+	// when there are more we show the slowest ones, since those are the ones that cause dropouts.
+	static const int kMaxLines = 6;
+	static const int kBarWidth = 20;
+
+	uint32_t counts[kBucketCount];
+	uint32_t maxCount = 0;
+	int first = kBucketCount;
+	int last = -1;
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		counts[i] = GetCount(i);
+		if (counts[i] > 0)
+		{
+			if (first == kBucketCount) first = i;
+			last = i;
+			if (counts[i] > maxCount) maxCount = counts[i];
+		}
+	}
+
+	if (last - first >= kMaxLines)
+	{
+		first = last - kMaxLines + 1;
+	}
+
+	int len = snprintf(text, size, "block time     blocks\n");
+	for (int i = first; i <= last && len > 0 && (size_t)len < size; ++i)
+	{
+		char bar[kBarWidth + 1];
+		const int barLength = maxCount > 0 ? (int)((uint64_t)counts[i] * kBarWidth / maxCount) : 0;
+		for (int b = 0; b < kBarWidth; ++b)
+		{
+			bar[b] = b < barLength ? '#' : ' ';
+		}
+		bar[kBarWidth] = '\0';
+
+		// the last bucket has no upper bound, so it shows where it starts instead
+		const bool open = i == kBucketCount - 1;
+		len += snprintf(text + len, size - len, "%s %7uus %9u %s\n", open ? ">=" : "< ", GetBucketLimit(open ? i - 1 : i), counts[i], bar);
+	}
+
+	if (len > 0 && (size_t)len < size)
+	{
+		snprintf(text + len, size - len, "max %uus, right-click title to export", GetMaxMicroseconds());
+	}
+}
+
+bool LatencyHistogram::WriteCSV(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	// max_us is left empty for the last bucket, which also counts everything longer
+	fprintf(file, "min_us,max_us,blocks\n");
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		const uint32_t min = i > 0 ? GetBucketLimit(i - 1) : 0;
+		char max[16] = "";
+		if (i + 1 < kBucketCount)
+		{
+			snprintf(max, sizeof(max), "%u", GetBucketLimit(i));
+		}
+		fprintf(file, "%u,%s,%u\n", min, max, GetCount(i));
+	}
+
+	return fclose(file) == 0;
+}
+
+bool LatencyHistogram::WriteJSON(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	// max_us is null for the last bucket, which also counts everything longer
+	fprintf(file, "{\n  \"blocks\": %llu,\n  \"max_us\": %u,\n  \"buckets\": [\n", (unsigned long long)GetTotalCount(), GetMaxMicroseconds());
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		const uint32_t min = i > 0 ? GetBucketLimit(i - 1) : 0;
+		char max[16] = "null";
+		if (i + 1 < kBucketCount)
+		{
+			snprintf(max, sizeof(max), "%u", GetBucketLimit(i));
+		}
+		fprintf(file, "    { \"min_us\": %u, \"max_us\": %s, \"blocks\": %u }%s\n", min, max, GetCount(i), i + 1 < kBucketCount ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+
+	return fclose(file) == 0;
+}
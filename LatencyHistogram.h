@@ -0,0 +1,47 @@
+//
+//  LatencyHistogram.h
+//  Evaluator
+//
+//  Counts how long the audio thread spends on each processed block.
+//
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class LatencyHistogram
+{
+public:
+	// bucket 0 counts blocks that took less than 1 microsecond,
+	// bucket n counts blocks that took [2^(n-1), 2^n) microseconds,
+	// and the last bucket also counts everything longer than that.
+	static const int kBucketCount = 20;
+
+	LatencyHistogram();
+
+	// add a block to the histogram, this is lock-free so that it can be called from the audio thread.
+	void Record(double seconds);
+	// clear all counts. can be called from any thread, but a block recorded at the same time may be lost.
+	void Reset();
+
+	uint32_t GetCount(int bucket) const;
+	uint64_t GetTotalCount() const;
+	// longest block recorded since the last Reset, in microseconds
+	uint32_t GetMaxMicroseconds() const;
+	// exclusive upper bound of a bucket in microseconds, except for the last bucket, which has none
+	static uint32_t GetBucketLimit(int bucket);
+
+	// short text description of the non-empty buckets that fits in the console
+	void GetSummary(char* text, size_t size) const;
+
+	// export all buckets to a file, returns false if the file could not be written.
+	// the upper bound of the last bucket is written as an empty field in CSV and as null in JSON.
+	bool WriteCSV(const char* path) const;
+	bool WriteJSON(const char* path) const;
+
+private:
+	std::atomic<uint32_t> mBuckets[kBucketCount];
+	std::atomic<uint32_t> mMaxMicroseconds;
+};
@@ -0,0 +1,85 @@
+//
+//  MemoryBus.cpp
+//  Evaluator
+//
+//  Shares a block of program memory between the instances in a process.
+//
+
+#include "MemoryBus.h"
+#include <algorithm>
+
+namespace MemoryBus
+{
+	Bus& Get()
+	{
+		// atomics are zero-initialized in static storage, so the bus starts out as all zeros
+		static Bus bus;
+		return bus;
+	}
+
+	Program::Value GetAddress(const size_t userMemorySize)
+	{
+		return userMemorySize > kSize ? userMemorySize - kSize : 0;
+	}
+
+	Port::Port()
+		: mBus(Get())
+		, mCount(0)
+	{
+	}
+
+	bool Port::Read(Program& program, const size_t userMemorySize)
+	{
+		// a block is short, so publishes rarely overlap a read, but this can't wait on them forever
+		static const int kMaxAttempts = 4;
+
+		mCount = std::min(kSize, userMemorySize);
+		bool consistent = false;
+		for (int attempt = 0; attempt < kMaxAttempts && !consistent; ++attempt)
+		{
+			const uint32_t before = mBus.version.load(std::memory_order_acquire);
+			if (mBus.writers.load(std::memory_order_acquire) > 0)
+			{
+				continue;
+			}
+
+			for (size_t i = 0; i < mCount; ++i)
+			{
+				mSnapshot[i] = mBus.values[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			consistent = mBus.writers.load(std::memory_order_relaxed) == 0 && mBus.version.load(std::memory_order_relaxed) == before;
+		}
+
+		// when every attempt overlapped a publish this is the last copy, which is still better than nothing.
+		// programs with 32-bit values truncate what they are given, so Write compares against what they actually got.
+		const Program::Value address = GetAddress(userMemorySize);
+		for (size_t i = 0; i < mCount; ++i)
+		{
+			program.Poke(address + i, mSnapshot[i]);
+			mSnapshot[i] = program.Peek(address + i);
+		}
+
+		return consistent;
+	}
+
+	void Port::Write(const Program& program, const size_t userMemorySize)
+	{
+		const Program::Value address = GetAddress(userMemorySize);
+		const size_t count = std::min(mCount, std::min(kSize, userMemorySize));
+
+		mBus.writers.fetch_add(1, std::memory_order_acq_rel);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Program::Value value = program.Peek(address + i);
+			if (value != mSnapshot[i])
+			{
+				mBus.values[i].store(value, std::memory_order_relaxed);
+			}
+		}
+		mBus.version.fetch_add(1, std::memory_order_release);
+		mBus.writers.fetch_sub(1, std::memory_order_release);
+	}
+}
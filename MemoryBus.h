@@ -0,0 +1,64 @@
+//
+//  MemoryBus.h
+//  Evaluator
+//
+//  A block of values shared by every instance of Evaluator in the process that has "shared memory" turned on.
+//  It appears at the end of the user memory of their programs, so one instance can write a value with @
+//  and every other one can read it with @ in their next block, eg a sequencer instance driving voice instances.
+//  Values are exchanged at block boundaries: a program sees the same bus values for a whole block,
+//  and the values it wrote during a block are published together when the block ends.
+//
+
+#pragma once
+
+#include "Program.h"
+#include <atomic>
+#include <stdint.h>
+
+namespace MemoryBus
+{
+	// how many values are on the bus
+	static const size_t kSize = 1024;
+
+	struct Bus
+	{
+		// how many ports are publishing right now, and how many publishes have finished.
+		// readers copy the values again if either changed while they were copying.
+		// writers never wait on anything, so more than one can publish at the same time.
+		std::atomic<uint32_t> writers;
+		std::atomic<uint32_t> version;
+		std::atomic<uint64_t> values[kSize];
+	};
+
+	// the bus shared by the whole process
+	Bus& Get();
+
+	// the first address of the bus in the memory of a program with this userMemorySize
+	Program::Value GetAddress(const size_t userMemorySize);
+
+	// connects a program to the bus. neither method allocates, locks, or makes system calls,
+	// so they are safe on the audio thread.
+	class Port
+	{
+	public:
+		Port();
+
+		// copy the bus into the program, before running it for a block.
+		// returns false if other ports kept publishing while copying, in which case the program
+		// might see values from two different blocks of another instance.
+		bool Read(Program& program, const size_t userMemorySize);
+		// publish the bus values that the program changed since Read, after running it for a block.
+		// values it didn't change are left alone, so ports that write different addresses don't undo each other.
+		void Write(const Program& program, const size_t userMemorySize);
+
+		// the bus values that the last Read gave the program, eg to record them
+		const Program::Value* GetValues() const { return mSnapshot; }
+		size_t GetCount() const { return mCount; }
+
+	private:
+		Bus&			mBus;
+		// what the program held at the end of Read
+		Program::Value	mSnapshot[kSize];
+		size_t			mCount;
+	};
+}
@@ -0,0 +1,128 @@
+//
+//  MemoryEncoding.cpp
+//  Evaluator
+//
+
+#include "MemoryEncoding.h"
+#include <algorithm>
+
+namespace MemoryEncoding
+{
+	// shorter runs are cheaper to write as literals than to end the literals and start a new block
+	static const size_t kMinRunLength = 3;
+
+	static void PutVarint(std::vector<uint8_t>& data, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			data.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		data.push_back((uint8_t)value);
+	}
+
+	static bool GetVarint(const uint8_t* data, size_t size, size_t& pos, uint64_t& outValue)
+	{
+		outValue = 0;
+		for (int shift = 0; shift < 64 && pos < size; shift += 7)
+		{
+			const uint8_t byte = data[pos++];
+			outValue |= (uint64_t)(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// how many times values[begin] repeats, looking no further than end
+	static size_t GetRunLength(const Program::Value* values, size_t begin, size_t end)
+	{
+		size_t i = begin + 1;
+		while (i < end && values[i] == values[begin])
+		{
+			++i;
+		}
+		return i - begin;
+	}
+
+	void Encode(const Program::Value* values, size_t count, std::vector<uint8_t>& outData)
+	{
+		outData.clear();
+
+		size_t i = 0;
+		while (i < count)
+		{
+			const size_t runLength = GetRunLength(values, i, count);
+			if (runLength >= kMinRunLength)
+			{
+				PutVarint(outData, runLength);
+				PutVarint(outData, values[i]);
+				i += runLength;
+			}
+			else
+			{
+				PutVarint(outData, 0);
+			}
+
+			// literals continue until the next run that is long enough to be worth a block of its own
+			const size_t literalBegin = i;
+			while (i < count && GetRunLength(values, i, std::min(count, i + kMinRunLength)) < kMinRunLength)
+			{
+				++i;
+			}
+
+			PutVarint(outData, i - literalBegin);
+			for (size_t l = literalBegin; l < i; ++l)
+			{
+				PutVarint(outData, values[l]);
+			}
+		}
+	}
+
+	bool Decode(const uint8_t* data, size_t size, Program::Value* outValues, size_t count)
+	{
+		size_t pos = 0;
+		size_t written = 0;
+		while (pos < size)
+		{
+			uint64_t runLength;
+			if (!GetVarint(data, size, pos, runLength) || runLength > count - written)
+			{
+				return false;
+			}
+
+			if (runLength > 0)
+			{
+				uint64_t value;
+				if (!GetVarint(data, size, pos, value))
+				{
+					return false;
+				}
+				for (uint64_t r = 0; r < runLength; ++r)
+				{
+					outValues[written++] = value;
+				}
+			}
+
+			uint64_t literalCount;
+			if (!GetVarint(data, size, pos, literalCount) || literalCount > count - written)
+			{
+				return false;
+			}
+
+			for (uint64_t l = 0; l < literalCount; ++l)
+			{
+				uint64_t value;
+				if (!GetVarint(data, size, pos, value))
+				{
+					return false;
+				}
+				outValues[written++] = value;
+			}
+		}
+
+		return written == count;
+	}
+}
@@ -0,0 +1,29 @@
+//
+//  MemoryEncoding.h
+//  Evaluator
+//
+//  Compact encoding of the memory of a Program, used to save it with the plugin state.
+//  Most of the memory of a typical program is zero, or long stretches of the same value,
+//  so the encoding is a sequence of blocks that each hold a run of one repeated value
+//  followed by literal values, with every number written as a variable-length integer.
+//
+//  A block is: varint run length, varint run value (omitted when the run length is 0),
+//  varint literal count, and that many varint literal values.
+//
+
+#pragma once
+
+#include "Program.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace MemoryEncoding
+{
+	// replaces the contents of outData with the encoding of count values
+	void Encode(const Program::Value* values, size_t count, std::vector<uint8_t>& outData);
+
+	// fills outValues with exactly count values decoded from data.
+	// returns false if the data is truncated or decodes to a different number of values.
+	bool Decode(const uint8_t* data, size_t size, Program::Value* outValues, size_t count);
+}
@@ -23,11 +23,15 @@ enum EParams
 	// it will be set to be not automatible, which will hide it in the VST3 version, at least.
 	kTempo,
 	kMidiNoteResetsTime, // does receiving a note-on set t to zero
+	kSaveProgramMemory, // include the memory of the program in the saved state so it doesn't start cold when reloaded
+	kValueWidth, // the Program::ValueWidth that programs are compiled with
+	kSharedMemory, // map the process-wide MemoryBus into the end of program memory
 	kNumParams,
 	
 	// used for text edit fields so the UI can call OnParamChange
 	kExpression = 101,
-	kExpressionLengthMax = 1024,
+	// programs can be generated by other tools, so we allow much more than anyone would type
+	kExpressionLengthMax = 1024 * 1024,
 	
 	kWatch = 202, // starting paramIdx for watches
 	kWatchNum = 10, // total number of watches available
@@ -65,4 +69,17 @@ enum TransportState
 	kTransportStopped = 0,
 	kTransportPaused,
 	kTransportPlaying
-};
\ No newline at end of file
+};
+
+// what is shown in the console below the program text, the console title cycles through these when clicked
+enum ConsoleMode
+{
+	kConsoleModeState = 0, // values of t, m, q, w, n, and v
+	kConsoleModeCost, // estimated cpu cost of the most expensive statements in the program
+	kConsoleModeLatency, // histogram of how long it takes to process each block
+	kConsoleModeTrace, // status of the trace recording
+	kConsoleModeRecord, // status of the input recording used by the replay tool
+	kConsoleModeMemory, // how much memory this instance and all instances in the process are using
+
+	kConsoleModeCount
+};
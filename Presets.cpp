@@ -7,7 +7,7 @@
 //
 
 #include "Presets.h"
-#include "Evaluator.h" // for the TimeType enum
+#include "Params.h" // for the RunMode enum
 
 #define CR "\n"
 
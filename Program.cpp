@@ -14,7 +14,10 @@
 #include <ctype.h>
 #include <deque>
 #include <math.h>
+#include <stdarg.h>
 #include <map>
+#include <string.h>
+#include <algorithm>
 
 const std::map<Program::Char, Program::Op::Code> UnaryOperators =
 {
@@ -32,6 +35,42 @@ const std::map<Program::Char, Program::Op::Code> UnaryOperators =
 	{ 'R', Program::Op::RND }
 };
 
+// functions that are built in to the language, which compile to a single instruction after their arguments.
+// unlike functions defined with def, these take the address of memory rather than a value for some arguments.
+struct Builtin
+{
+	const char* name;
+	Program::Op::Code code;
+	size_t argCount;
+	// the first argument is a variable or @address where the function keeps its state between samples.
+	// it's compiled like the left side of an assignment, so the instruction gets the address instead of the value.
+	bool hasState;
+};
+
+const Builtin Builtins[] =
+{
+	{ "tap", Program::Op::TAP, 3, false },
+	{ "rec", Program::Op::REC, 3, false },
+	{ "copy", Program::Op::CPY, 3, false },
+	{ "fill", Program::Op::FIL, 3, false },
+	{ "lpf", Program::Op::LPF, 3, true },
+	{ "hpf", Program::Op::HPF, 3, true },
+	{ "slew", Program::Op::SLW, 3, true },
+	{ "env", Program::Op::ENV, 3, true },
+};
+
+static const Builtin* FindBuiltin(const std::string& name)
+{
+	for (const Builtin& builtin : Builtins)
+	{
+		if (name == builtin.name)
+		{
+			return &builtin;
+		}
+	}
+	return nullptr;
+}
+
 // used to store const values relating to [*], 
 // which allows for reading the sum of all inputs or writing the same value to all outputs.
 namespace Wildcard
@@ -40,22 +79,41 @@ namespace Wildcard
 	const Program::Value Value = -1;
 }
 
-Program::Program(const std::vector<Op>& inOps, const size_t userMemorySize)
+size_t Program::GetTotalMemorySize(const size_t userMemorySize)
+{
+	// 256 to enough room for all possible values of Char
+	return userMemorySize + 256;
+}
+
+Program::Program(const std::vector<Op>& inOps, const size_t userMemorySize, const ValueWidth valueWidth)
 	: ops(inOps)
 	, userMemSize(userMemorySize)
-	, memSize(userMemorySize + 256) // 256 to enough room for all possible values of Char
+	, memSize(GetTotalMemorySize(userMemorySize))
+	, width(valueWidth)
+	, runError(RE_NONE)
+	, runCount(0)
 	, rng(std::chrono::system_clock::now().time_since_epoch().count())
 {
-	mem = new Value[memSize];
-	memset(mem, 0, sizeof(Value)*memSize);
 	// initialize cc memory space - we want to accurately represent the midi device
 	memset(cc, 0, sizeof(cc));
 	memset(vc, 0, sizeof(vc));
+	memset(errors, 0, sizeof(errors));
+}
+
+template<typename V>
+ProgramT<V>::ProgramT(const std::vector<Op>& inOps, const size_t userMemorySize)
+	: Program(inOps, userMemorySize, sizeof(V) == sizeof(uint32_t) ? VW_32 : VW_64)
+{
+	mem = new V[memSize];
+	memset(mem, 0, sizeof(V)*memSize);
 	// default sample rate so the F operator will function
 	Set('~', 44100);
+	// Run must not allocate, so make room for the deepest the stack can get up front
+	stack.reserve(GetMaxStackDepth() + 1);
 }
 
-Program::~Program()
+template<typename V>
+ProgramT<V>::~ProgramT()
 {
 	delete[] mem;
 }
@@ -101,11 +159,48 @@ const char * Program::GetErrorString(Program::CompileError error)
 	case Program::CE_MISSING_PUT:
 		return "The program does not output any values.\n"
 			   "Assign something to [0], [1], or [*].";
+	case Program::CE_NESTED_TOO_DEEPLY:
+		return "Too many nested parens, brackets,\nternaries, assignments, or blocks.";
+	case Program::CE_MISSING_BLOCK:
+		return "Expected '{' to begin a block.\n(eg: every 64 { a = a + 1; })";
+	case Program::CE_ILLEGAL_REPEAT_COUNT:
+		return "The count of 'repeat' must be a number\nno larger than 1024. (eg: repeat 8 (i) { })";
+	case Program::CE_PROGRAM_TOO_LONG:
+		return "The program is too long.\n(repeat blocks or function calls might be expanding too much)";
+	case Program::CE_ILLEGAL_FUNCTION_DEFINITION:
+		return "Illegal function definition.\nNames are lowercase words not already used,\nand def must be at the top level.\n(eg: def saw(f) = t*f;)";
+	case Program::CE_UNKNOWN_FUNCTION:
+		return "Unknown function.\nFunctions must be defined with def\nbefore they are used.";
+	case Program::CE_WRONG_ARGUMENT_COUNT:
+		return "Wrong number of arguments\nin a call to a function.";
+	case Program::CE_ILLEGAL_STATE_ARGUMENT:
+		return "The first argument of lpf, hpf, slew, and env\nmust be a variable or memory address.\n(eg: lpf(a, x, 32) or lpf(@100, x, 32))";
 	default:
 		return "Unknown";
 	}
 }
 
+// a function defined with def, which is compiled again in place of every call to it
+struct Function
+{
+	std::string name;
+	// the variable of each parameter
+	std::vector<int> params;
+	int bodyStart;
+};
+
+// a call to a function that is being compiled
+struct Call
+{
+	const Function* function;
+	// where each argument starts in source, or -1 while checking the definition, when parameters act like variables
+	std::vector<int> args;
+	// index of the call that contains this one, because the arguments are compiled as if they were written there
+	int caller;
+	// the repeat indices used by the arguments for the same reason
+	int repeatIndex[26];
+};
+
 // used during compilation to keep track of things
 struct CompilationState
 {
@@ -115,8 +210,23 @@ struct CompilationState
 	int parenCount;
 	int bracketCount;
 	int parseDepth;
+	// how many calls to Parse we are inside of, which is limited so that deeply nested code can't overflow the stack
+	int nestingDepth;
+	// for each variable, the iteration of the repeat block using it as an index, or -1 when it's a normal variable
+	int repeatIndex[26];
+	// functions are stored in a deque so that calls can point to them while more are defined
+	std::deque<Function> functions;
+	// the chain of calls being compiled, and the index of the innermost one or -1
+	std::vector<Call> calls;
+	int call;
+	// parseDepth of the body of the function being compiled, where the semi-colon that ends it stops parsing
+	int bodyDepth;
+	// true while compiling the arguments of a call only to find where they end, when calls in them don't need to be inlined
+	bool checkingArguments;
 	Program::CompileError error;
 	std::vector<Program::Op> ops;
+	// parsePos at the time each op was pushed, used to map instructions back to lines of source
+	std::vector<int> positions;
 
 	CompilationState(const Program::Char* inSource, const size_t userMemorySize)
 		: source(inSource)
@@ -125,36 +235,70 @@ struct CompilationState
 		, parenCount(0)
 		, bracketCount(0)
 		, parseDepth(0)
+		, nestingDepth(0)
+		, call(-1)
+		, bodyDepth(0)
+		, checkingArguments(false)
 		, error(Program::CE_NONE)
 	{
+		for (int& index : repeatIndex)
+		{
+			index = -1;
+		}
 
 	}
 
 	// some helpers
 	Program::Char operator*() const { return source[parsePos]; }
-	size_t Push(Program::Op::Code code, Program::Value value = 0) { ops.push_back(Program::Op(code, value)); return ops.size()-1; }
-	void SkipWhitespace()
+	// length of the function name at parsePos, names are two or more lowercase letters, digits, or underscores
+	int NameLength() const
 	{
-		while (isspace(source[parsePos]))
+		int length = 0;
+		while (islower(source[parsePos + length]) || (length > 0 && (isdigit(source[parsePos + length]) || source[parsePos + length] == '_')))
 		{
-			++parsePos;
+			++length;
 		}
-
-		// also skip any commented text while we are at it
-		if (source[parsePos] == '/' && source[parsePos + 1] == '/')
+		return length > 1 ? length : 0;
+	}
+	// which parameter of the function being compiled a variable is, or -1 if it isn't one
+	int ParameterIndex(const Program::Char var) const
+	{
+		if (call >= 0)
 		{
-			parsePos += 2;
-			// read to the end of line or end of file
-			while (source[parsePos] != '\n' && source[parsePos] != '\0')
+			const std::vector<int>& params = calls[call].function->params;
+			for (size_t i = 0; i < params.size(); ++i)
+			{
+				if (params[i] == var - 'a')
+				{
+					return (int)i;
+				}
+			}
+		}
+		return -1;
+	}
+	size_t Push(Program::Op::Code code, Program::Value value = 0) { ops.push_back(Program::Op(code, value)); positions.push_back(parsePos); return ops.size()-1; }
+	void Pop() { ops.pop_back(); positions.pop_back(); }
+	void SkipWhitespace()
+	{
+		for (;;)
+		{
+			while (isspace(source[parsePos]))
 			{
 				++parsePos;
 			}
 
-			// if we reached end of line and this is not end of file
-			// then we might have more whitespace to skip on the next line
-			if (source[parsePos] != '\0')
+			// also skip any commented text while we are at it
+			if (source[parsePos] != '/' || source[parsePos + 1] != '/')
+			{
+				return;
+			}
+
+			parsePos += 2;
+			// read to the end of line or end of file,
+			// then go around again because there might be more whitespace and comments on the next line
+			while (source[parsePos] != '\n' && source[parsePos] != '\0')
 			{
-				SkipWhitespace();
+				++parsePos;
 			}
 		}
 	}
@@ -162,26 +306,189 @@ struct CompilationState
 
 // forward declare Parse so that we can recurse back to it from anywhere.
 static int Parse(CompilationState& state);
+static bool AnalyzeWidth32(const std::vector<Program::Op>& ops, const size_t userMemorySize);
+
+// push the opcodes for the unary operators found in source between start and end,
+// starting with the one closest to the operand. we don't push a NOP because it's pointless to have any.
+static void PushUnaryOperators(CompilationState& state, const int start, const int end)
+{
+	for (int pos = end - 1; pos >= start; --pos)
+	{
+		const Program::Op::Code code = UnaryOperators.find(state.source[pos])->second;
+		if (code != Program::Op::NOP)
+		{
+			state.Push(code);
+		}
+	}
+}
+
+// compile the argument for a parameter where the parameter is used, so each use gets a copy of the expression passed in.
+// this is done in the context of the call, since the argument might use parameters of a function that contains the call.
+static int ParseArgument(CompilationState& state, const int param)
+{
+	const Call& call = state.calls[state.call];
+	const int argStart = call.args[param];
+	if (argStart < 0 || state.checkingArguments)
+	{
+		// checking the definition or the arguments of another call, so the parameter is compiled like a variable.
+		// this also allows it to be assigned to, which is checked again when the real argument is compiled.
+		state.Push(Program::Op::PSH, Program::GetAddress('a' + call.function->params[param], state.userMemSize));
+		state.Push(Program::Op::PEK);
+		return 0;
+	}
+
+	const int returnPos = state.parsePos;
+	const int calleeCall = state.call;
+	const int calleeBodyDepth = state.bodyDepth;
+	int calleeRepeatIndex[26];
+	std::copy(state.repeatIndex, state.repeatIndex + 26, calleeRepeatIndex);
+
+	state.parsePos = argStart;
+	state.call = call.caller;
+	state.bodyDepth = 0;
+	std::copy(call.repeatIndex, call.repeatIndex + 26, state.repeatIndex);
+	if (Parse(state)) return 1;
+
+	state.parsePos = returnPos;
+	state.call = calleeCall;
+	state.bodyDepth = calleeBodyDepth;
+	std::copy(calleeRepeatIndex, calleeRepeatIndex + 26, state.repeatIndex);
+	return 0;
+}
+
+// compile a call to a function by compiling the body of the function in its place.
+// this means calls cost nothing at runtime and the result is the same as if the body had been written out with the arguments in it.
+// calls to built in functions compile the arguments followed by the instruction for the function.
+static int ParseCall(CompilationState& state)
+{
+	const int nameLength = state.NameLength();
+	const std::string name(state.source + state.parsePos, nameLength);
+	const Builtin* builtin = FindBuiltin(name);
+	const Function* function = nullptr;
+	for (const Function& defined : state.functions)
+	{
+		if (defined.name == name)
+		{
+			function = &defined;
+			break;
+		}
+	}
+	if (builtin == nullptr && function == nullptr)
+	{
+		state.error = Program::CE_UNKNOWN_FUNCTION;
+		return 1;
+	}
+	state.parsePos += nameLength;
+	state.SkipWhitespace();
+	if (*state != '(')
+	{
+		state.error = Program::CE_MISSING_PAREN;
+		return 1;
+	}
+	state.parsePos++;
+	state.parenCount++;
+
+	// find where each argument starts, compiling them to check them.
+	// for a defined function that is then thrown away, so calls in the arguments don't need to be inlined yet.
+	Call call;
+	call.function = function;
+	call.caller = state.call;
+	std::copy(state.repeatIndex, state.repeatIndex + 26, call.repeatIndex);
+	const bool wasCheckingArguments = state.checkingArguments;
+	state.checkingArguments = wasCheckingArguments || builtin == nullptr;
+	const size_t opsBefore = state.ops.size();
+	state.SkipWhitespace();
+	if (*state != ')')
+	{
+		for (;;)
+		{
+			call.args.push_back(state.parsePos);
+			if (Parse(state)) return 1;
+			if (call.args.size() == 1 && builtin != nullptr && builtin->hasState)
+			{
+				// remove the PEK to leave the address on the stack, like ParsePOK does
+				if (state.ops.back().code != Program::Op::PEK)
+				{
+					state.error = Program::CE_ILLEGAL_STATE_ARGUMENT;
+					return 1;
+				}
+				state.Pop();
+			}
+			if (*state != ',')
+			{
+				break;
+			}
+			state.parsePos++;
+		}
+	}
+	if (*state != ')')
+	{
+		state.error = Program::CE_MISSING_PAREN;
+		return 1;
+	}
+	if (call.args.size() != (builtin != nullptr ? builtin->argCount : function->params.size()))
+	{
+		state.error = Program::CE_WRONG_ARGUMENT_COUNT;
+		return 1;
+	}
+	state.parsePos++;
+	state.parenCount--;
+	state.checkingArguments = wasCheckingArguments;
+
+	if (builtin != nullptr)
+	{
+		state.Push(builtin->code);
+		return 0;
+	}
+	state.ops.resize(opsBefore);
+	state.positions.resize(opsBefore);
+
+	// when this call is itself in arguments that are being checked, its result is thrown away, so we only need something that stands in for it
+	if (state.checkingArguments)
+	{
+		state.Push(Program::Op::PSH, 0);
+		state.Push(Program::Op::PEK);
+		return 0;
+	}
+
+	const int returnPos = state.parsePos;
+	const int callerCall = state.call;
+	const int callerBodyDepth = state.bodyDepth;
+
+	// the body only sees its parameters and normal variables, not the repeat indices where it is called
+	state.calls.push_back(call);
+	state.call = (int)state.calls.size() - 1;
+	state.parsePos = function->bodyStart;
+	state.bodyDepth = state.parseDepth + 1;
+	std::fill(state.repeatIndex, state.repeatIndex + 26, -1);
+	if (Parse(state)) return 1;
+
+	if (state.ops.size() > Program::kMaxInstructionCount)
+	{
+		state.error = Program::CE_PROGRAM_TOO_LONG;
+		return 1;
+	}
+
+	std::copy(state.calls.back().repeatIndex, state.calls.back().repeatIndex + 26, state.repeatIndex);
+	state.calls.pop_back();
+	state.call = callerCall;
+	state.bodyDepth = callerBodyDepth;
+	state.parsePos = returnPos;
+	return 0;
+}
 
 static int ParseAtom(CompilationState& state)
 {
 	// Skip spaces
 	state.SkipWhitespace();
 
-	std::stack<Program::Op::Code> unaryOps;
-
-	// see if the current character is a unary operator
-	// and push the appropriate opcode onto the unaryOps stack.
-	// we don't push a NOP because it's pointless to have any.
+	// skip over any unary operators, they are applied in reverse order after the atom has been parsed.
+	const int unaryStart = state.parsePos;
 	while( UnaryOperators.count(*state) )
 	{
-		const Program::Op::Code code = UnaryOperators.find(*state)->second;
-		if ( code != Program::Op::NOP )
-		{
-			unaryOps.push(code);
-		}
 		state.parsePos++;
 	}
+	const int unaryEnd = state.parsePos;
 
 	// Check if there is parenthesis
 	if (*state == '(')
@@ -198,11 +505,7 @@ static int ParseAtom(CompilationState& state)
 		state.parsePos++;
 		state.parenCount--;
 
-		while (!unaryOps.empty())
-		{
-			state.Push(unaryOps.top());
-			unaryOps.pop();
-		}
+		PushUnaryOperators(state, unaryStart, unaryEnd);
 
 		return 0;
 	}
@@ -234,18 +537,29 @@ static int ParseAtom(CompilationState& state)
 
 		state.Push(Program::Op::GET);
 
-		while (!unaryOps.empty())
-		{
-			state.Push(unaryOps.top());
-			unaryOps.pop();
-		}
+		PushUnaryOperators(state, unaryStart, unaryEnd);
 
 		return 0;
 	}
 
 	if (isalpha(*state))
 	{
-		if (islower(*state))
+		if (state.NameLength() > 0)
+		{
+			if (ParseCall(state)) return 1;
+		}
+		else if (islower(*state) && state.ParameterIndex(*state) >= 0)
+		{
+			if (ParseArgument(state, state.ParameterIndex(*state))) return 1;
+			state.parsePos++;
+		}
+		else if (islower(*state) && state.repeatIndex[*state - 'a'] >= 0)
+		{
+			// the index of a repeat block is a constant, which also means it can't be assigned to
+			state.Push(Program::Op::PSH, state.repeatIndex[*state - 'a']);
+			state.parsePos++;
+		}
+		else if (islower(*state))
 		{
 			const Program::Char var = *state;
 			// push the address of the variable, which peek will need
@@ -276,11 +590,7 @@ static int ParseAtom(CompilationState& state)
 		state.parsePos += (endPtr - startPtr) / sizeof(Program::Char);
 	}
 
-	while (!unaryOps.empty())
-	{
-		state.Push(unaryOps.top());
-		unaryOps.pop();
-	}
+	PushUnaryOperators(state, unaryStart, unaryEnd);
 
 	return 0;
 }
@@ -492,7 +802,7 @@ static int ParseCND(CompilationState& state)
 		bool hasPop = state.ops.back().code == Program::Op::POP;
 		if (hasPop)
 		{
-			state.ops.pop_back();
+			state.Pop();
 		}
 		
 		// add a JMP instruction so we can skip what comes next, which is the "false" part of the expression
@@ -560,6 +870,8 @@ static int ParsePOK(CompilationState& state)
 		{
 			return 0;
 		}
+		// the assignment is attributed to the equals sign so that it maps to the right line
+		const int assignPos = state.parsePos;
 		state.parsePos++;
 		// PEK and GET work by popping a value from the stack to use as the lookup address.
 		// so when we want to POK or PUT, we can use that same address to know where in memory to assign the result of the right side.
@@ -571,7 +883,7 @@ static int ParsePOK(CompilationState& state)
 		Program::Op::Code code = state.ops.back().code;
 		if (code == Program::Op::PEK || code == Program::Op::GET)
 		{
-			state.ops.pop_back();
+			state.Pop();
 		}
 		else
 		{
@@ -623,18 +935,21 @@ static int ParsePOK(CompilationState& state)
 		// the statement on the right side of the '=' might have ended with a semi-colon,
 		// which means the last op will be a POP. we need to POK or PUT before that.
 		const bool hasPOP = state.ops.back().code == Program::Op::POP;
+		const int popPos = state.positions.back();
 		if (hasPOP)
 		{
-			state.ops.pop_back();
+			state.Pop();
 		}
 		switch (code)
 		{
 		case Program::Op::PEK:
 			state.Push(Program::Op::POK, pcount);
+			state.positions.back() = assignPos;
 			break;
 
 		case Program::Op::GET:
 			state.Push(Program::Op::PUT, pcount);
+			state.positions.back() = assignPos;
 			break;
 			
 		// fix warning in osx
@@ -644,6 +959,7 @@ static int ParsePOK(CompilationState& state)
 		if (hasPOP)
 		{
 			state.Push(Program::Op::POP);
+			state.positions.back() = popPos;
 		}
 	}
 }
@@ -651,12 +967,19 @@ static int ParsePOK(CompilationState& state)
 // we start here so that we don't have to change the forward declare for ParseAtom when we add another level
 static int Parse(CompilationState& state)
 {
+	if (++state.nestingDepth > Program::kMaxNestingDepth)
+	{
+		state.error = Program::CE_NESTED_TOO_DEEPLY;
+		return 1;
+	}
+
 	state.parseDepth++;
 	{
 		if (ParsePOK(state)) return 1;
 		// check for statement termination
 		state.SkipWhitespace();
-		if (*state == ';')
+		// the semi-colon that ends the body of a function is left for the def to deal with
+		if (*state == ';' && state.parseDepth != state.bodyDepth)
 		{
 			// if we have recursed into Parse due to opening parens
 			// or due to parsing a section of a ternary operator,
@@ -676,164 +999,1820 @@ static int Parse(CompilationState& state)
 		}
 	}
 	state.parseDepth--;
+	state.nestingDepth--;
 	return 0;
 }
 
-Program* Program::Compile(const Char* source, const size_t userMemorySize, CompileError& outError, int& outErrorPosition)
-{
-	Program* program = nullptr;
-	CompilationState state(source, userMemorySize);
+static int ParseStatement(CompilationState& state, bool& outTerminated);
 
-	while (*state != '\0')
+// parse the statements from an opening brace to the closing one, and a semi-colon after it because it's an easy habit to have.
+static int ParseBlock(CompilationState& state)
+{
+	state.SkipWhitespace();
+	if (*state != '{')
 	{
-		if (Parse(state)) break;
-		// if we aren't at the end yet, we should have a POP as the last op.
-		if (*state != '\0' && state.ops.back().code != Op::POP)
-		{
-			state.error = CE_UNEXPECTED_CHAR;
-			break;
-		}
+		state.error = Program::CE_MISSING_BLOCK;
+		return 1;
 	}
+	state.parsePos++;
 
-	// final error checking
-	if (state.error == CE_NONE)
+	for (;;)
 	{
-		// Now, expr should point to '\0', and _paren_count should be zero
-		if (state.parenCount != 0 || *state == ')')
-		{
-			state.error = CE_MISSING_PAREN;
-		}
-		else if (*state != '\0')
+		state.SkipWhitespace();
+		if (*state == '}')
 		{
-			state.error = CE_UNEXPECTED_CHAR;
+			break;
 		}
-		// make sure the program includes at least one PUT.
-		// we consider it a compilation error if it doesn't
-		// since the resulting program would output nothing 
-		// and therefore be useless.
-		else
+
+		bool terminated = false;
+		if (ParseStatement(state, terminated)) return 1;
+		if (!terminated)
 		{
-			bool hasPut = false;
-			for (auto& op : state.ops)
+			// the last statement in a block doesn't need a semi-colon, but its value still needs to be popped
+			state.SkipWhitespace();
+			if (*state != '}')
 			{
-				hasPut = hasPut || op.code == Op::PUT;
+				state.error = *state == '\0' ? Program::CE_MISSING_BRACE : Program::CE_UNEXPECTED_CHAR;
+				return 1;
 			}
+			state.Push(Program::Op::POP);
+			break;
+		}
 
-			if (!hasPut)
-			{
-				state.error = CE_MISSING_PUT;
-			}
+		if (*state == '\0')
+		{
+			state.error = Program::CE_MISSING_BRACE;
+			return 1;
 		}
 	}
 
-	// now create a program or don't
-	if (state.error == CE_NONE)
-	{
-		outError = CE_NONE;
-		outErrorPosition = -1;
-		program = new Program(state.ops, userMemorySize);
-	}
-	else
+	state.parsePos++;
+	state.SkipWhitespace();
+	if (*state == ';')
 	{
-		outError = state.error;
-		outErrorPosition = state.parsePos;
+		state.parsePos++;
+		state.SkipWhitespace();
 	}
 
-	return program;
+	return 0;
 }
-#pragma endregion
 
-//////////////////////////////////////////////////////////////////////////
-// EXECUTION
-//////////////////////////////////////////////////////////////////////////
-#pragma region Execution
+// every N { statements } runs the statements only when t is a multiple of N, so values assigned in it are held in between.
+// the EVR instruction jumps past the statements the rest of the time.
+static int ParseEvery(CompilationState& state)
+{
+	// skip the keyword
+	state.parsePos += 5;
 
-const char * Program::GetErrorString(Program::RuntimeError error)
+	state.Push(Program::Op::PSH, Program::GetAddress('t', state.userMemSize));
+	state.Push(Program::Op::PEK);
+
+	// the rate is an expression, which we parse as if it were in parens so that it can't contain a semi-colon
+	state.parseDepth++;
+	if (Parse(state)) return 1;
+	state.parseDepth--;
+
+	const size_t evrOpAddr = state.Push(Program::Op::EVR);
+	if (ParseBlock(state)) return 1;
+	state.ops[evrOpAddr].val = state.ops.size();
+
+	return 0;
+}
+
+// repeat K (i) { statements } is unrolled into K copies of the statements, which are compiled with i replaced by 0 through K-1.
+// this keeps the guarantee that programs only jump forward, so the stack depth and cost of every program are still known.
+static int ParseRepeat(CompilationState& state)
 {
-	switch (error)
+	// skip the keyword
+	state.parsePos += 6;
+	state.SkipWhitespace();
+
+	// the count has to be a number, because we need to know it while compiling
+	const Program::Char* startPtr = state.source + state.parsePos;
+	Program::Char* endPtr = nullptr;
+	const Program::Value count = (Program::Value)strtoull(startPtr, &endPtr, 0);
+	if (endPtr == startPtr || count > Program::kMaxRepeatCount)
 	{
-	case RE_NONE:
-		return "None";
-	case RE_DIVIDE_BY_ZERO:
-		return "Divide by zero";
-	case RE_MISSING_OPERAND:
-		return "Missing operand";
-	case RE_MISSING_OPCODE:
-		return "Unimplemented opcode";
-	case RE_INCONSISTENT_STACK:
-		return "Inconsistent stack";
-	case RE_EMPTY_PROGRAM:
-		return "Empty program (instruction count is zero)";
-	case RE_GET_OUT_OF_BOUNDS:
-		return "Input access is out of bounds";
-	case RE_PUT_OUT_OF_BOUNDS:
-		return "Output access is out of bounds";
-	default:
-		return "Unknown";
+		state.error = Program::CE_ILLEGAL_REPEAT_COUNT;
+		return 1;
 	}
-}
+	state.parsePos += (endPtr - startPtr) / sizeof(Program::Char);
+	state.SkipWhitespace();
 
-Program::RuntimeError Program::Run(Value* results, const size_t size)
-{
-	RuntimeError error = RE_NONE;
-	const uint64_t icount = GetInstructionCount();
-	if (icount > 0)
+	// the index variable is optional
+	int var = -1;
+	if (*state == '(')
 	{
-		pc = 0;
-		for (; pc < icount && error == RE_NONE; ++pc)
+		state.parsePos++;
+		state.SkipWhitespace();
+		if (!islower(*state))
+		{
+			state.error = Program::CE_ILLEGAL_VARIABLE_NAME;
+			return 1;
+		}
+		var = *state - 'a';
+		state.parsePos++;
+		state.SkipWhitespace();
+		if (*state != ')')
 		{
-			error = Exec(ops[pc], results, size);
+			state.error = Program::CE_MISSING_PAREN;
+			return 1;
 		}
+		state.parsePos++;
+	}
 
-		// under error-free execution we should have either 1 or 0 values in the stack.
-		// 1 when a program terminates with the result of an expression (eg: t*Fn)
-		// 0 when a program terminates with a POP (eg: t*Fn;)
-		// in the case of the POP, the value of the expression will already be in result.
-		if (error == RE_NONE)
+	// an outer repeat might be using the same variable
+	const int outerIndex = var >= 0 ? state.repeatIndex[var] : -1;
+	const size_t opsBefore = state.ops.size();
+	const int blockStart = state.parsePos;
+	// the block is parsed even when the count is zero so that it still has to compile, then we throw the result away
+	for (Program::Value i = 0; i == 0 || i < count; ++i)
+	{
+		if (var >= 0)
 		{
-			if (stack.size() > 1)
-			{
-				error = RE_INCONSISTENT_STACK;
-			}
+			state.repeatIndex[var] = (int)i;
 		}
+		state.parsePos = blockStart;
+		if (ParseBlock(state)) return 1;
 
-		// clear the stack so it doesn't explode in size due to continual runtime errors
-		while (stack.size() > 0)
+		if (state.ops.size() > Program::kMaxInstructionCount)
 		{
-			stack.pop();
+			state.error = Program::CE_PROGRAM_TOO_LONG;
+			return 1;
 		}
 	}
-	else
+
+	if (count == 0)
 	{
-		error = RE_EMPTY_PROGRAM;
+		state.ops.resize(opsBefore);
+		state.positions.resize(opsBefore);
 	}
 
-	return error;
-}
+	if (var >= 0)
+	{
+		state.repeatIndex[var] = outerIndex;
+	}
 
-#define POP1 if ( stack.size() < 1 ) goto bad_stack; Value a = stack.top(); stack.pop();
-#define POP2 if ( stack.size() < 2 ) goto bad_stack; Value b = stack.top(); stack.pop(); Value a = stack.top(); stack.pop();
-#define POP3 if ( stack.size() < 3 ) goto bad_stack; Value c = stack.top(); stack.pop(); Value b = stack.top(); stack.pop(); Value a = stack.top(); stack.pop();
-#define POP(n) if (stack.size() < n) goto bad_stack; std::vector<Value> args; for(int i = 0; i < n; ++i) { args.push_back(stack.top()); stack.pop(); }
+	return 0;
+}
+
+static bool IsKeyword(const Program::Char* text, const char* keyword)
+{
+	const size_t length = strlen(keyword);
+	return strncmp(text, keyword, length) == 0 && !isalnum(text[length]) && text[length] != '_';
+}
+
+// def name(x, y) = expression; defines a function that is compiled in place of each call to it.
+// the body is compiled once here to check it, with the parameters acting like variables, and then thrown away.
+static int ParseDefinition(CompilationState& state)
+{
+	// skip the keyword
+	state.parsePos += 3;
+	state.SkipWhitespace();
+
+	Function function;
+	const int nameLength = state.NameLength();
+	function.name.assign(state.source + state.parsePos, nameLength);
+	bool legal = nameLength > 0 && function.name != "def" && function.name != "every" && function.name != "repeat" && FindBuiltin(function.name) == nullptr;
+	for (const Function& defined : state.functions)
+	{
+		legal = legal && defined.name != function.name;
+	}
+	state.parsePos += nameLength;
+	state.SkipWhitespace();
+	legal = legal && *state == '(';
+	if (!legal)
+	{
+		state.error = Program::CE_ILLEGAL_FUNCTION_DEFINITION;
+		return 1;
+	}
+	state.parsePos++;
+
+	// parameters are single variables, separated by commas
+	state.SkipWhitespace();
+	while (*state != ')')
+	{
+		const int var = *state - 'a';
+		if (!islower(*state) || std::find(function.params.begin(), function.params.end(), var) != function.params.end())
+		{
+			state.error = Program::CE_ILLEGAL_FUNCTION_DEFINITION;
+			return 1;
+		}
+		function.params.push_back(var);
+		state.parsePos++;
+		state.SkipWhitespace();
+		if (*state == ',')
+		{
+			state.parsePos++;
+			state.SkipWhitespace();
+		}
+		else if (*state != ')')
+		{
+			state.error = Program::CE_MISSING_PAREN;
+			return 1;
+		}
+	}
+	state.parsePos++;
+	state.SkipWhitespace();
+	if (*state != '=')
+	{
+		state.error = Program::CE_ILLEGAL_FUNCTION_DEFINITION;
+		return 1;
+	}
+	state.parsePos++;
+	function.bodyStart = state.parsePos;
+
+	Call check;
+	check.function = &function;
+	check.args.assign(function.params.size(), -1);
+	check.caller = -1;
+	std::copy(state.repeatIndex, state.repeatIndex + 26, check.repeatIndex);
+	state.calls.push_back(check);
+	state.call = 0;
+	state.bodyDepth = state.parseDepth + 1;
+	const size_t opsBefore = state.ops.size();
+	if (Parse(state)) return 1;
+	if (*state != ';' && *state != '\0')
+	{
+		state.error = Program::CE_UNEXPECTED_CHAR;
+		return 1;
+	}
+	state.ops.resize(opsBefore);
+	state.positions.resize(opsBefore);
+	state.calls.pop_back();
+	state.call = -1;
+	state.bodyDepth = 0;
+
+	if (*state == ';')
+	{
+		state.parsePos++;
+		state.SkipWhitespace();
+	}
+
+	state.functions.push_back(function);
+	return 0;
+}
+
+// a statement is a function definition, an every block, a repeat block, or an expression.
+// outTerminated is false when the statement is an expression that didn't end with a semi-colon, which leaves its value on the stack.
+static int ParseStatement(CompilationState& state, bool& outTerminated)
+{
+	state.SkipWhitespace();
+	const Program::Char* text = state.source + state.parsePos;
+	if (IsKeyword(text, "def"))
+	{
+		// functions are only defined at the top level, so that every one of them is defined exactly once
+		if (state.nestingDepth != 0)
+		{
+			state.error = Program::CE_ILLEGAL_FUNCTION_DEFINITION;
+			return 1;
+		}
+		if (ParseDefinition(state)) return 1;
+		outTerminated = true;
+		return 0;
+	}
+
+	const bool isEvery = IsKeyword(text, "every");
+	const bool isRepeat = IsKeyword(text, "repeat");
+	if (!isEvery && !isRepeat)
+	{
+		if (Parse(state)) return 1;
+		outTerminated = state.ops.back().code == Program::Op::POP;
+		return 0;
+	}
+
+	// blocks contain statements, so they count towards the nesting limit like parens do
+	if (++state.nestingDepth > Program::kMaxNestingDepth)
+	{
+		state.error = Program::CE_NESTED_TOO_DEEPLY;
+		return 1;
+	}
+
+	if (isEvery ? ParseEvery(state) : ParseRepeat(state)) return 1;
+
+	state.nestingDepth--;
+	outTerminated = true;
+	return 0;
+}
+
+Program* Program::Compile(const Char* source, const size_t userMemorySize, CompileError& outError, int& outErrorPosition, const ValueWidth width)
+{
+	Program* program = nullptr;
+	CompilationState state(source, userMemorySize);
+
+	while (*state != '\0')
+	{
+		bool terminated = false;
+		if (ParseStatement(state, terminated)) break;
+		// if we aren't at the end yet, the statement should have ended with a semi-colon.
+		if (*state != '\0' && !terminated)
+		{
+			state.error = CE_UNEXPECTED_CHAR;
+			break;
+		}
+	}
+
+	// final error checking
+	if (state.error == CE_NONE)
+	{
+		// Now, expr should point to '\0', and _paren_count should be zero
+		if (state.parenCount != 0 || *state == ')')
+		{
+			state.error = CE_MISSING_PAREN;
+		}
+		else if (*state != '\0')
+		{
+			state.error = CE_UNEXPECTED_CHAR;
+		}
+		// make sure the program includes at least one PUT.
+		// we consider it a compilation error if it doesn't
+		// since the resulting program would output nothing 
+		// and therefore be useless.
+		else
+		{
+			bool hasPut = false;
+			for (auto& op : state.ops)
+			{
+				hasPut = hasPut || op.code == Op::PUT;
+			}
+
+			if (!hasPut)
+			{
+				state.error = CE_MISSING_PUT;
+			}
+		}
+	}
+
+	// now create a program or don't
+	if (state.error == CE_NONE)
+	{
+		outError = CE_NONE;
+		outErrorPosition = -1;
+		const bool narrow = width == VW_32 || (width == VW_AUTO && AnalyzeWidth32(state.ops, userMemorySize));
+		if (narrow)
+		{
+			program = new ProgramT<uint32_t>(state.ops, userMemorySize);
+		}
+		else
+		{
+			program = new ProgramT<uint64_t>(state.ops, userMemorySize);
+		}
+		program->opPositions = state.positions;
+		program->lineStarts.push_back(0);
+		for (int i = 0; source[i] != '\0'; ++i)
+		{
+			if (source[i] == '\n')
+			{
+				program->lineStarts.push_back(i + 1);
+			}
+		}
+	}
+	else
+	{
+		outError = state.error;
+		outErrorPosition = state.parsePos;
+	}
+
+	return program;
+}
+#pragma endregion
+
+//////////////////////////////////////////////////////////////////////////
+// ANALYSIS
+//////////////////////////////////////////////////////////////////////////
+#pragma region Analysis
+
+const char * Program::GetOpName(Op::Code code)
+{
+	static const char * names[] =
+	{
+		"NOP", "PSH", "PEK", "POK", "FRQ", "SQR", "SIN", "TRI", "NEG", "MUL",
+		"DIV", "MOD", "ADD", "SUB", "BSL", "BSR", "AND", "OR ", "XOR", "CEQ",
+		"CNE", "CLT", "CLE", "CGT", "CGE", "CND", "POP", "GET", "PUT", "RND",
+		"CCV", "VCV", "NOT", "COM", "JMP", "EVR", "TAP", "REC", "CPY", "FIL",
+		"LPF", "HPF", "SLW", "ENV",
+	};
+
+	if (code >= 0 && code < sizeof(names) / sizeof(names[0]))
+	{
+		return names[code];
+	}
+
+	return "???";
+}
+
+uint64_t Program::GetCost(const Op& op)
+{
+	switch (op.code)
+	{
+	case Op::NOP:
+	case Op::JMP:
+		return 2;
+
+	case Op::PSH:
+	case Op::POP:
+	case Op::NEG:
+	case Op::NOT:
+	case Op::COM:
+	case Op::ADD:
+	case Op::SUB:
+	case Op::AND:
+	case Op::OR:
+	case Op::XOR:
+		return 3;
+
+	case Op::MUL:
+	case Op::BSL:
+	case Op::BSR:
+	case Op::CEQ:
+	case Op::CNE:
+	case Op::CLT:
+	case Op::CLE:
+	case Op::CGT:
+	case Op::CGE:
+	case Op::CND:
+	case Op::CCV:
+	case Op::VCV:
+		return 5;
+
+	// a modulo and a branch
+	case Op::EVR:
+		return 45;
+
+	case Op::GET:
+		return 8;
+
+	// a mask or modulo for the position in the ring buffer and the wrap of the address
+	case Op::TAP:
+	case Op::REC:
+		return 20;
+
+	// the setup, plus about a cycle per value, which depends on the count and can't be known until the program runs
+	case Op::CPY:
+	case Op::FIL:
+		return 60;
+
+	// a load and store of the state, which is usually a variable that doesn't need to wrap, with a multiply for the filters
+	case Op::LPF:
+	case Op::HPF:
+		return 15;
+
+	case Op::SLW:
+	case Op::ENV:
+		return 10;
+
+	// memory addresses are wrapped with a 64-bit modulo
+	case Op::PEK:
+		return 30;
+
+	// one modulo per assigned value, plus the final Peek
+	case Op::POK:
+		return 30 + 30 * op.val;
+
+	case Op::PUT:
+		return 10 + 4 * op.val;
+
+	case Op::DIV:
+	case Op::MOD:
+	case Op::SQR:
+		return 40;
+
+	case Op::RND:
+		return 50;
+
+	case Op::TRI:
+		return 85;
+
+	case Op::SIN:
+		return 100;
+
+	case Op::FRQ:
+		return 150;
+
+	default:
+		return 0;
+	}
+}
+
+// how an instruction changes the size of the stack when it executes
+static int GetStackEffect(const Program::Op& op)
+{
+	switch (op.code)
+	{
+	case Program::Op::PSH:
+		return 1;
+
+	case Program::Op::MUL:
+	case Program::Op::DIV:
+	case Program::Op::MOD:
+	case Program::Op::ADD:
+	case Program::Op::SUB:
+	case Program::Op::BSL:
+	case Program::Op::BSR:
+	case Program::Op::AND:
+	case Program::Op::OR:
+	case Program::Op::XOR:
+	case Program::Op::CEQ:
+	case Program::Op::CNE:
+	case Program::Op::CLT:
+	case Program::Op::CLE:
+	case Program::Op::CGT:
+	case Program::Op::CGE:
+	case Program::Op::CND:
+	case Program::Op::POP:
+		return -1;
+
+	// pops the value of t and the rate
+	case Program::Op::EVR:
+		return -2;
+
+	// pops three arguments and pushes one result
+	case Program::Op::TAP:
+	case Program::Op::REC:
+	case Program::Op::CPY:
+	case Program::Op::FIL:
+	case Program::Op::LPF:
+	case Program::Op::HPF:
+	case Program::Op::SLW:
+	case Program::Op::ENV:
+		return -2;
+
+	// pops all of the values and the address, then pushes the first value
+	case Program::Op::POK:
+	case Program::Op::PUT:
+		return -(int)op.val;
+
+	// everything else pops one and pushes one, or doesn't touch the stack
+	default:
+		return 0;
+	}
+}
+
+// how many values an instruction needs on the stack, which is where Exec faults with RE_MISSING_OPERAND
+static size_t GetOperandCount(const Program::Op& op)
+{
+	switch (op.code)
+	{
+	case Program::Op::NOP:
+	case Program::Op::PSH:
+	case Program::Op::JMP:
+		return 0;
+
+	case Program::Op::CND:
+	case Program::Op::POP:
+	case Program::Op::EVR:
+		return (size_t)-GetStackEffect(op);
+
+	case Program::Op::POK:
+	case Program::Op::PUT:
+		return (size_t)op.val + 1;
+
+	default:
+		return (size_t)(1 - GetStackEffect(op));
+	}
+}
+
+int Program::GetLine(const size_t address) const
+{
+	if (address >= opPositions.size() || lineStarts.empty())
+	{
+		return 0;
+	}
+
+	const int pos = opPositions[address];
+	return (int)(std::upper_bound(lineStarts.begin(), lineStarts.end(), pos) - lineStarts.begin());
+}
+
+void Program::Analyze(std::vector<int>& depths, std::vector<uint64_t>& costs) const
+{
+	const size_t count = ops.size();
+
+	// the stack depth when arriving at each instruction, -1 when there is no path to it.
+	// CND, EVR, and JMP only ever jump forward, so a single pass will visit every jump before its target.
+	std::vector<int> entry(count + 1, -1);
+	entry[0] = 0;
+	depths.assign(count, 0);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Op& op = ops[i];
+		const int depth = std::max(entry[i], 0) + GetStackEffect(op);
+		depths[i] = depth;
+
+		if (op.code == Op::CND || op.code == Op::EVR || op.code == Op::JMP)
+		{
+			const size_t target = std::min((size_t)op.val, count);
+			entry[target] = std::max(entry[target], depth);
+		}
+
+		if (op.code != Op::JMP)
+		{
+			entry[i + 1] = std::max(entry[i + 1], depth);
+		}
+	}
+
+	// walk backwards to find the most expensive path from each instruction to the end
+	costs.assign(count + 1, 0);
+	for (size_t i = count; i-- > 0;)
+	{
+		const Op& op = ops[i];
+		const size_t target = std::min((size_t)op.val, count);
+		uint64_t rest = costs[i + 1];
+		if (op.code == Op::JMP)
+		{
+			rest = costs[target];
+		}
+		else if (op.code == Op::CND || op.code == Op::EVR)
+		{
+			rest = std::max(rest, costs[target]);
+		}
+		costs[i] = GetCost(op) + rest;
+	}
+}
+
+uint64_t Program::GetEstimatedCost() const
+{
+	std::vector<int> depths;
+	std::vector<uint64_t> costs;
+	Analyze(depths, costs);
+	return costs[0];
+}
+
+template<typename V>
+size_t ProgramT<V>::GetFootprint() const
+{
+	return sizeof(ProgramT<V>)
+		+ memSize * sizeof(V)
+		+ ops.capacity() * sizeof(Op)
+		+ opPositions.capacity() * sizeof(int)
+		+ lineStarts.capacity() * sizeof(int)
+		+ stack.capacity() * sizeof(V);
+}
+
+size_t Program::GetMaxStackDepth() const
+{
+	std::vector<int> depths;
+	std::vector<uint64_t> costs;
+	Analyze(depths, costs);
+	int maxDepth = 0;
+	for (int depth : depths)
+	{
+		maxDepth = std::max(maxDepth, depth);
+	}
+	return (size_t)maxDepth;
+}
+
+// a statement is everything up to a POP that empties the stack.
+// no jump crosses the end of a statement, so every path from the start of a statement
+// goes through the start of the next one and the difference in costs is the cost of the statement.
+struct Statement
+{
+	size_t begin;
+	size_t end;
+	uint64_t cost;
+};
+
+static std::vector<Statement> GetStatements(const std::vector<Program::Op>& ops, const std::vector<int>& depths, const std::vector<uint64_t>& costs)
+{
+	std::vector<Statement> statements;
+	size_t begin = 0;
+	for (size_t i = 0; i < ops.size(); ++i)
+	{
+		if ((ops[i].code == Program::Op::POP && depths[i] == 0) || i + 1 == ops.size())
+		{
+			Statement statement = { begin, i + 1, costs[begin] - costs[i + 1] };
+			statements.push_back(statement);
+			begin = i + 1;
+		}
+	}
+	return statements;
+}
+
+std::string Program::Disassemble() const
+{
+	std::vector<int> depths;
+	std::vector<uint64_t> costs;
+	Analyze(depths, costs);
+
+	std::string text;
+	char line[128];
+	int maxDepth = 0;
+
+	text += "addr line op  value                cycles stack\n";
+	for (size_t i = 0; i < ops.size(); ++i)
+	{
+		const Op& op = ops[i];
+		switch (op.code)
+		{
+		case Op::PSH:
+		case Op::POK:
+		case Op::PUT:
+		case Op::CND:
+		case Op::JMP:
+		case Op::EVR:
+			snprintf(line, sizeof(line), "%4zu %4d %s %-20llu %6llu %5d\n", i, GetLine(i), GetOpName(op.code), (unsigned long long)op.val, (unsigned long long)GetCost(op), depths[i]);
+			break;
+
+		default:
+			snprintf(line, sizeof(line), "%4zu %4d %s %-20s %6llu %5d\n", i, GetLine(i), GetOpName(op.code), "", (unsigned long long)GetCost(op), depths[i]);
+			break;
+		}
+		text += line;
+		maxDepth = std::max(maxDepth, depths[i]);
+	}
+
+	text += "\n";
+	for (const Statement& statement : GetStatements(ops, depths, costs))
+	{
+		snprintf(line, sizeof(line), "line %4d: %4zu instructions %8llu cycles\n", GetLine(statement.begin), statement.end - statement.begin, (unsigned long long)statement.cost);
+		text += line;
+	}
+
+	snprintf(line, sizeof(line), "\ntotal: %llu cycles per sample (worst case), max stack depth %d\n", (unsigned long long)costs[0], maxDepth);
+	text += line;
+
+	return text;
+}
+
+std::string Program::GetCostSummary() const
+{
+	// the console only has room for a handful of lines,
+	// so we show the most expensive statements first.
+	static const size_t kMaxStatements = 5;
+
+	std::vector<int> depths;
+	std::vector<uint64_t> costs;
+	Analyze(depths, costs);
+
+	std::vector<Statement> statements = GetStatements(ops, depths, costs);
+	std::stable_sort(statements.begin(), statements.end(), [](const Statement& a, const Statement& b) { return a.cost > b.cost; });
+
+	std::string text;
+	char line[128];
+	text += "line  ops   cycles\n";
+	text += "---- ---- --------\n";
+	for (size_t i = 0; i < statements.size() && i < kMaxStatements; ++i)
+	{
+		const Statement& statement = statements[i];
+		snprintf(line, sizeof(line), "%4d %4zu %8llu\n", GetLine(statement.begin), statement.end - statement.begin, (unsigned long long)statement.cost);
+		text += line;
+	}
+
+	snprintf(line, sizeof(line), "total: %llu cycles per sample", (unsigned long long)costs[0]);
+	text += line;
+
+	return text;
+}
+
+// what is known about a value computed with 32 bits compared to the same value computed with 64 bits.
+// exact values are the same in both, which means they are less than 2^32, and lo and hi bound them.
+// low values have the same low 32 bits, which is all that matters for wrapping arithmetic and the outputs.
+// a constant keeps its value in lo and hi even when it doesn't fit in 32 bits.
+struct Value32
+{
+	enum Match { EXACT, LOW, NONE };
+
+	Match match;
+	Program::Value lo, hi;
+
+	bool operator==(const Value32& other) const { return match == other.match && lo == other.lo && hi == other.hi; }
+	bool operator!=(const Value32& other) const { return !(*this == other); }
+
+	bool IsExact() const { return match == EXACT; }
+	bool IsConstant() const { return match != NONE && lo == hi; }
+	bool IsPowerOfTwo() const { return IsConstant() && lo != 0 && (lo & (lo - 1)) == 0; }
+};
+
+static const Program::Value kMax32 = 0xFFFFFFFF;
+// values set from outside of the program, other than the clocks, are assumed to be less than this,
+// which leaves room for w+1 to be computed without wrapping.
+static const Program::Value kMaxHost32 = 0x7FFFFFFF;
+
+static Value32 Exact32(const Program::Value lo, const Program::Value hi)
+{
+	Value32 v = { hi <= kMax32 ? Value32::EXACT : Value32::LOW, hi <= kMax32 ? lo : 0, hi <= kMax32 ? hi : ~0ULL };
+	return v;
+}
+
+static Value32 Constant32(const Program::Value k)
+{
+	Value32 v = { k <= kMax32 ? Value32::EXACT : Value32::LOW, k, k };
+	return v;
+}
+
+static Value32 Match32(const Value32::Match match)
+{
+	Value32 v = { match, 0, match == Value32::EXACT ? kMax32 : ~0ULL };
+	return v;
+}
+
+static Value32 Join32(const Value32& a, const Value32& b)
+{
+	if (a == b) return a;
+	if (a.IsExact() && b.IsExact()) return Exact32(std::min(a.lo, b.lo), std::max(a.hi, b.hi));
+	return Match32(std::max(std::max(a.match, b.match), Value32::LOW));
+}
+
+// the result of wrapping arithmetic, where the low bits of the result only depend on the low bits of the operands
+static Value32 Wrap32(const Value32& a, const Value32& b)
+{
+	return Match32(a.match == Value32::NONE || b.match == Value32::NONE ? Value32::NONE : Value32::LOW);
+}
+
+// smallest all-ones value that is at least v, which bounds OR and XOR
+static Program::Value Mask32(Program::Value v)
+{
+	Program::Value mask = 0;
+	while (mask < v) mask = (mask << 1) | 1;
+	return mask;
+}
+
+// what is known about memory, which carries over from one run to the next.
+// constant addresses are tracked one by one, and everything written to other addresses is lumped together.
+// variables start out as anything the host could have set, user memory starts out cleared.
+struct Memory32
+{
+	Memory32(const size_t userMemorySize) : userMemSize(userMemorySize), memSize(Program::GetTotalMemorySize(userMemorySize)), written(false), rest(Constant32(0)) {}
+
+	const size_t userMemSize;
+	const size_t memSize;
+	std::map<Program::Value, Value32> cells;
+	bool written;
+	Value32 rest;
+
+	bool operator==(const Memory32& other) const { return cells == other.cells && written == other.written && rest == other.rest; }
+
+	// t, m, and q count up for as long as the host keeps playing, t passes 2^31 after about 13 hours at 44.1kHz,
+	// so the widths only ever agree on their low bits. everything else the host sets is small, eg w, n, and the CCs.
+	Value32 Initial(const Program::Value address) const
+	{
+		if (address < userMemSize) return Constant32(0);
+		if (address == Program::GetAddress('t', userMemSize) || address == Program::GetAddress('m', userMemSize)
+			|| address == Program::GetAddress('q', userMemSize))
+		{
+			return Match32(Value32::LOW);
+		}
+		return Exact32(0, kMaxHost32);
+	}
+
+	// address must be exact, reads from other addresses give different values
+	Value32 Load(const Value32& address) const
+	{
+		// an address that isn't known could be one of the clocks
+		Value32 v = Match32(Value32::LOW);
+		if (address.IsConstant())
+		{
+			const Program::Value key = address.lo % memSize;
+			auto cell = cells.find(key);
+			v = cell != cells.end() ? cell->second : Initial(key);
+		}
+		else
+		{
+			for (auto& cell : cells)
+			{
+				v = Join32(v, cell.second);
+			}
+		}
+		return written ? Join32(v, rest) : v;
+	}
+
+	// address must be exact, writes to other addresses put values in different places
+	void Store(const Value32& address, const Value32& value)
+	{
+		if (address.IsConstant())
+		{
+			const Program::Value key = address.lo % memSize;
+			auto cell = cells.find(key);
+			cells[key] = Join32(value, cell != cells.end() ? cell->second : Initial(key));
+		}
+		else
+		{
+			rest = written ? Join32(rest, value) : value;
+			written = true;
+		}
+	}
+
+	// after a few runs, ranges that are still growing jump straight to the largest exact range
+	void Widen(const Memory32& before)
+	{
+		for (auto& cell : cells)
+		{
+			auto previous = before.cells.find(cell.first);
+			if (cell.second.IsExact() && (previous == before.cells.end() || previous->second != cell.second))
+			{
+				cell.second = Match32(Value32::EXACT);
+			}
+		}
+		if (rest.IsExact() && rest != before.rest)
+		{
+			rest = Match32(Value32::EXACT);
+		}
+	}
+};
+
+// the stack when arriving at an instruction from every path that leads to it
+static void Merge32(std::vector<std::vector<Value32>>& entries, std::vector<bool>& reached, const size_t target, const std::vector<Value32>& stack)
+{
+	std::vector<Value32>& entry = entries[target];
+	if (!reached[target])
+	{
+		entry = stack;
+		reached[target] = true;
+		return;
+	}
+
+	const size_t size = std::max(entry.size(), stack.size());
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (i >= entry.size()) entry.push_back(Match32(Value32::NONE));
+		else if (i >= stack.size()) entry[i] = Match32(Value32::NONE);
+		else entry[i] = Join32(entry[i], stack[i]);
+	}
+}
+
+// the abstract interpretation behind IsEquivalentAt32Bits.
+// each pass runs the program once over what is known about the values,
+// and passes are repeated until what is known about memory stops changing, because it carries over between runs.
+// it gives up as soon as the two widths could take a different branch, fault differently,
+// write to different places, or put different low bits in an output.
+static bool AnalyzeWidth32(const std::vector<Program::Op>& ops, const size_t userMemorySize)
+{
+	typedef Program::Op Op;
+	typedef Program::Value Value;
+	static const int kWidenAfter = 3;
+
+	const size_t count = ops.size();
+	const Value32 t = Constant32(Program::GetAddress('t', userMemorySize));
+	const Value32 w = Constant32(Program::GetAddress('w', userMemorySize));
+	const Value32 sr = Constant32(Program::GetAddress('~', userMemorySize));
+	Memory32 memory(userMemorySize);
+
+	for (int pass = 0; ; ++pass)
+	{
+		const Memory32 before = memory;
+		std::vector<std::vector<Value32>> entries(count + 1);
+		std::vector<bool> reached(count + 1, false);
+		reached[0] = true;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!reached[i]) continue;
+
+			const Op& op = ops[i];
+			std::vector<Value32> stack;
+			stack.swap(entries[i]);
+
+			// operands are popped into a, b, and c in the order they were pushed.
+			// POK and PUT leave theirs on the stack until they have been stored.
+			const size_t pops = GetOperandCount(op);
+			if (stack.size() < pops) return false;
+			const Value32 none = Match32(Value32::NONE);
+			const Value32 a = pops >= 1 ? stack[stack.size() - pops] : none;
+			const Value32 b = pops >= 2 ? stack[stack.size() - pops + 1] : none;
+			const Value32 c = pops >= 3 ? stack[stack.size() - pops + 2] : none;
+			if (op.code != Op::POK && op.code != Op::PUT) stack.resize(stack.size() - pops);
+
+			Value32 v = none;
+			bool push = true;
+			bool jump = false;
+			switch (op.code)
+			{
+			case Op::NOP:
+				push = false;
+				break;
+
+			case Op::PSH:
+				v = Constant32(op.val);
+				break;
+
+			case Op::POP:
+				// a program is only left with more values on the stack when it faults, which it does the same way with either width
+				stack.clear();
+				push = false;
+				break;
+
+			case Op::PEK:
+				v = a.IsExact() ? memory.Load(a) : none;
+				break;
+
+			case Op::GET:
+				// the outputs are only ever known to match in their low bits
+				if (!(a.IsConstant() && a.lo == Wildcard::Value) && !(a.IsExact() && a.hi < kMax32)) return false;
+				v = Match32(Value32::LOW);
+				break;
+
+			case Op::NEG:
+				v = a.IsExact() && a.hi == 0 ? a : Wrap32(a, a);
+				break;
+
+			case Op::COM:
+				v = Wrap32(a, a);
+				break;
+
+			case Op::NOT:
+				v = a.IsExact() ? Exact32(0, 1) : none;
+				break;
+
+			case Op::SIN:
+			case Op::SQR:
+			case Op::TRI:
+			{
+				// w must be the same in both or they could fault differently, and SIN computes w+1
+				const Value32 r = memory.Load(w);
+				if (!r.IsExact() || r.hi == kMax32) return false;
+				if (op.code == Op::TRI) v = a.IsExact() && a.hi * 2 <= kMax32 ? Match32(Value32::LOW) : none;
+				else v = a.IsExact() ? Exact32(0, r.hi) : none;
+			}
+			break;
+
+			case Op::FRQ:
+				v = a.IsExact() && memory.Load(sr).IsExact() ? Match32(Value32::LOW) : none;
+				break;
+
+			case Op::RND:
+				if (!a.IsExact()) return false;
+				v = Exact32(0, a.hi > 0 ? a.hi - 1 : 0);
+				break;
+
+			case Op::CCV:
+			case Op::VCV:
+				// the index wraps to a power of two, so only the low bits of it matter
+				v = a.match != Value32::NONE ? Exact32(0, kMaxHost32) : none;
+				break;
+
+			case Op::MUL:
+				v = a.IsExact() && b.IsExact() ? Exact32(a.lo * b.lo, a.hi * b.hi) : Wrap32(a, b);
+				break;
+
+			case Op::ADD:
+				v = a.IsExact() && b.IsExact() ? Exact32(a.lo + b.lo, a.hi + b.hi) : Wrap32(a, b);
+				break;
+
+			case Op::SUB:
+				v = a.IsExact() && b.IsExact() && a.lo >= b.hi ? Exact32(a.lo - b.hi, a.hi - b.lo) : Wrap32(a, b);
+				break;
+
+			case Op::DIV:
+				if (!b.IsExact()) return false;
+				v = a.IsExact() ? Exact32(a.lo / std::max(b.hi, (Value)1), a.hi / std::max(b.lo, (Value)1)) : none;
+				break;
+
+			case Op::MOD:
+				if (!b.IsExact()) return false;
+				if (a.IsExact()) v = Exact32(0, std::min(a.hi, b.hi > 0 ? b.hi - 1 : 0));
+				else if (a.match == Value32::LOW && b.IsPowerOfTwo()) v = Exact32(0, b.lo - 1);
+				break;
+
+			// the shift amount wraps to the width, so it must be less than 32
+			case Op::BSL:
+				if (b.IsExact() && b.hi < 32) v = a.IsExact() ? Exact32(a.lo << b.lo, a.hi << b.hi) : Wrap32(a, a);
+				break;
+
+			case Op::BSR:
+				if (b.IsExact() && b.hi < 32 && a.IsExact()) v = Exact32(a.lo >> b.hi, a.hi >> b.lo);
+				break;
+
+			case Op::AND:
+				if (a.IsExact() && b.match != Value32::NONE) v = Exact32(0, b.IsExact() ? std::min(a.hi, b.hi) : a.hi);
+				else if (b.IsExact() && a.match != Value32::NONE) v = Exact32(0, b.hi);
+				else v = Wrap32(a, b);
+				break;
+
+			case Op::OR:
+			case Op::XOR:
+				v = a.IsExact() && b.IsExact() ? Exact32(0, Mask32(std::max(a.hi, b.hi))) : Wrap32(a, b);
+				break;
+
+			case Op::CEQ:
+			case Op::CNE:
+			case Op::CLT:
+			case Op::CLE:
+			case Op::CGT:
+			case Op::CGE:
+				v = a.IsExact() && b.IsExact() ? Exact32(0, 1) : none;
+				break;
+
+			case Op::CND:
+				if (!a.IsExact()) return false;
+				push = false;
+				jump = true;
+				break;
+
+			case Op::EVR:
+				if (!a.IsExact() || !b.IsExact()) return false;
+				push = false;
+				jump = true;
+				break;
+
+			case Op::JMP:
+				push = false;
+				jump = true;
+				break;
+
+			case Op::POK:
+			{
+				if (!a.IsExact() || a.hi + op.val > kMax32) return false;
+				for (Value k = 0; k < op.val; ++k)
+				{
+					const Value32 address = a.IsConstant() ? Constant32(a.lo + k) : Exact32(a.lo + k, a.hi + k);
+					memory.Store(address, stack[stack.size() - (size_t)op.val + k]);
+				}
+				stack.resize(stack.size() - pops);
+				v = memory.Load(a);
+			}
+			break;
+
+			case Op::PUT:
+			{
+				const bool wildcard = a.IsConstant() && a.lo == Wildcard::Value;
+				if (!wildcard && !(a.IsExact() && a.hi < kMax32)) return false;
+				for (Value k = 0; k < op.val; ++k)
+				{
+					if (stack[stack.size() - (size_t)op.val + k].match == Value32::NONE) return false;
+				}
+				v = wildcard ? Match32(Value32::LOW) : b;
+				stack.resize(stack.size() - pops);
+			}
+			break;
+
+			// the ring offset is t, or t minus the delay, wrapped to the length.
+			// that only matches when the length is a power of two or the subtraction can't wrap around.
+			case Op::TAP:
+			case Op::REC:
+			{
+				if (!b.IsExact()) return false;
+				const Value32 position = memory.Load(t);
+				const bool sameOffset = op.code == Op::TAP
+					? (b.IsPowerOfTwo() && Wrap32(position, c).match == Value32::LOW) || (position.IsExact() && c.IsExact() && position.lo >= c.hi)
+					: (b.IsPowerOfTwo() && position.match == Value32::LOW) || position.IsExact();
+				const bool sameAddress = sameOffset && a.IsExact() && a.hi + b.hi <= kMax32;
+				if (op.code == Op::TAP)
+				{
+					v = sameAddress ? memory.Load(Exact32(a.lo, a.hi + b.hi)) : none;
+				}
+				else
+				{
+					if (!sameAddress) return false;
+					memory.Store(Exact32(a.lo, a.hi + b.hi), c);
+					v = c;
+				}
+			}
+			break;
+
+			case Op::CPY:
+			case Op::FIL:
+			{
+				if (!a.IsExact() || !b.IsExact() || (op.code == Op::CPY && !c.IsExact())) return false;
+				const Value32 anywhere = Match32(Value32::EXACT);
+				memory.Store(anywhere, op.code == Op::CPY ? memory.Load(anywhere) : c);
+				v = memory.Load(anywhere);
+			}
+			break;
+
+			// the lowpass clamps its input to leave room for 16 bits of fraction, which is a different limit with 32 bits
+			case Op::LPF:
+			case Op::HPF:
+				if (!a.IsExact()) return false;
+				memory.Store(a, none);
+				break;
+
+			// slew and envelope move the state towards the input, so they stay between the two
+			case Op::SLW:
+			case Op::ENV:
+			{
+				if (!a.IsExact()) return false;
+				const Value32 s = memory.Load(a);
+				if (s.IsExact() && b.IsExact() && c.IsExact()) v = Exact32(std::min(s.lo, b.lo), std::max(s.hi, b.hi));
+				memory.Store(a, v);
+			}
+			break;
+
+			default:
+				return false;
+			}
+
+			if (push) stack.push_back(v);
+			if (jump)
+			{
+				const size_t target = (size_t)op.val;
+				if (target <= i || target > count) return false;
+				Merge32(entries, reached, target, stack);
+			}
+			if (op.code != Op::JMP)
+			{
+				Merge32(entries, reached, i + 1, stack);
+			}
+		}
+
+		if (memory == before)
+		{
+			return true;
+		}
+
+		if (pass >= kWidenAfter)
+		{
+			memory.Widen(before);
+		}
+	}
+}
+
+bool Program::IsEquivalentAt32Bits() const
+{
+	return AnalyzeWidth32(ops, userMemSize);
+}
+
+#pragma endregion
+
+//////////////////////////////////////////////////////////////////////////
+// CODE GENERATION
+//////////////////////////////////////////////////////////////////////////
+#pragma region Code Generation
+
+// everything a generated function needs besides its own body, guarded so that any number of them can go in one file.
+// EvaluatorFrame must have the same layout as Program::GeneratedFrame.
+static const char* kGeneratedPrelude =
+	"#define _USE_MATH_DEFINES\n"
+	"#include <stddef.h>\n"
+	"#include <stdint.h>\n"
+	"#include <string.h>\n"
+	"#include <math.h>\n"
+	"#include <algorithm>\n"
+	"\n"
+	"#ifndef EVALUATOR_GENERATED_PRELUDE\n"
+	"#define EVALUATOR_GENERATED_PRELUDE\n"
+	"\n"
+	"struct EvaluatorFrame\n"
+	"{\n"
+	"\tvoid* mem;\n"
+	"\tconst uint64_t* cc;\n"
+	"\tconst uint64_t* vc;\n"
+	"\tuint64_t* results;\n"
+	"\tsize_t size;\n"
+	"\tuint64_t (*random)(void* rng);\n"
+	"\tvoid* rng;\n"
+	"\tsize_t address;\n"
+	"};\n"
+	"\n"
+	"template<typename V>\n"
+	"static inline V EvaluatorRingOffset(const V position, const V length)\n"
+	"{\n"
+	"\treturn (length & (length - 1)) == 0 ? position & (length - 1) : position % length;\n"
+	"}\n"
+	"\n"
+	"#endif\n";
+
+// append a line of generated code indented by depth tabs
+static void Emit(std::string& text, const int depth, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	va_list measure;
+	va_copy(measure, args);
+	const int length = vsnprintf(nullptr, 0, format, measure);
+	va_end(measure);
+
+	std::string line((size_t)length + 1, '\0');
+	vsnprintf(&line[0], line.size(), format, args);
+	va_end(args);
+	line.resize((size_t)length);
+
+	text.append((size_t)depth, '\t');
+	text += line;
+	text += '\n';
+}
+
+std::string Program::GenerateSource(const char* functionName) const
+{
+	const size_t count = ops.size();
+
+	// the stack lives in the locals s0, s1, ... so its depth has to be known at every instruction.
+	// this is the same walk as Analyze, except that paths which meet must agree on the depth,
+	// and paths that always fault, like a POP that leaves values behind, don't go any further.
+	std::vector<int> entry(count + 1, -1);
+	std::vector<bool> targets(count + 1, false);
+	auto join = [&entry](const size_t address, const int depth)
+	{
+		if (entry[address] >= 0 && entry[address] != depth) return false;
+		entry[address] = depth;
+		return true;
+	};
+	entry[0] = 0;
+	int maxDepth = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Op& op = ops[i];
+		if (entry[i] < 0 || GetOperandCount(op) > (size_t)entry[i]) continue;
+		// Exec reads past the values of an empty assignment list, which can't be reproduced
+		if (op.code == Op::PUT && op.val == 0) return std::string();
+
+		const int depth = entry[i] + GetStackEffect(op);
+		maxDepth = std::max(maxDepth, std::max(entry[i], depth));
+		if (op.code == Op::POP && depth > 0) continue;
+
+		if (op.code == Op::CND || op.code == Op::EVR || op.code == Op::JMP)
+		{
+			if (op.val <= i) return std::string();
+			const size_t target = std::min((size_t)op.val, count);
+			if (!join(target, depth)) return std::string();
+			targets[target] = true;
+		}
+
+		if (op.code != Op::JMP && !join(i + 1, depth)) return std::string();
+	}
+
+	const char* type = width == VW_32 ? "uint32_t" : "uint64_t";
+	const int bits = width == VW_32 ? 32 : 64;
+	const size_t w = (size_t)GetAddress('w', userMemSize);
+	const size_t t = (size_t)GetAddress('t', userMemSize);
+	const size_t sr = (size_t)GetAddress('~', userMemSize);
+
+	std::string text = kGeneratedPrelude;
+	Emit(text, 0, "");
+	Emit(text, 0, "// %zu instructions with %d-bit values and %zu values of memory", count, bits, memSize);
+	Emit(text, 0, "extern \"C\" int %s(EvaluatorFrame* frame)", functionName);
+	Emit(text, 0, "{");
+	Emit(text, 1, "typedef %s V;", type);
+	Emit(text, 1, "V* const mem = (V*)frame->mem;");
+	Emit(text, 1, "const size_t memSize = %zu;", memSize);
+	Emit(text, 1, "uint64_t* const results = frame->results;");
+	Emit(text, 1, "const size_t size = frame->size;");
+	Emit(text, 1, "(void)mem; (void)memSize; (void)results; (void)size;");
+	if (maxDepth > 0)
+	{
+		std::string slots;
+		for (int s = 0; s < maxDepth; ++s)
+		{
+			char slot[32];
+			snprintf(slot, sizeof(slot), "%ss%d = 0", s > 0 ? ", " : "", s);
+			slots += slot;
+		}
+		Emit(text, 1, "V %s;", slots.c_str());
+	}
+
+	if (count == 0)
+	{
+		Emit(text, 1, "frame->address = 0; return %d; // %s", RE_EMPTY_PROGRAM, GetErrorString(RE_EMPTY_PROGRAM));
+		Emit(text, 0, "}");
+		return text;
+	}
+
+	char fault[128];
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (targets[i])
+		{
+			Emit(text, 0, "L%zu:", i);
+		}
+
+		const Op& op = ops[i];
+		if (entry[i] < 0) continue;
+
+		switch (op.code)
+		{
+		case Op::PSH: case Op::POK: case Op::PUT: case Op::CND: case Op::JMP: case Op::EVR:
+			Emit(text, 1, "// %zu: %s %llu", i, GetOpName(op.code), (unsigned long long)op.val);
+			break;
+		default:
+			Emit(text, 1, "// %zu: %s", i, GetOpName(op.code));
+			break;
+		}
+
+		const int depth = entry[i];
+		const int pops = (int)GetOperandCount(op);
+		if (pops > depth)
+		{
+			Emit(text, 1, "frame->address = %zu; return %d; // %s", i, RE_MISSING_OPERAND, GetErrorString(RE_MISSING_OPERAND));
+			continue;
+		}
+
+		// the operands in the order they were pushed, and where the result goes
+		char a[32], b[32], c[32];
+		snprintf(a, sizeof(a), "s%d", depth - pops);
+		snprintf(b, sizeof(b), "s%d", depth - pops + 1);
+		snprintf(c, sizeof(c), "s%d", depth - pops + 2);
+		snprintf(fault, sizeof(fault), "{ frame->address = %zu; return %d; } // %s", i, RE_DIVIDE_BY_ZERO, GetErrorString(RE_DIVIDE_BY_ZERO));
+		const size_t target = std::min((size_t)op.val, count);
+
+		switch (op.code)
+		{
+		case Op::NOP:
+			break;
+
+		case Op::PSH:
+			Emit(text, 1, "s%d = (V)%lluULL;", depth, (unsigned long long)op.val);
+			break;
+
+		case Op::POP:
+			if (depth > 1)
+			{
+				Emit(text, 1, "frame->address = %zu; return %d; // %s", i, RE_INCONSISTENT_STACK, GetErrorString(RE_INCONSISTENT_STACK));
+			}
+			break;
+
+		case Op::PEK:
+			Emit(text, 1, "%s = mem[%s %% memSize];", a, a);
+			break;
+
+		case Op::GET:
+			Emit(text, 1, "if (%s == (V)-1) { V v = 0; for (size_t i = 0; i < size; ++i) v += (V)results[i]; %s = v; }", a, a);
+			Emit(text, 1, "else if (%s < size) %s = (V)results[%s];", a, a, a);
+			Emit(text, 1, "else { frame->address = %zu; return %d; } // %s", i, RE_GET_OUT_OF_BOUNDS, GetErrorString(RE_GET_OUT_OF_BOUNDS));
+			break;
+
+		case Op::NEG: Emit(text, 1, "%s = -%s;", a, a); break;
+		case Op::COM: Emit(text, 1, "%s = ~%s;", a, a); break;
+		case Op::NOT: Emit(text, 1, "%s = !%s;", a, a); break;
+
+		case Op::SIN:
+			Emit(text, 1, "{");
+			Emit(text, 2, "V r = mem[%zu];", w);
+			Emit(text, 2, "V hr = r / 2;");
+			Emit(text, 2, "r += 1;");
+			Emit(text, 2, "if (r == 0) %s", fault);
+			Emit(text, 2, "double x = sin(2 * M_PI * ((double)(%s%%r) / r));", a);
+			Emit(text, 2, "%s = V(x*hr + hr);", a);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::SQR:
+			Emit(text, 1, "{");
+			Emit(text, 2, "const V r = mem[%zu];", w);
+			Emit(text, 2, "if (r == 0) %s", fault);
+			Emit(text, 2, "%s = %s%%r < r / 2 ? 0 : r - 1;", a, a);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::FRQ:
+			Emit(text, 1, "if (%s != 0)", a);
+			Emit(text, 1, "{");
+			Emit(text, 2, "double f = round(4.0 * 3.023625 * pow(2.0, (double)%s / 12.0) * (44100.0 / mem[%zu]));", a, sr);
+			Emit(text, 2, "%s = (V)(uint64_t)f;", a);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::TRI:
+			Emit(text, 1, "{");
+			Emit(text, 2, "%s *= 2;", a);
+			Emit(text, 2, "const V r = mem[%zu];", w);
+			Emit(text, 2, "if (r == 0) %s", fault);
+			Emit(text, 2, "%s = %s*((%s / r) %% 2) + (r - %s - 1)*(1 - (%s / r) %% 2);", a, a, a, a, a);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::RND:
+			Emit(text, 1, "if (%s == 0) %s", a, fault);
+			Emit(text, 1, "%s = (V)(frame->random(frame->rng) %% %s);", a, a);
+			break;
+
+		case Op::CCV: Emit(text, 1, "%s = (V)frame->cc[(uint64_t)%s %% %zu];", a, a, kCCSize); break;
+		case Op::VCV: Emit(text, 1, "%s = (V)frame->vc[(uint64_t)%s %% %zu];", a, a, kVCSize); break;
+
+		case Op::MUL: Emit(text, 1, "%s = %s*%s;", a, a, b); break;
+		case Op::ADD: Emit(text, 1, "%s = %s + %s;", a, a, b); break;
+		case Op::SUB: Emit(text, 1, "%s = %s - %s;", a, a, b); break;
+		case Op::AND: Emit(text, 1, "%s = %s & %s;", a, a, b); break;
+		case Op::OR:  Emit(text, 1, "%s = %s | %s;", a, a, b); break;
+		case Op::XOR: Emit(text, 1, "%s = %s ^ %s;", a, a, b); break;
+		case Op::BSL: Emit(text, 1, "%s = %s << (%s %% %d);", a, a, b, bits); break;
+		case Op::BSR: Emit(text, 1, "%s = %s >> (%s %% %d);", a, a, b, bits); break;
+		case Op::CEQ: Emit(text, 1, "%s = %s == %s;", a, a, b); break;
+		case Op::CNE: Emit(text, 1, "%s = %s != %s;", a, a, b); break;
+		case Op::CLT: Emit(text, 1, "%s = %s < %s;", a, a, b); break;
+		case Op::CLE: Emit(text, 1, "%s = %s <= %s;", a, a, b); break;
+		case Op::CGT: Emit(text, 1, "%s = %s > %s;", a, a, b); break;
+		case Op::CGE: Emit(text, 1, "%s = %s >= %s;", a, a, b); break;
+
+		case Op::DIV:
+			Emit(text, 1, "if (%s == 0) %s", b, fault);
+			Emit(text, 1, "%s = %s / %s;", a, a, b);
+			break;
+
+		case Op::MOD:
+			Emit(text, 1, "if (%s == 0) %s", b, fault);
+			Emit(text, 1, "%s = %s %% %s;", a, a, b);
+			break;
+
+		case Op::POK:
+			for (int v = 0; v < (int)op.val; ++v)
+			{
+				if (v == 0) Emit(text, 1, "mem[%s %% memSize] = s%d;", a, depth - pops + 1);
+				else Emit(text, 1, "mem[(V)(%s + %d) %% memSize] = s%d;", a, v, depth - pops + 1 + v);
+			}
+			Emit(text, 1, "%s = mem[%s %% memSize];", a, a);
+			break;
+
+		case Op::PUT:
+		{
+			std::string args;
+			for (int v = 0; v < (int)op.val; ++v)
+			{
+				char arg[32];
+				snprintf(arg, sizeof(arg), "%ss%d", v > 0 ? ", " : "", depth - pops + 1 + v);
+				args += arg;
+			}
+			Emit(text, 1, "{");
+			Emit(text, 2, "const V args[] = { %s };", args.c_str());
+			Emit(text, 2, "const size_t count = %llu;", (unsigned long long)op.val);
+			Emit(text, 2, "V a = %s;", a);
+			Emit(text, 2, "V b = args[0];");
+			Emit(text, 2, "if (a == (V)-1)");
+			Emit(text, 2, "{");
+			Emit(text, 3, "V c = 0;");
+			Emit(text, 3, "for (size_t i = 0; i < size; ++i) { b = args[i < count ? i : count - 1]; results[i] = b; c += b; }");
+			Emit(text, 3, "%s = c;", a);
+			Emit(text, 2, "}");
+			Emit(text, 2, "else if (a < size)");
+			Emit(text, 2, "{");
+			Emit(text, 3, "for (size_t i = 0; i < count && a < size; ++i) results[a++] = args[i];");
+			Emit(text, 3, "%s = b;", a);
+			Emit(text, 2, "}");
+			Emit(text, 2, "else { frame->address = %zu; return %d; } // %s", i, RE_PUT_OUT_OF_BOUNDS, GetErrorString(RE_PUT_OUT_OF_BOUNDS));
+			Emit(text, 1, "}");
+		}
+		break;
+
+		case Op::CND:
+			Emit(text, 1, "if (!%s) goto L%zu;", a, target);
+			break;
+
+		case Op::JMP:
+			Emit(text, 1, "goto L%zu;", target);
+			break;
+
+		case Op::EVR:
+			Emit(text, 1, "if (%s == 0) %s", b, fault);
+			Emit(text, 1, "if (%s %% %s != 0) goto L%zu;", a, b, target);
+			break;
+
+		case Op::TAP:
+			Emit(text, 1, "if (%s == 0) %s", b, fault);
+			Emit(text, 1, "{");
+			Emit(text, 2, "const V address = %s + EvaluatorRingOffset<V>(mem[%zu] - %s, %s);", a, t, c, b);
+			Emit(text, 2, "%s = mem[address < memSize ? address : address %% memSize];", a);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::REC:
+			Emit(text, 1, "if (%s == 0) %s", b, fault);
+			Emit(text, 1, "{");
+			Emit(text, 2, "const V address = %s + EvaluatorRingOffset<V>(mem[%zu], %s);", a, t, b);
+			Emit(text, 2, "mem[address < memSize ? address : address %% memSize] = %s;", c);
+			Emit(text, 2, "%s = %s;", a, c);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::CPY:
+			Emit(text, 1, "{");
+			Emit(text, 2, "const V dst = %s %% memSize;", a);
+			Emit(text, 2, "const V src = %s %% memSize;", b);
+			Emit(text, 2, "const V count = std::min(%s, (V)memSize);", c);
+			Emit(text, 2, "const V distance = (dst + memSize - src) %% memSize;");
+			Emit(text, 2, "if (distance < count && memSize - distance < count)");
+			Emit(text, 2, "{");
+			Emit(text, 3, "std::rotate(mem, mem + (memSize - distance), mem + memSize);");
+			Emit(text, 3, "for (V i = count; i < memSize; ++i) mem[(dst + i) %% memSize] = mem[(dst + i + distance) %% memSize];");
+			Emit(text, 2, "}");
+			Emit(text, 2, "else if (dst + count <= memSize && src + count <= memSize) memmove(mem + dst, mem + src, count * sizeof(V));");
+			Emit(text, 2, "else if (distance < count) for (V i = count; i-- > 0;) mem[(dst + i) %% memSize] = mem[(src + i) %% memSize];");
+			Emit(text, 2, "else for (V i = 0; i < count; ++i) mem[(dst + i) %% memSize] = mem[(src + i) %% memSize];");
+			Emit(text, 2, "%s = mem[dst];", a);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::FIL:
+			Emit(text, 1, "{");
+			Emit(text, 2, "const V dst = %s %% memSize;", a);
+			Emit(text, 2, "const V count = std::min(%s, (V)memSize);", b);
+			Emit(text, 2, "const V end = std::min(dst + count, (V)memSize);");
+			Emit(text, 2, "std::fill(mem + dst, mem + end, %s);", c);
+			Emit(text, 2, "std::fill(mem, mem + (count - (end - dst)), %s);", c);
+			Emit(text, 2, "%s = mem[dst];", a);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::LPF:
+		case Op::HPF:
+			Emit(text, 1, "{");
+			Emit(text, 2, "V& state = mem[%s < memSize ? %s : %s %% memSize];", a, a, a);
+			Emit(text, 2, "const V input = std::min(%s, (V)(~(V)0 >> 16));", b);
+			Emit(text, 2, "const V target = input << 16;");
+			Emit(text, 2, "const V rate = std::min(%s, (V)256);", c);
+			Emit(text, 2, "const V distance = target > state ? target - state : state - target;");
+			Emit(text, 2, "const V step = distance / 256 * rate + distance %% 256 * rate / 256;");
+			Emit(text, 2, "state = target > state ? state + step : state - step;");
+			Emit(text, 2, "const V lowpass = state >> 16;");
+			Emit(text, 2, op.code == Op::LPF ? "%s = lowpass;" : "%s = input - lowpass;", a);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::SLW:
+			Emit(text, 1, "{");
+			Emit(text, 2, "V& state = mem[%s < memSize ? %s : %s %% memSize];", a, a, a);
+			Emit(text, 2, "state = %s > state ? state + std::min(%s - state, %s) : state - std::min(state - %s, %s);", b, b, c, b, c);
+			Emit(text, 2, "%s = state;", a);
+			Emit(text, 1, "}");
+			break;
+
+		case Op::ENV:
+			Emit(text, 1, "{");
+			Emit(text, 2, "V& state = mem[%s < memSize ? %s : %s %% memSize];", a, a, a);
+			Emit(text, 2, "state = %s > state ? %s : state - std::min(state - %s, %s);", b, b, b, c);
+			Emit(text, 2, "%s = state;", a);
+			Emit(text, 1, "}");
+			break;
+
+		default:
+			Emit(text, 1, "frame->address = %zu; return %d; // %s", i, RE_MISSING_OPCODE, GetErrorString(RE_MISSING_OPCODE));
+			break;
+		}
+	}
+
+	if (targets[count])
+	{
+		Emit(text, 0, "L%zu:", count);
+	}
+	// Run blames the last instruction when a program leaves more than one value on the stack
+	if (entry[count] > 1)
+	{
+		Emit(text, 1, "frame->address = %zu; return %d; // %s", count - 1, RE_INCONSISTENT_STACK, GetErrorString(RE_INCONSISTENT_STACK));
+	}
+	else
+	{
+		Emit(text, 1, "return %d;", RE_NONE);
+	}
+	Emit(text, 0, "}");
+
+	return text;
+}
+
+#pragma endregion
+
+//////////////////////////////////////////////////////////////////////////
+// EXECUTION
+//////////////////////////////////////////////////////////////////////////
+#pragma region Execution
+
+const char * Program::GetErrorString(Program::RuntimeError error)
+{
+	switch (error)
+	{
+	case RE_NONE:
+		return "None";
+	case RE_DIVIDE_BY_ZERO:
+		return "Divide by zero";
+	case RE_MISSING_OPERAND:
+		return "Missing operand";
+	case RE_MISSING_OPCODE:
+		return "Unimplemented opcode";
+	case RE_INCONSISTENT_STACK:
+		return "Inconsistent stack";
+	case RE_EMPTY_PROGRAM:
+		return "Empty program (instruction count is zero)";
+	case RE_GET_OUT_OF_BOUNDS:
+		return "Input access is out of bounds";
+	case RE_PUT_OUT_OF_BOUNDS:
+		return "Output access is out of bounds";
+	default:
+		return "Unknown";
+	}
+}
+
+// the slot of a ring buffer of length values that position falls in, length must not be zero.
+// lengths that are a power of two are masked, which is much cheaper than a modulo.
+template<typename V>
+static inline V GetRingOffset(const V position, const V length)
+{
+	return (length & (length - 1)) == 0 ? position & (length - 1) : position % length;
+}
+
+template<typename V>
+Program::RuntimeError ProgramT<V>::Run(Value* results, const size_t size)
+{
+	++runCount;
+	runError = RE_NONE;
+	const uint64_t icount = GetInstructionCount();
+	if (icount > 0)
+	{
+		// Fault moves pc past the end, so we don't need to check for errors after each instruction
+		for (pc = 0; pc < icount; ++pc)
+		{
+			Exec(ops[pc], results, size);
+		}
+
+		// under error-free execution we should have either 1 or 0 values in the stack.
+		// 1 when a program terminates with the result of an expression (eg: t*Fn)
+		// 0 when a program terminates with a POP (eg: t*Fn;)
+		// in the case of the POP, the value of the expression will already be in result.
+		if (runError == RE_NONE)
+		{
+			if (stack.size() > 1)
+			{
+				// blame the last instruction
+				pc = icount - 1;
+				Fault(RE_INCONSISTENT_STACK);
+			}
+		}
+
+		// clear the stack so it doesn't explode in size due to continual runtime errors
+		stack.clear();
+	}
+	else
+	{
+		pc = 0;
+		Fault(RE_EMPTY_PROGRAM);
+	}
+
+	return runError;
+}
+
+void Program::Fault(const RuntimeError error)
+{
+	ErrorStat& stat = errors[error];
+	if (stat.count == 0)
+	{
+		stat.firstAddress = pc;
+	}
+	++stat.count;
+	runError = error;
+	pc = ops.size();
+}
+
+uint64_t Program::GetErrorCount(const RuntimeError error) const
+{
+	if (error == RE_NONE)
+	{
+		// a run stops at the first error, so every run that didn't have one finished successfully
+		uint64_t failed = 0;
+		for (int i = RE_NONE + 1; i < RE_COUNT; ++i)
+		{
+			failed += errors[i].count;
+		}
+		return runCount - failed;
+	}
+
+	return error < RE_COUNT ? errors[error].count : 0;
+}
+
+int Program::GetErrorLine(const RuntimeError error) const
+{
+	if (error == RE_NONE || error >= RE_COUNT || errors[error].count == 0)
+	{
+		return 0;
+	}
+
+	return GetLine(errors[error].firstAddress);
+}
+
+void Program::GetErrorSummary(char* text, size_t size) const
+{
+	int len = 0;
+	text[0] = 0;
+	for (int i = RE_NONE + 1; i < RE_COUNT && len >= 0 && (size_t)len < size; ++i)
+	{
+		const RuntimeError error = (RuntimeError)i;
+		if (errors[i].count == 0)
+		{
+			continue;
+		}
+
+		const int line = GetErrorLine(error);
+		if (line > 0)
+		{
+			len += snprintf(text + len, size - len, "%s x%llu at line %d\n", GetErrorString(error), (unsigned long long)errors[i].count, line);
+		}
+		else
+		{
+			len += snprintf(text + len, size - len, "%s x%llu\n", GetErrorString(error), (unsigned long long)errors[i].count);
+		}
+	}
+}
+
+#define POP1 if ( stack.size() < 1 ) goto bad_stack; V a = stack.back(); stack.pop_back();
+#define POP2 if ( stack.size() < 2 ) goto bad_stack; V b = stack.back(); stack.pop_back(); V a = stack.back(); stack.pop_back();
+#define POP3 if ( stack.size() < 3 ) goto bad_stack; V c = stack.back(); stack.pop_back(); V b = stack.back(); stack.pop_back(); V a = stack.back(); stack.pop_back();
+// leaves the n values on the stack and points args at them in the order they were pushed,
+// with the value beneath them in a. DROP(n) removes all of them once they've been used.
+#define PEEK(n) if (stack.size() < (size_t)n + 1) goto bad_stack; const V* args = &stack[stack.size() - n]; V a = *(args - 1);
+#define DROP(n) stack.resize(stack.size() - n - 1);
 
 // perform the operation
-Program::RuntimeError Program::Exec(const Op& op, Value* results, size_t size)
+template<typename V>
+void ProgramT<V>::Exec(const Op& op, Value* results, size_t size)
 {
-	RuntimeError error = RE_NONE;
 	switch (op.code)
 	{
 		// no operands - result is pushed to the stack
 	case Op::PSH:
-		stack.push(op.val);
+		stack.push_back((V)op.val);
 		break;
 
 	case Op::POP:
 	{
-		stack.pop();
+		if (stack.empty()) goto bad_stack;
+		stack.pop_back();
 		// stack should now be empty, if it isn't that's an error
 		if (stack.size() > 0)
 		{
-			error = RE_INCONSISTENT_STACK;
+			Fault(RE_INCONSISTENT_STACK);
 		}
 	}
 	break;
@@ -842,58 +2821,62 @@ Program::RuntimeError Program::Exec(const Op& op, Value* results, size_t size)
 	case Op::PEK:
 	{
 		POP1;
-		stack.push(Peek(a));
+		stack.push_back(mem[a % memSize]);
 	}
 	break;
 
 	case Op::GET:
 	{
 		POP1;
-		Value v = 0;
+		V v = 0;
 		// wildcard GET should return the sum of all channels
-		if (a == Wildcard::Value)
+		if (a == (V)Wildcard::Value)
 		{
 			for (size_t i = 0; i < size; ++i)
 			{
-				v += results[i];
+				v += (V)results[i];
 			}
 		}
 		else if (a < size)
 		{
-			v = results[a];
+			v = (V)results[a];
 		}
 		else
 		{
-			error = RE_GET_OUT_OF_BOUNDS;
+			Fault(RE_GET_OUT_OF_BOUNDS);
 		}
-		stack.push(v);
+		stack.push_back(v);
 	}
 	break;
 
 	case Op::NEG:
 	{
 		POP1;
-		stack.push(-a);
+		stack.push_back(-a);
 	}
 	break;
 
+	// the waveform operators wrap their input to 'w', which a program is free to set to anything,
+	// so they need to check for division by zero just like DIV and MOD.
 	case Op::SIN:
 	{
 		POP1;
-		Value r = Get('w');
-		Value hr = r / 2;
+		V r = Var('w');
+		V hr = r / 2;
 		r += 1;
+		if (r == 0) { Fault(RE_DIVIDE_BY_ZERO); stack.push_back(0); break; }
 		double s = sin(2 * M_PI * ((double)(a%r) / r));
-		stack.push(Value(s*hr + hr));
+		stack.push_back(V(s*hr + hr));
 	}
 	break;
 
 	case Op::SQR:
 	{
 		POP1;
-		const Value r = Get('w');
-		const Value v = a%r < r / 2 ? 0 : r - 1;
-		stack.push(v);
+		const V r = Var('w');
+		if (r == 0) { Fault(RE_DIVIDE_BY_ZERO); stack.push_back(0); break; }
+		const V v = a%r < r / 2 ? 0 : r - 1;
+		stack.push_back(v);
 	}
 	break;
 
@@ -902,15 +2885,16 @@ Program::RuntimeError Program::Exec(const Op& op, Value* results, size_t size)
 		POP1;
 		if (a == 0)
 		{
-			stack.push(0);
+			stack.push_back(0);
 		}
 		else
 		{
 			// 3.023625 is a magic number arrived at by comparing our output to the Saw Wave in ReaSynth.
 			// 3.0 is what we'd expect to see if we were operating in floating point,
 			// but if we use 3.0 here, the pitch winds up being a little bit flat.
-			double f = round(4.0 * 3.023625 * pow(2.0, (double)a / 12.0) * (44100.0 / Get('~')));
-			stack.push((Value)f);
+			double f = round(4.0 * 3.023625 * pow(2.0, (double)a / 12.0) * (44100.0 / Var('~')));
+			// through Value so that frequencies too high for V wrap around instead of being undefined
+			stack.push_back((V)(Value)f);
 		}
 	}
 	break;
@@ -919,44 +2903,48 @@ Program::RuntimeError Program::Exec(const Op& op, Value* results, size_t size)
 	{
 		POP1;
 		a *= 2;
-		const Value r = Get('w');
-		const Value v = a*((a / r) % 2) + (r - a - 1)*(1 - (a / r) % 2);
-		stack.push(v);
+		const V r = Var('w');
+		if (r == 0) { Fault(RE_DIVIDE_BY_ZERO); stack.push_back(0); break; }
+		const V v = a*((a / r) % 2) + (r - a - 1)*(1 - (a / r) % 2);
+		stack.push_back(v);
 	}
 	break;
 
 	case Op::RND:
 	{
 		POP1;
-		stack.push(rng() % a);
+		V v = 0;
+		if (a) { v = (V)(rng() % a); }
+		else { Fault(RE_DIVIDE_BY_ZERO); }
+		stack.push_back(v);
 	}
 	break;
 
 	case Op::CCV:
 	{
 		POP1;
-		stack.push(GetCC(a));
+		stack.push_back((V)GetCC(a));
 	}
 	break;
 
 	case Op::VCV:
 	{
 		POP1;
-		stack.push(GetVC(a));
+		stack.push_back((V)GetVC(a));
 	}
 	break;
 			
 	case Op::NOT:
 	{
 		POP1;
-		stack.push(!a);
+		stack.push_back(!a);
 	}
 	break;
 	
 	case Op::COM:
 	{
 		POP1;
-		stack.push(~a);
+		stack.push_back(~a);
 	}
 	break;
 
@@ -964,143 +2952,137 @@ Program::RuntimeError Program::Exec(const Op& op, Value* results, size_t size)
 	case Op::MUL:
 	{
 		POP2;
-		stack.push(a*b);
+		stack.push_back(a*b);
 	}
 	break;
 
 	case Op::DIV:
 	{
 		POP2;
-		Value v = 0;
+		V v = 0;
 		if (b) { v = a / b; }
-		else { error = RE_DIVIDE_BY_ZERO; }
-		stack.push(v);
+		else { Fault(RE_DIVIDE_BY_ZERO); }
+		stack.push_back(v);
 	}
 	break;
 
 	case Op::MOD:
 	{
 		POP2;
-		Value v = 0;
+		V v = 0;
 		if (b) { v = a%b; }
-		else { error = RE_DIVIDE_BY_ZERO; }
-		stack.push(v);
+		else { Fault(RE_DIVIDE_BY_ZERO); }
+		stack.push_back(v);
 	}
 	break;
 
 	case Op::ADD:
 	{
 		POP2;
-		stack.push(a + b);
+		stack.push_back(a + b);
 	}
 	break;
 
 	case Op::SUB:
 	{
 		POP2;
-		stack.push(a - b);
+		stack.push_back(a - b);
 	}
 	break;
 
 	case Op::BSL:
 	{
 		POP2;
-		const auto s = b % 64;
-		stack.push(a << s);
+		const auto s = b % (sizeof(V) * 8);
+		stack.push_back(a << s);
 	}
 	break;
 
 	case Op::BSR:
 	{
 		POP2;
-		const auto s = b % 64;
-		stack.push(a >> s);
+		const auto s = b % (sizeof(V) * 8);
+		stack.push_back(a >> s);
 	}
 	break;
 
 	case Op::AND:
 	{
 		POP2;
-		stack.push(a&b);
+		stack.push_back(a&b);
 	}
 	break;
 
 	case Op::OR:
 	{
 		POP2;
-		stack.push(a | b);
+		stack.push_back(a | b);
 	}
 	break;
 
 	case Op::XOR:
 	{
 		POP2;
-		stack.push(a^b);
+		stack.push_back(a^b);
 	}
 	break;
 
 	case Op::CEQ:
 	{
 		POP2;
-		stack.push(a == b);
+		stack.push_back(a == b);
 	}
 	break;
 
 	case Op::CNE:
 	{
 		POP2;
-		stack.push(a != b);
+		stack.push_back(a != b);
 	}
 	break;
 
 	case Op::CLT:
 	{
 		POP2;
-		stack.push(a < b);
+		stack.push_back(a < b);
 	}
 	break;
 
 	case Op::CLE:
 	{
 		POP2;
-		stack.push(a <= b);
+		stack.push_back(a <= b);
 	}
 	break;
 
 	case Op::CGT:
 	{
 		POP2;
-		stack.push(a > b);
+		stack.push_back(a > b);
 	}
 	break;
 
 	case Op::CGE:
 	{
 		POP2;
-		stack.push(a >= b);
+		stack.push_back(a >= b);
 	}
 	break;
 
 	// number of operands is variable
 	case Op::POK:
 	{
-		// pop off all of the results
-		POP(op.val);
-		// pop off the address for the first result
-		POP1;
+		// the results are on the top of the stack, with the address for the first result beneath them
+		PEEK(op.val);
 
-		// the order of the args is last to first,
-		// ie: { 1, 2, 3 } winds up in args as { 3, 2, 1 }
-		// this is why we pop values for Poke from the back of args.
 		for (int i = 0; i < op.val; ++i)
 		{
-			Value b = args.back();
-			args.pop_back();
-
-			Value address = a + i;
-			Poke(address, b);
+			const V address = a + i;
+			mem[address % memSize] = args[i];
 		}
 
+		DROP(op.val);
+
 		// the result of this operation should be what is now in the *first* memory address (ie 'a')
 		// this is to make chained assignment statements work as expected. 
 		// for example:
@@ -1108,41 +3090,36 @@ Program::RuntimeError Program::Exec(const Op& op, Value* results, size_t size)
 		//	a = @1 = { 1, 2, 3 };
 		//
 		// should result in the value of 'a' being equal to the value of '@1'
-		stack.push(Peek(a));
+		stack.push_back(mem[a % memSize]);
 	}
 	break;
 
 	case Op::PUT:
 	{
-		// pop off all of the results
-		POP(op.val);
-		// pop off the address for the first result
-		POP1;
+		// the results are on the top of the stack, with the address for the first result beneath them
+		PEEK(op.val);
 
-		Value b = args.back();
-		args.pop_back();
+		const size_t count = (size_t)op.val;
+		V b = args[0];
 
 		// [*] = should fill the entire output
 		// so we assign results in order until we run out
 		// and then repeat the last one to the remaining outputs.
 		// so, if there is only 1 result, it is copied to all outputs.
-		if (a == Wildcard::Value)
+		if (a == (V)Wildcard::Value)
 		{	
 			// since [*] returns the sum of all values (see GET), we need to sum up the output as we go
-			Value c = 0;
+			V c = 0;
 
 			for (size_t i = 0; i < size; ++i)
 			{
+				b = args[i < count ? i : count - 1];
 				results[i] = b;
 				c += b;
-				if (!args.empty())
-				{
-					b = args.back();
-					args.pop_back();
-				}
 			}
 
-			stack.push(c);
+			DROP(count);
+			stack.push_back(c);
 		}
 		else if (a < size)
 		{
@@ -1152,21 +3129,20 @@ Program::RuntimeError Program::Exec(const Op& op, Value* results, size_t size)
 			// a = [0] = { 1, 2 }
 			//
 			// should make a and [0] equal to 1, while [1] would be equal to 2
-			stack.push(b);
-
 			// begin assigning results starting from the provided index,
 			// but stop if we run out of args or get to the end of the output array.
-			results[a++] = b;
-			while (a < size && !args.empty())
+			for (size_t i = 0; i < count && a < size; ++i)
 			{
-				b = args.back();
-				args.pop_back();
-				results[a++] = b;
+				results[a++] = args[i];
 			}
+
+			DROP(count);
+			stack.push_back(b);
 		}
 		else
 		{
-			error = RE_PUT_OUT_OF_BOUNDS;
+			DROP(count);
+			Fault(RE_PUT_OUT_OF_BOUNDS);
 		}		
 	}
 	break;
@@ -1189,21 +3165,148 @@ Program::RuntimeError Program::Exec(const Op& op, Value* results, size_t size)
 	}
 	break;
 
+	case Op::EVR:
+	{
+		POP2;
+		if (b == 0) { Fault(RE_DIVIDE_BY_ZERO); break; }
+		if (a % b != 0)
+		{
+			pc = op.val-1;
+		}
+	}
+	break;
+
+	// ring buffers are indexed by t, so the slot for the current sample moves forward by one every time the program runs.
+	// the address of the buffer, a, is usually a constant that doesn't need to wrap, so we can skip the modulo that Peek does.
+	case Op::TAP:
+	{
+		POP3;
+		if (b == 0) { Fault(RE_DIVIDE_BY_ZERO); break; }
+		const V address = a + GetRingOffset<V>(Var('t') - c, b);
+		stack.push_back(mem[address < memSize ? address : address % memSize]);
+	}
+	break;
+
+	case Op::REC:
+	{
+		POP3;
+		if (b == 0) { Fault(RE_DIVIDE_BY_ZERO); break; }
+		const V address = a + GetRingOffset<V>(Var('t'), b);
+		mem[address < memSize ? address : address % memSize] = c;
+		stack.push_back(c);
+	}
+	break;
+
+	// copy and fill can't do more than all of memory, so these are bounded no matter what the count is.
+	// like POK, the result is what is now in the first address.
+	case Op::CPY:
+	{
+		POP3;
+		const V dst = a % memSize;
+		const V src = b % memSize;
+		const V count = std::min(c, (V)memSize);
+		// how far the values move around the ring of memory
+		const V distance = (dst + memSize - src) % memSize;
+		if (distance < count && memSize - distance < count)
+		{
+			// the destination overlaps both ends of the source, eg when copying all of memory, so copying forwards or
+			// backwards would overwrite values before they are read. rotating all of memory moves every value by the
+			// distance, and then the ones outside of the destination are moved back, from where the rotation put them.
+			std::rotate(mem, mem + (memSize - distance), mem + memSize);
+			for (V i = count; i < memSize; ++i)
+			{
+				mem[(dst + i) % memSize] = mem[(dst + i + distance) % memSize];
+			}
+		}
+		else if (dst + count <= memSize && src + count <= memSize)
+		{
+			memmove(mem + dst, mem + src, count * sizeof(V));
+		}
+		else if (distance < count)
+		{
+			// the destination starts inside of the source, so copy backwards to read each value before it is overwritten
+			for (V i = count; i-- > 0;)
+			{
+				mem[(dst + i) % memSize] = mem[(src + i) % memSize];
+			}
+		}
+		else
+		{
+			for (V i = 0; i < count; ++i)
+			{
+				mem[(dst + i) % memSize] = mem[(src + i) % memSize];
+			}
+		}
+		stack.push_back(mem[dst]);
+	}
+	break;
+
+	case Op::FIL:
+	{
+		POP3;
+		const V dst = a % memSize;
+		const V count = std::min(b, (V)memSize);
+		const V end = std::min(dst + count, (V)memSize);
+		std::fill(mem + dst, mem + end, c);
+		// the rest wraps around to the start of memory
+		std::fill(mem, mem + (count - (end - dst)), c);
+		stack.push_back(mem[dst]);
+	}
+	break;
+
+	// for the filters and envelopes a is the address of the state, b is the input, and c is the rate.
+	// the lowpass state has 16 bits of fraction, so slow filters still move when they are close to the input.
+	// that leaves 48 bits for the input with 64-bit values and 16 with 32-bit values, and larger inputs are clamped
+	// to fit, which the highpass subtracts from as well so that it still settles at zero.
+	// the step is rate/256 of the distance to the input, rounded towards the state, and is worked out
+	// in two parts so that it can't overflow however far apart they are.
+	case Op::LPF:
+	case Op::HPF:
+	{
+		POP3;
+		V& s = mem[a < memSize ? a : a % memSize];
+		const V input = std::min(b, (V)(~(V)0 >> 16));
+		const V target = input << 16;
+		const V rate = std::min(c, (V)256);
+		const V distance = target > s ? target - s : s - target;
+		const V step = distance / 256 * rate + distance % 256 * rate / 256;
+		s = target > s ? s + step : s - step;
+		const V lowpass = s >> 16;
+		stack.push_back(op.code == Op::LPF ? lowpass : input - lowpass);
+	}
+	break;
+
+	case Op::SLW:
+	{
+		POP3;
+		V& s = mem[a < memSize ? a : a % memSize];
+		s = b > s ? s + std::min(b - s, c) : s - std::min(s - b, c);
+		stack.push_back(s);
+	}
+	break;
+
+	case Op::ENV:
+	{
+		POP3;
+		V& s = mem[a < memSize ? a : a % memSize];
+		s = b > s ? b : s - std::min(s - b, c);
+		stack.push_back(s);
+	}
+	break;
+
 	// perform a no-op, but set the error as a result
 	default:
 	{
-		error = RE_MISSING_OPCODE;
+		Fault(RE_MISSING_OPCODE);
 	}
 	break;
 
 bad_stack:
 	{
-		error = RE_MISSING_OPERAND;
+		Fault(RE_MISSING_OPERAND);
 	}
 	break;
 	}
-
-	return error;
 }
 
 Program::Value Program::Get(const Char var) const
@@ -1237,17 +3340,37 @@ void Program::SetVC(const Value idx, const Value value)
 	vc[idx % kVCSize] = value;
 }
 
-Program::Value Program::Peek(const Value address) const
+template<typename V>
+Program::Value ProgramT<V>::Peek(const Value address) const
 {
 	// peeks wrap around so we never go outside of our memory space
 	return mem[address%memSize];
 }
 
-
-void Program::Poke(const Value address, const Value value)
+template<typename V>
+void ProgramT<V>::Poke(const Value address, const Value value)
 {
 	// pokes wrap around so we never go outside of our memory space
-	mem[address%memSize] = value;
+	mem[address%memSize] = (V)value;
+}
+
+template<typename V>
+void ProgramT<V>::GetMemory(Value* outValues) const
+{
+	std::copy(mem, mem + memSize, outValues);
+}
+
+template<typename V>
+void ProgramT<V>::SetMemory(const Value* values)
+{
+	for (size_t i = 0; i < memSize; ++i)
+	{
+		mem[i] = (V)values[i];
+	}
 }
 
+// the interpreters that Compile can create
+template class ProgramT<uint64_t>;
+template class ProgramT<uint32_t>;
+
 #pragma endregion
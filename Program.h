@@ -10,8 +10,8 @@
 
 #include <stdint.h>
 #include <vector>
-#include <stack>
 #include <random>
+#include <string>
 
 class Program
 {
@@ -29,8 +29,22 @@ public:
 		CE_ILLEGAL_STATEMENT_TERMINATION, // found a semi-colon where one isn't allowed
 		CE_ILLEGAL_VARIABLE_NAME, // found an uppercase letter where we expected a lowercase one
 		CE_MISSING_PUT, // the program does not contain any PUT instructions
+		CE_NESTED_TOO_DEEPLY, // parens, brackets, ternaries, assignments, or blocks are nested deeper than kMaxNestingDepth
+		CE_MISSING_BLOCK, // the header of an every or repeat block was not followed by '{'
+		CE_ILLEGAL_REPEAT_COUNT, // the count of a repeat block is not a number or is more than kMaxRepeatCount
+		CE_PROGRAM_TOO_LONG, // unrolling repeat blocks or inlining functions produced more than kMaxInstructionCount instructions
+		CE_ILLEGAL_FUNCTION_DEFINITION, // a def has a bad or duplicate name, bad parameters, or is not at the top level
+		CE_UNKNOWN_FUNCTION, // a call to a function that has not been defined yet
+		CE_WRONG_ARGUMENT_COUNT, // a call passes a different number of arguments than the function has parameters
+		CE_ILLEGAL_STATE_ARGUMENT, // the state of a filter or envelope is not a variable or memory address
 	};
 
+	// the parser recurses for each level of nesting, this limits how much stack compiling can use.
+	static const int kMaxNestingDepth = 256;
+	// repeat blocks are unrolled and functions are inlined, so these limit how big they can make a program
+	static const uint64_t kMaxRepeatCount = 1024;
+	static const size_t kMaxInstructionCount = 1 << 20;
+
 	enum RuntimeError
 	{
 		RE_NONE,
@@ -41,13 +55,25 @@ public:
 		RE_EMPTY_PROGRAM, // the program has no instructions to execute
 		RE_GET_OUT_OF_BOUNDS, // index for GET was bigger than the size of the results array
 		RE_PUT_OUT_OF_BOUNDS, // index for PUT was bigger than the size of the results array
+
+		RE_COUNT // the number of runtime errors, not an actual error
 	};
 
 	// type of the string expression for Compile
 	typedef char	 Char;
-	// type of the value returned by evaluation
+	// type of the value returned by evaluation.
+	// this is also the type of memory, results, and constants outside of the program, even when it runs with 32-bit values.
 	typedef uint64_t Value;
 
+	// the width of the values that a program computes with, which is where all of the arithmetic wraps around.
+	// programs compile to the same instructions for both, only the interpreter and its memory differ.
+	enum ValueWidth
+	{
+		VW_64, // what the language is defined with
+		VW_32, // half of the memory, and cheaper arithmetic on 32-bit machines
+		VW_AUTO, // only for Compile, which picks VW_32 when IsEquivalentAt32Bits and VW_64 otherwise
+	};
+
 	struct Op
 	{
 	public:
@@ -89,6 +115,15 @@ public:
 			NOT,
 			COM,
 			JMP, // JMP to the address indicated by val
+			EVR, // every - pops a rate and the value of t, jumps to the address indicated by val unless t is a multiple of the rate
+			TAP, // tap(a, n, d) - read the value written d samples ago to the ring buffer of n values at address a
+			REC, // rec(a, n, x) - write x to the ring buffer of n values at address a, in the slot for the current value of t
+			CPY, // copy(a, b, n) - copy n values of memory from address b to address a
+			FIL, // fill(a, n, x) - set n values of memory starting at address a to x
+			LPF, // lpf(s, x, k) - one-pole lowpass of x, moving k/256 of the way towards it each time, with its state in s
+			HPF, // hpf(s, x, k) - x minus the lowpass of it, with the state of the lowpass in s
+			SLW, // slew(s, x, r) - move s towards x by at most r
+			ENV, // env(s, x, r) - jump s up to x when x is higher, otherwise move it down towards x by at most r
 		};
 
 		// need default constructor or we can't use vector
@@ -103,32 +138,101 @@ public:
 	// userMemorySize is used to determine the size of read/write memory used by the program.
 	// "user" memory is memory that is accessible only via the @ operator and is otherwise 
 	// not modified by the program (but can be externally modified from C++ by calling Peek).
-	static Program* Compile(const Char* source, const size_t userMemorySize, CompileError& outError, int& outErrorPosition);
+	static Program* Compile(const Char* source, const size_t userMemorySize, CompileError& outError, int& outErrorPosition, const ValueWidth width = VW_64);
 	// get the address in memory of a variable declared in a program with a particular userMemorySize.
 	static Value GetAddress(const Char var, size_t userMemorySize);
+	// get the size of the memory of a program compiled with a particular userMemorySize, ie what GetMemorySize will return
+	static size_t GetTotalMemorySize(const size_t userMemorySize);
 
 	// get human-readable descriptions of errors
 	static const char * GetErrorString(CompileError error);
 	static const char * GetErrorString(RuntimeError error);
 
-	Program(const std::vector<Op>& inOps, const size_t userMemorySize);
-	~Program();
+	// get the three letter mnemonic for an opcode, eg "PSH"
+	static const char * GetOpName(Op::Code code);
+	// estimated number of cpu cycles it takes to execute an instruction, including dispatch.
+	// these are rough numbers for a modern desktop cpu and are only meant for comparing programs.
+	static uint64_t GetCost(const Op& op);
+
+	virtual ~Program() {}
 
 	uint64_t GetInstructionCount() const { return ops.size(); }
+	ValueWidth GetValueWidth() const { return width; }
+
+	// the line of the source code (starting from 1) that the instruction at address was compiled from.
+	int GetLine(const size_t address) const;
+	// estimated number of cpu cycles it takes to run the program once, following the most expensive branches.
+	uint64_t GetEstimatedCost() const;
+	// the deepest the stack can get while running the program.
+	size_t GetMaxStackDepth() const;
+	// a listing of every instruction with its cost and the stack depth after executing it,
+	// followed by the total cost of each statement.
+	std::string Disassemble() const;
+	// just the statement totals from Disassemble, formatted to fit in the plugin console.
+	std::string GetCostSummary() const;
+
+	// what a function made by GenerateSource is given every time it runs.
+	// the generated source can't include this header, so it declares the same struct as EvaluatorFrame.
+	struct GeneratedFrame
+	{
+		void* mem; // GetMemorySize() values with the width of the program's values
+		const Value* cc;
+		const Value* vc;
+		Value* results;
+		size_t size;
+		uint64_t (*random)(void* rng); // the next number from rng, which the function only passes back
+		void* rng;
+		size_t address; // set to the address of the instruction that caused the error that is returned
+	};
+	// returns the RuntimeError that Run would
+	typedef int (*GeneratedFunction)(GeneratedFrame* frame);
+
+	// C++ source for a function with C linkage called functionName that does exactly what Run does for this program,
+	// so that programs can be built ahead of time, see GeneratedProgram.h. the memory size and value width are built into it.
+	// it only needs the standard library, and the sources for any number of programs can go in the same file.
+	// returns an empty string for programs that Compile wouldn't make, such as ones with backwards jumps.
+	std::string GenerateSource(const char* functionName) const;
+	// true when it is proven that running with 32-bit values gives the same runtime errors and the same low 32 bits
+	// in every output as running with 64-bit values, so that they sound the same at any bit depth up to 32.
+	// t, m, and q can have any value, since they keep counting for as long as the host plays,
+	// and this assumes that the other values set from outside of the program, like w and the inputs, fit in 31 bits.
+	bool IsEquivalentAt32Bits() const;
 
 	// run the program placing the value it evaluates to into the results array.
 	// count is provided so that we can prevent the program from overrunning the array.
-	RuntimeError Run(Value* results, const size_t size);
+	// execution stops at the first runtime error, which is returned and also counted (see GetErrorCount).
+	virtual RuntimeError Run(Value* results, const size_t size) = 0;
+
+	// how many times Run has been called
+	uint64_t GetRunCount() const { return runCount; }
+	// how many calls to Run ended with this error. RE_NONE counts the runs that didn't have an error.
+	uint64_t GetErrorCount(const RuntimeError error) const;
+	// the line of the source code (starting from 1) of the instruction that first caused this error,
+	// 0 if the error hasn't happened.
+	int GetErrorLine(const RuntimeError error) const;
+	// one line for each kind of error that has happened, eg "Divide by zero x3200 at line 4"
+	void GetErrorSummary(char* text, size_t size) const;
 
 	// get the current value of a var, eg Get('t')
 	Value Get(const Char var) const;
 	// set the value of a var, eg Set('m', 128)
 	void  Set(const Char var, const Value value);
 
+	// size of the memory space, including the variables. addresses wrap around to fit in this.
+	size_t GetMemorySize() const { return memSize; }
+	// bytes used by this object and everything it allocated: memory, instructions, debug info, and the execution stack
+	virtual size_t GetFootprint() const = 0;
 	// get the value at this memory address
-	Value Peek(const Value address) const;
-	// set the value at this memory address
-	void  Poke(const Value address, const Value value);
+	virtual Value Peek(const Value address) const = 0;
+	// set the value at this memory address, which is truncated when running with 32-bit values
+	virtual void  Poke(const Value address, const Value value) = 0;
+	// copy all GetMemorySize() values of memory, including the variables, eg to save them with the plugin state
+	virtual void  GetMemory(Value* outValues) const = 0;
+	virtual void  SetMemory(const Value* values) = 0;
+
+	// how many CC and VC values there are
+	static const size_t kCCSize = 128;
+	static const size_t kVCSize = 8;
 
 	// get/set a control change. these are accessible in the program with the 'C' operator
 	Value GetCC(const Value idx) const;
@@ -138,31 +242,82 @@ public:
 	Value GetVC(const Value idx) const;
 	void  SetVC(const Value idx, const Value value);
 
-private:
+	// restart the sequence of numbers generated by the 'R' operator,
+	// which is seeded from the clock when the program is created.
+	void SetRandomSeed(const uint64_t seed) { rng.seed((std::default_random_engine::result_type)seed); }
 
-	RuntimeError Exec(const Op& op, Value* results, size_t size);
+protected:
 
-	static const size_t kCCSize = 128;
-	static const size_t kVCSize = 8;
+	Program(const std::vector<Op>& inOps, const size_t userMemorySize, const ValueWidth valueWidth);
+
+	// count the error and move pc past the end of the program so that Run stops after the current instruction
+	void Fault(const RuntimeError error);
 
 	// the compiled code
 	std::vector<Op> ops;
+	// where in the source code each op was generated from, set by Compile
+	std::vector<int> opPositions;
+	// offsets into the source code where each line begins, set by Compile
+	std::vector<int> lineStarts;
 	size_t pc; // program counter, stored here because it can be changed by TRN and JMP
 	const size_t userMemSize; // how much of mem is "user" memory
 	const size_t memSize; // the actual size of mem
-	// the memory space - read/write memory for the program (use Peek/Poke from C++)
-	// this includes "user" memory accessible with @, where @0 maps to mem[0]
-	// and also includes "variable" memory accessible with lowercase letters like 'a', 'b', 'c', etc.
-	// it is also possible to access variable values with @ if you know the address of the variable.
-	// for safety, we always wrap the address to the size of the array to prevent invalid access.
-	Value* mem;
+	const ValueWidth width;
 	// memory for storing MIDI CC values - readonly from within a program
 	Value cc[kCCSize];
 	// memory for storing VC values = readonly from within a program
 	Value vc[kVCSize];
-	// the execution stack (reused each time Run is called)
-	std::stack<Value> stack;
+	// every runtime error is counted here instead of being checked after each instruction
+	struct ErrorStat
+	{
+		uint64_t count;
+		size_t firstAddress; // address of the instruction that caused the first error
+	};
+	ErrorStat errors[RE_COUNT];
+	// the error that stopped the current call to Run
+	RuntimeError runError;
+	uint64_t runCount;
 	// rng because rand() doesn't generate a large enough range
 	std::default_random_engine rng;
+
+private:
+
+	// static analysis used by the disassembler.
+	// fills depths with the stack depth after each instruction
+	// and costs with the most expensive path from each instruction to the end of the program.
+	void Analyze(std::vector<int>& depths, std::vector<uint64_t>& costs) const;
+};
+
+// the interpreter, which computes with values of type V so that all of the arithmetic wraps around at its width.
+// Compile creates a ProgramT<uint64_t> or a ProgramT<uint32_t>, depending on the ValueWidth.
+template<typename V>
+class ProgramT : public Program
+{
+public:
+	ProgramT(const std::vector<Op>& inOps, const size_t userMemorySize);
+	~ProgramT();
+
+	RuntimeError Run(Value* results, const size_t size) override;
+
+	size_t GetFootprint() const override;
+	Value Peek(const Value address) const override;
+	void  Poke(const Value address, const Value value) override;
+	void  GetMemory(Value* outValues) const override;
+	void  SetMemory(const Value* values) override;
+
+private:
+
+	void Exec(const Op& op, Value* results, size_t size);
+	// the value of a variable, which is always inside of memory so it doesn't need to wrap
+	V Var(const Char var) const { return mem[GetAddress(var, userMemSize)]; }
+
+	// the memory space - read/write memory for the program (use Peek/Poke from C++)
+	// this includes "user" memory accessible with @, where @0 maps to mem[0]
+	// and also includes "variable" memory accessible with lowercase letters like 'a', 'b', 'c', etc.
+	// it is also possible to access variable values with @ if you know the address of the variable.
+	// for safety, we always wrap the address to the size of the array to prevent invalid access.
+	V* mem;
+	// the execution stack (reused each time Run is called)
+	std::vector<V> stack;
 };
 
@@ -0,0 +1,764 @@
+//
+//  ProgramDSL.h
+//  Evaluator
+//
+//  Evaluator programs written directly in C++ with expression templates, for tools and test harnesses.
+//  The C++ compiler turns a program into one inlined function with the same semantics as Program::Exec,
+//  and DSL::Compile wraps that in a Program, so it can be run anywhere a compiled program can. For example:
+//
+//    using namespace DSL;
+//    Program* saw = DSL::Compile(program(t = t / 5, put(all, t & (t >> 8))), 1024);
+//
+//  is the same as compiling "t = t/5; [*] = t&t>>8". The language maps to C++ like this:
+//
+//    a .. z                  a .. z, assigned with =
+//    @x  [x]  [*]            at(x)  out(x)  out(all)
+//    @x = { a, b }           poke(at(x), a, b), and put(x, a, b) for the outputs
+//    $x  #x  Tx  Fx          sine(x)  square(x)  triangle(x)  freq(x)
+//    Rx  Cx  Vx              rnd(x)  cc(x)  vc(x)
+//    c ? a : b   c ? a       when(c, a, b)  when(c, a)
+//    s; s; s                 program(s, s, s)
+//    every n { s; s }        every(n, s, s)
+//    built-in functions      tap rec copy fill lpf hpf slew env, which take the same arguments
+//
+//  Operators have the precedence of C++ rather than the language, which differs for shifts and comparisons,
+//  so add parentheses wherever the two disagree. repeat blocks and def functions are left to C++ itself.
+//
+
+#pragma once
+
+#include "Program.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
+
+namespace DSL
+{
+	typedef Program::Value Value;
+	typedef Program::Op::Code Code;
+
+	// the address of [*], which is Wildcard::Value in Program.cpp
+	static const Value kAll = (Value)-1;
+	// M_PI, which needs _USE_MATH_DEFINES on windows
+	static const double kPi = 3.14159265358979323846;
+
+	// everything a running program can see, which is the same memory Program would use
+	struct Context
+	{
+		Value* mem;
+		size_t memSize;
+		size_t userMemSize;
+		const Value* cc;
+		const Value* vc;
+		std::default_random_engine& rng;
+		Value* results;
+		size_t size;
+		// a fault stops a Program immediately, so once this is set nothing with a side effect happens
+		Program::RuntimeError error;
+
+		Value& Var(const Program::Char var) const { return mem[Program::GetAddress(var, userMemSize)]; }
+		bool Running() const { return error == Program::RE_NONE; }
+		Value Fault(const Program::RuntimeError runtimeError)
+		{
+			if (Running()) error = runtimeError;
+			return 0;
+		}
+	};
+
+#pragma region Instructions
+	// these are the cases of Program::Exec, with code known at compile time so that the switch disappears.
+
+	template<Code code>
+	inline Value Unary(Context& c, Value a)
+	{
+		switch (code)
+		{
+		case Program::Op::PEK: return c.mem[a % c.memSize];
+		case Program::Op::NEG: return -a;
+		case Program::Op::COM: return ~a;
+		case Program::Op::NOT: return !a;
+		case Program::Op::CCV: return c.cc[a % Program::kCCSize];
+		case Program::Op::VCV: return c.vc[a % Program::kVCSize];
+
+		case Program::Op::GET:
+		{
+			Value v = 0;
+			if (a == kAll)
+			{
+				for (size_t i = 0; i < c.size; ++i)
+				{
+					v += c.results[i];
+				}
+			}
+			else if (a < c.size)
+			{
+				v = c.results[a];
+			}
+			else
+			{
+				c.Fault(Program::RE_GET_OUT_OF_BOUNDS);
+			}
+			return v;
+		}
+
+		case Program::Op::SIN:
+		{
+			Value r = c.Var('w');
+			Value hr = r / 2;
+			r += 1;
+			if (r == 0) return c.Fault(Program::RE_DIVIDE_BY_ZERO);
+			double s = sin(2 * kPi * ((double)(a%r) / r));
+			return Value(s*hr + hr);
+		}
+
+		case Program::Op::SQR:
+		{
+			const Value r = c.Var('w');
+			if (r == 0) return c.Fault(Program::RE_DIVIDE_BY_ZERO);
+			return a%r < r / 2 ? 0 : r - 1;
+		}
+
+		case Program::Op::FRQ:
+		{
+			if (a == 0) return 0;
+			double f = round(4.0 * 3.023625 * pow(2.0, (double)a / 12.0) * (44100.0 / c.Var('~')));
+			return (Value)f;
+		}
+
+		case Program::Op::TRI:
+		{
+			a *= 2;
+			const Value r = c.Var('w');
+			if (r == 0) return c.Fault(Program::RE_DIVIDE_BY_ZERO);
+			return a*((a / r) % 2) + (r - a - 1)*(1 - (a / r) % 2);
+		}
+
+		// a Program that has faulted doesn't get this far, so it mustn't advance the rng either
+		case Program::Op::RND:
+			if (!c.Running()) return 0;
+			if (a == 0) return c.Fault(Program::RE_DIVIDE_BY_ZERO);
+			return c.rng() % a;
+
+		default:
+			return c.Fault(Program::RE_MISSING_OPCODE);
+		}
+	}
+
+	template<Code code>
+	inline Value Binary(Context& c, const Value a, const Value b)
+	{
+		switch (code)
+		{
+		case Program::Op::MUL: return a*b;
+		case Program::Op::DIV: return b ? a / b : c.Fault(Program::RE_DIVIDE_BY_ZERO);
+		case Program::Op::MOD: return b ? a%b : c.Fault(Program::RE_DIVIDE_BY_ZERO);
+		case Program::Op::ADD: return a + b;
+		case Program::Op::SUB: return a - b;
+		case Program::Op::BSL: return a << (b % 64);
+		case Program::Op::BSR: return a >> (b % 64);
+		case Program::Op::AND: return a&b;
+		case Program::Op::OR: return a | b;
+		case Program::Op::XOR: return a^b;
+		case Program::Op::CEQ: return a == b;
+		case Program::Op::CNE: return a != b;
+		case Program::Op::CLT: return a < b;
+		case Program::Op::CLE: return a <= b;
+		case Program::Op::CGT: return a > b;
+		case Program::Op::CGE: return a >= b;
+		default: return c.Fault(Program::RE_MISSING_OPCODE);
+		}
+	}
+
+	static inline Value GetRingOffset(const Value position, const Value length)
+	{
+		return (length & (length - 1)) == 0 ? position & (length - 1) : position % length;
+	}
+
+	// the built-in functions, which all take three arguments
+	template<Code code>
+	inline Value Ternary(Context& c, const Value a, const Value b, const Value v)
+	{
+		if (!c.Running()) return 0;
+
+		Value* mem = c.mem;
+		const Value memSize = c.memSize;
+		switch (code)
+		{
+		case Program::Op::TAP:
+		{
+			if (b == 0) return c.Fault(Program::RE_DIVIDE_BY_ZERO);
+			const Value address = a + GetRingOffset(c.Var('t') - v, b);
+			return mem[address < memSize ? address : address % memSize];
+		}
+
+		case Program::Op::REC:
+		{
+			if (b == 0) return c.Fault(Program::RE_DIVIDE_BY_ZERO);
+			const Value address = a + GetRingOffset(c.Var('t'), b);
+			mem[address < memSize ? address : address % memSize] = v;
+			return v;
+		}
+
+		case Program::Op::CPY:
+		{
+			const Value dst = a % memSize;
+			const Value src = b % memSize;
+			const Value count = std::min(v, memSize);
+			const Value distance = (dst + memSize - src) % memSize;
+			if (distance < count && memSize - distance < count)
+			{
+				std::rotate(mem, mem + (memSize - distance), mem + memSize);
+				for (Value i = count; i < memSize; ++i)
+				{
+					mem[(dst + i) % memSize] = mem[(dst + i + distance) % memSize];
+				}
+			}
+			else if (dst + count <= memSize && src + count <= memSize)
+			{
+				memmove(mem + dst, mem + src, count * sizeof(Value));
+			}
+			else if (distance < count)
+			{
+				for (Value i = count; i-- > 0;)
+				{
+					mem[(dst + i) % memSize] = mem[(src + i) % memSize];
+				}
+			}
+			else
+			{
+				for (Value i = 0; i < count; ++i)
+				{
+					mem[(dst + i) % memSize] = mem[(src + i) % memSize];
+				}
+			}
+			return mem[dst];
+		}
+
+		case Program::Op::FIL:
+		{
+			const Value dst = a % memSize;
+			const Value count = std::min(b, memSize);
+			const Value end = std::min(dst + count, memSize);
+			std::fill(mem + dst, mem + end, v);
+			std::fill(mem, mem + (count - (end - dst)), v);
+			return mem[dst];
+		}
+
+		case Program::Op::LPF:
+		case Program::Op::HPF:
+		{
+			Value& s = mem[a < memSize ? a : a % memSize];
+			const Value input = std::min(b, ~(Value)0 >> 16);
+			const Value target = input << 16;
+			const Value rate = std::min(v, (Value)256);
+			const Value distance = target > s ? target - s : s - target;
+			const Value step = distance / 256 * rate + distance % 256 * rate / 256;
+			s = target > s ? s + step : s - step;
+			const Value lowpass = s >> 16;
+			return code == Program::Op::LPF ? lowpass : input - lowpass;
+		}
+
+		case Program::Op::SLW:
+		{
+			Value& s = mem[a < memSize ? a : a % memSize];
+			s = b > s ? s + std::min(b - s, v) : s - std::min(s - b, v);
+			return s;
+		}
+
+		case Program::Op::ENV:
+		{
+			Value& s = mem[a < memSize ? a : a % memSize];
+			s = b > s ? b : s - std::min(s - b, v);
+			return s;
+		}
+
+		default:
+			return c.Fault(Program::RE_MISSING_OPCODE);
+		}
+	}
+#pragma endregion
+
+#pragma region Expressions
+	// every expression derives from this, so that the operators below only apply to expressions
+	struct Node {};
+
+	template<typename T>
+	struct IsNode : std::is_base_of<Node, T> {};
+
+	struct Const : Node
+	{
+		explicit Const(const Value v) : value(v) {}
+		Value operator()(Context&) const { return value; }
+		Value value;
+	};
+
+	// integers used with expressions become constants
+	template<typename T, bool = IsNode<T>::value>
+	struct ToNode
+	{
+		typedef T Type;
+		static const T& Make(const T& node) { return node; }
+	};
+
+	template<typename T>
+	struct ToNode<T, false>
+	{
+		static_assert(std::is_integral<T>::value, "programs can only contain expressions and integers");
+		typedef Const Type;
+		static Const Make(const T value) { return Const((Value)value); }
+	};
+
+	// true when an operator is applied to an expression and an expression or an integer
+	template<typename A, typename B>
+	struct IsOperands : std::integral_constant<bool,
+		(IsNode<A>::value && (IsNode<B>::value || std::is_integral<B>::value)) || (std::is_integral<A>::value && IsNode<B>::value)> {};
+
+	// the type of an operator, which only exists for IsOperands so that the operators are ignored for everything else
+	template<Code code, typename A, typename B, bool = IsOperands<A, B>::value>
+	struct BinaryOperator {};
+
+	template<Code code, typename A, typename B>
+	struct BinaryOperator<code, A, B, true>;
+
+	// a list of arguments or statements, which are always evaluated in order like they are in a Program
+	struct End
+	{
+		static const size_t kCount = 0;
+		void Eval(Context&, Value*) const {}
+		void Run(Context&) const {}
+	};
+
+	template<typename E, typename Rest>
+	struct Args
+	{
+		static const size_t kCount = 1 + Rest::kCount;
+		Args(const E& e, const Rest& r) : first(e), rest(r) {}
+		void Eval(Context& c, Value* out) const
+		{
+			*out = first(c);
+			rest.Eval(c, out + 1);
+		}
+		// as statements, where a fault stops the rest from running
+		void Run(Context& c) const
+		{
+			first(c);
+			if (c.Running()) rest.Run(c);
+		}
+		E first;
+		Rest rest;
+	};
+
+	template<typename... Es>
+	struct ArgList;
+
+	template<>
+	struct ArgList<>
+	{
+		typedef End Type;
+		static End Make() { return End(); }
+	};
+
+	template<typename E, typename... Es>
+	struct ArgList<E, Es...>
+	{
+		typedef Args<typename ToNode<E>::Type, typename ArgList<Es...>::Type> Type;
+		static Type Make(const E& e, const Es&... es) { return Type(ToNode<E>::Make(e), ArgList<Es...>::Make(es...)); }
+	};
+
+	template<Code code, typename A>
+	struct UnaryNode : Node
+	{
+		explicit UnaryNode(const A& x) : a(x) {}
+		Value operator()(Context& c) const { return Unary<code>(c, a(c)); }
+		A a;
+	};
+
+	template<Code code, typename A, typename B>
+	struct BinaryNode : Node
+	{
+		BinaryNode(const A& x, const B& y) : a(x), b(y) {}
+		Value operator()(Context& c) const
+		{
+			// evaluated in the order a Program pushes them, which C++ doesn't guarantee for the operands of an operator
+			const Value va = a(c);
+			const Value vb = b(c);
+			return Binary<code>(c, va, vb);
+		}
+		A a;
+		B b;
+	};
+
+	template<Code code, typename A, typename B, typename C>
+	struct TernaryNode : Node
+	{
+		TernaryNode(const A& x, const B& y, const C& z) : a(x), b(y), v(z) {}
+		Value operator()(Context& c) const
+		{
+			const Value va = a(c);
+			const Value vb = b(c);
+			const Value vv = v(c);
+			return Ternary<code>(c, va, vb, vv);
+		}
+		A a;
+		B b;
+		C v;
+	};
+
+	// the filters and envelopes take the address of their state rather than its value
+	template<Code code, typename S, typename B, typename C>
+	struct StateNode : Node
+	{
+		StateNode(const S& x, const B& y, const C& z) : s(x), b(y), v(z) {}
+		Value operator()(Context& c) const
+		{
+			const Value address = s.Address(c);
+			const Value vb = b(c);
+			const Value vv = v(c);
+			return Ternary<code>(c, address, vb, vv);
+		}
+		S s;
+		B b;
+		C v;
+	};
+
+	// @ and a .. z, assigning all of the values to memory starting at the address
+	template<typename L, typename Vs>
+	struct Poke : Node
+	{
+		Poke(const L& l, const Vs& vs) : lvalue(l), values(vs) {}
+		Value operator()(Context& c) const
+		{
+			const Value address = lvalue.Address(c);
+			Value v[Vs::kCount];
+			values.Eval(c, v);
+			if (!c.Running()) return 0;
+
+			for (size_t i = 0; i < Vs::kCount; ++i)
+			{
+				c.mem[(address + i) % c.memSize] = v[i];
+			}
+			return c.mem[address % c.memSize];
+		}
+		L lvalue;
+		Vs values;
+	};
+
+	// [] and [*], assigning all of the values to the outputs starting at the address
+	template<typename A, typename Vs>
+	struct Put : Node
+	{
+		Put(const A& a, const Vs& vs) : address(a), values(vs) {}
+		Value operator()(Context& c) const
+		{
+			Value a = address(c);
+			Value args[Vs::kCount];
+			values.Eval(c, args);
+			if (!c.Running()) return 0;
+
+			const size_t count = Vs::kCount;
+			Value b = args[0];
+			if (a == kAll)
+			{
+				Value sum = 0;
+				for (size_t i = 0; i < c.size; ++i)
+				{
+					b = args[i < count ? i : count - 1];
+					c.results[i] = b;
+					sum += b;
+				}
+				return sum;
+			}
+
+			if (a < c.size)
+			{
+				for (size_t i = 0; i < count && a < c.size; ++i)
+				{
+					c.results[a++] = args[i];
+				}
+				return b;
+			}
+
+			return c.Fault(Program::RE_PUT_OUT_OF_BOUNDS);
+		}
+		A address;
+		Vs values;
+	};
+
+	// the operator= of an expression that can be assigned to, which can't be inherited.
+	// the overload for the same type is needed so that it isn't taken by the implicit copy assignment.
+#define DSL_ASSIGNABLE(Self, Assign) \
+	Self(const Self&) = default; \
+	template<typename E> \
+	Assign<Self, typename ArgList<E>::Type> operator=(const E& e) const { return Assign<Self, typename ArgList<E>::Type>(*this, ArgList<E>::Make(e)); } \
+	Assign<Self, Args<Self, End>> operator=(const Self& e) const { return Assign<Self, Args<Self, End>>(*this, Args<Self, End>(e, End())); }
+
+	template<Program::Char C>
+	struct Var : Node
+	{
+		Var() {}
+		Value Address(Context& c) const { return Program::GetAddress(C, c.userMemSize); }
+		Value operator()(Context& c) const { return c.Var(C); }
+		DSL_ASSIGNABLE(Var, Poke)
+	};
+
+	template<typename A>
+	struct At : Node
+	{
+		explicit At(const A& a) : address(a) {}
+		Value Address(Context& c) const { return address(c); }
+		Value operator()(Context& c) const { return Unary<Program::Op::PEK>(c, address(c)); }
+		DSL_ASSIGNABLE(At, Poke)
+		A address;
+	};
+
+	// Put wants the expression for the address rather than an lvalue
+	template<typename O, typename Vs>
+	struct PutOutput : Put<decltype(O::address), Vs>
+	{
+		PutOutput(const O& out, const Vs& vs) : Put<decltype(O::address), Vs>(out.address, vs) {}
+	};
+
+	template<typename A>
+	struct Out : Node
+	{
+		explicit Out(const A& a) : address(a) {}
+		Value operator()(Context& c) const { return Unary<Program::Op::GET>(c, address(c)); }
+		DSL_ASSIGNABLE(Out, PutOutput)
+		A address;
+	};
+
+#undef DSL_ASSIGNABLE
+
+	template<typename A, typename B, typename C>
+	struct When : Node
+	{
+		When(const A& x, const B& y, const C& z) : condition(x), whenTrue(y), whenFalse(z) {}
+		Value operator()(Context& c) const { return condition(c) ? whenTrue(c) : whenFalse(c); }
+		A condition;
+		B whenTrue;
+		C whenFalse;
+	};
+
+	template<typename N, typename Ss>
+	struct Every : Node
+	{
+		Every(const N& n, const Ss& ss) : rate(n), statements(ss) {}
+		Value operator()(Context& c) const
+		{
+			const Value time = c.Var('t');
+			const Value n = rate(c);
+			if (!c.Running()) return 0;
+			if (n == 0) return c.Fault(Program::RE_DIVIDE_BY_ZERO);
+			if (time % n == 0) statements.Run(c);
+			return 0;
+		}
+		N rate;
+		Ss statements;
+	};
+
+	template<typename Ss>
+	struct Block : Node
+	{
+		explicit Block(const Ss& ss) : statements(ss) {}
+		Value operator()(Context& c) const
+		{
+			statements.Run(c);
+			return 0;
+		}
+		Ss statements;
+	};
+#pragma endregion
+
+#pragma region Syntax
+	static const Var<'a'> a; static const Var<'b'> b; static const Var<'c'> c; static const Var<'d'> d;
+	static const Var<'e'> e; static const Var<'f'> f; static const Var<'g'> g; static const Var<'h'> h;
+	static const Var<'i'> i; static const Var<'j'> j; static const Var<'k'> k; static const Var<'l'> l;
+	static const Var<'m'> m; static const Var<'n'> n; static const Var<'o'> o; static const Var<'p'> p;
+	static const Var<'q'> q; static const Var<'r'> r; static const Var<'s'> s; static const Var<'t'> t;
+	static const Var<'u'> u; static const Var<'v'> v; static const Var<'w'> w; static const Var<'x'> x;
+	static const Var<'y'> y; static const Var<'z'> z;
+
+	static const Const all(kAll);
+
+	template<Code code, typename A, typename B>
+	struct BinaryOperator<code, A, B, true>
+	{
+		typedef BinaryNode<code, typename ToNode<A>::Type, typename ToNode<B>::Type> Type;
+	};
+
+#define DSL_BINARY(op, code) \
+	template<typename A, typename B> \
+	inline typename BinaryOperator<code, A, B>::Type operator op(const A& a, const B& b) \
+	{ \
+		return typename BinaryOperator<code, A, B>::Type(ToNode<A>::Make(a), ToNode<B>::Make(b)); \
+	}
+
+	DSL_BINARY(*, Program::Op::MUL)
+	DSL_BINARY(/, Program::Op::DIV)
+	DSL_BINARY(%, Program::Op::MOD)
+	DSL_BINARY(+, Program::Op::ADD)
+	DSL_BINARY(-, Program::Op::SUB)
+	DSL_BINARY(<<, Program::Op::BSL)
+	DSL_BINARY(>>, Program::Op::BSR)
+	DSL_BINARY(&, Program::Op::AND)
+	DSL_BINARY(|, Program::Op::OR)
+	DSL_BINARY(^, Program::Op::XOR)
+	DSL_BINARY(==, Program::Op::CEQ)
+	DSL_BINARY(!=, Program::Op::CNE)
+	DSL_BINARY(<, Program::Op::CLT)
+	DSL_BINARY(<=, Program::Op::CLE)
+	DSL_BINARY(>, Program::Op::CGT)
+	DSL_BINARY(>=, Program::Op::CGE)
+#undef DSL_BINARY
+
+#define DSL_UNARY_OPERATOR(op, code) \
+	template<typename A> \
+	inline typename std::enable_if<IsNode<A>::value, UnaryNode<code, A>>::type operator op(const A& a) { return UnaryNode<code, A>(a); }
+
+	DSL_UNARY_OPERATOR(-, Program::Op::NEG)
+	DSL_UNARY_OPERATOR(~, Program::Op::COM)
+	DSL_UNARY_OPERATOR(!, Program::Op::NOT)
+#undef DSL_UNARY_OPERATOR
+
+#define DSL_UNARY_FUNCTION(name, code) \
+	template<typename A> \
+	inline UnaryNode<code, typename ToNode<A>::Type> name(const A& a) { return UnaryNode<code, typename ToNode<A>::Type>(ToNode<A>::Make(a)); }
+
+	DSL_UNARY_FUNCTION(sine, Program::Op::SIN)
+	DSL_UNARY_FUNCTION(square, Program::Op::SQR)
+	DSL_UNARY_FUNCTION(triangle, Program::Op::TRI)
+	DSL_UNARY_FUNCTION(freq, Program::Op::FRQ)
+	DSL_UNARY_FUNCTION(rnd, Program::Op::RND)
+	DSL_UNARY_FUNCTION(cc, Program::Op::CCV)
+	DSL_UNARY_FUNCTION(vc, Program::Op::VCV)
+#undef DSL_UNARY_FUNCTION
+
+#define DSL_TERNARY_FUNCTION(name, code) \
+	template<typename A, typename B, typename C> \
+	inline TernaryNode<code, typename ToNode<A>::Type, typename ToNode<B>::Type, typename ToNode<C>::Type> name(const A& a, const B& b, const C& c) \
+	{ \
+		return TernaryNode<code, typename ToNode<A>::Type, typename ToNode<B>::Type, typename ToNode<C>::Type>(ToNode<A>::Make(a), ToNode<B>::Make(b), ToNode<C>::Make(c)); \
+	}
+
+	DSL_TERNARY_FUNCTION(tap, Program::Op::TAP)
+	DSL_TERNARY_FUNCTION(rec, Program::Op::REC)
+	DSL_TERNARY_FUNCTION(copy, Program::Op::CPY)
+	DSL_TERNARY_FUNCTION(fill, Program::Op::FIL)
+#undef DSL_TERNARY_FUNCTION
+
+	// s must be a variable or @, the same as in the language
+#define DSL_STATE_FUNCTION(name, code) \
+	template<typename S, typename B, typename C> \
+	inline StateNode<code, S, typename ToNode<B>::Type, typename ToNode<C>::Type> name(const S& s, const B& b, const C& c) \
+	{ \
+		return StateNode<code, S, typename ToNode<B>::Type, typename ToNode<C>::Type>(s, ToNode<B>::Make(b), ToNode<C>::Make(c)); \
+	}
+
+	DSL_STATE_FUNCTION(lpf, Program::Op::LPF)
+	DSL_STATE_FUNCTION(hpf, Program::Op::HPF)
+	DSL_STATE_FUNCTION(slew, Program::Op::SLW)
+	DSL_STATE_FUNCTION(env, Program::Op::ENV)
+#undef DSL_STATE_FUNCTION
+
+	template<typename A>
+	inline At<typename ToNode<A>::Type> at(const A& a) { return At<typename ToNode<A>::Type>(ToNode<A>::Make(a)); }
+
+	template<typename A>
+	inline Out<typename ToNode<A>::Type> out(const A& a) { return Out<typename ToNode<A>::Type>(ToNode<A>::Make(a)); }
+
+	// @x = { ... }, where l is a variable or @
+	template<typename L, typename... Es>
+	inline Poke<L, typename ArgList<Es...>::Type> poke(const L& l, const Es&... es)
+	{
+		static_assert(sizeof...(Es) > 0, "poke needs at least one value");
+		return Poke<L, typename ArgList<Es...>::Type>(l, ArgList<Es...>::Make(es...));
+	}
+
+	// [x] = { ... }
+	template<typename A, typename... Es>
+	inline Put<typename ToNode<A>::Type, typename ArgList<Es...>::Type> put(const A& a, const Es&... es)
+	{
+		static_assert(sizeof...(Es) > 0, "put needs at least one value");
+		return Put<typename ToNode<A>::Type, typename ArgList<Es...>::Type>(ToNode<A>::Make(a), ArgList<Es...>::Make(es...));
+	}
+
+	template<typename A, typename B, typename C>
+	inline When<typename ToNode<A>::Type, typename ToNode<B>::Type, typename ToNode<C>::Type> when(const A& a, const B& b, const C& c)
+	{
+		return When<typename ToNode<A>::Type, typename ToNode<B>::Type, typename ToNode<C>::Type>(ToNode<A>::Make(a), ToNode<B>::Make(b), ToNode<C>::Make(c));
+	}
+
+	template<typename A, typename B>
+	inline When<typename ToNode<A>::Type, typename ToNode<B>::Type, Const> when(const A& a, const B& b)
+	{
+		return When<typename ToNode<A>::Type, typename ToNode<B>::Type, Const>(ToNode<A>::Make(a), ToNode<B>::Make(b), Const(0));
+	}
+
+	template<typename N, typename... Ss>
+	inline Every<typename ToNode<N>::Type, typename ArgList<Ss...>::Type> every(const N& n, const Ss&... ss)
+	{
+		return Every<typename ToNode<N>::Type, typename ArgList<Ss...>::Type>(ToNode<N>::Make(n), ArgList<Ss...>::Make(ss...));
+	}
+
+	template<typename... Ss>
+	inline Block<typename ArgList<Ss...>::Type> program(const Ss&... ss)
+	{
+		return Block<typename ArgList<Ss...>::Type>(ArgList<Ss...>::Make(ss...));
+	}
+#pragma endregion
+
+	// a Program that runs an expression instead of interpreting instructions.
+	// it has no instructions, so there is nothing for the disassembler or the cost analysis to show.
+	template<typename E>
+	class NativeProgram : public Program
+	{
+	public:
+		NativeProgram(const E& expression, const size_t userMemorySize)
+			: Program(std::vector<Op>(), userMemorySize, VW_64)
+			, body(expression)
+		{
+			mem = new Value[memSize];
+			memset(mem, 0, sizeof(Value)*memSize);
+			// default sample rate so the F operator will function
+			Set('~', 44100);
+		}
+
+		~NativeProgram()
+		{
+			delete[] mem;
+		}
+
+		RuntimeError Run(Value* results, const size_t size) override
+		{
+			++runCount;
+			runError = RE_NONE;
+			pc = 0;
+			Context context = { mem, memSize, userMemSize, cc, vc, rng, results, size, RE_NONE };
+			body(context);
+			if (context.error != RE_NONE)
+			{
+				Fault(context.error);
+			}
+			return runError;
+		}
+
+		size_t GetFootprint() const override { return sizeof(NativeProgram) + memSize * sizeof(Value); }
+		Value Peek(const Value address) const override { return mem[address%memSize]; }
+		void  Poke(const Value address, const Value value) override { mem[address%memSize] = value; }
+		void  GetMemory(Value* outValues) const override { memcpy(outValues, mem, sizeof(Value)*memSize); }
+		void  SetMemory(const Value* values) override { memcpy(mem, values, sizeof(Value)*memSize); }
+
+	private:
+		const E body;
+		Value* mem;
+	};
+
+	// the equivalent of Program::Compile, which can't fail because the C++ compiler has already checked the program
+	template<typename E>
+	inline Program* Compile(const E& expression, const size_t userMemorySize)
+	{
+		static_assert(IsNode<E>::value, "only expressions can be compiled");
+		return new NativeProgram<E>(expression, userMemorySize);
+	}
+}
@@ -0,0 +1,235 @@
+//
+//  ProgramGraph.cpp
+//  Evaluator
+//
+//  Runs several programs routed into each other, on the ThreadPool when they don't depend on each other.
+//
+
+#include "ProgramGraph.h"
+#include <algorithm>
+#include <math.h>
+
+ProgramGraph::ProgramGraph(const size_t maxFrames, const bool parallel)
+	: maxFrames(maxFrames)
+	, scheduling(kSchedulingImmediate)
+	, output(0)
+	, prepared(false)
+	, blockInputs(nullptr)
+	, blockFrames(0)
+	, current(0)
+	, stage(nullptr)
+	, pool(parallel ? new ThreadPool::Client() : nullptr)
+{
+	blockClock.tick = 0;
+	blockClock.mdenom = 1;
+	blockClock.qdenom = 1;
+}
+
+ProgramGraph::~ProgramGraph()
+{
+	delete pool;
+
+	for (Node& node : nodes)
+	{
+		delete node.program;
+	}
+}
+
+int ProgramGraph::AddNode(Program* program)
+{
+	Node node;
+	node.program = program;
+	for (int b = 0; b < 2; ++b)
+	{
+		for (size_t c = 0; c < kChannelCount; ++c)
+		{
+			node.outputs[b][c].assign(maxFrames, 0);
+		}
+	}
+	nodes.push_back(node);
+	prepared = false;
+	return (int)nodes.size() - 1;
+}
+
+bool ProgramGraph::Connect(const int from, const size_t fromChannel, const int to, const size_t toChannel)
+{
+	if (from < kGraphInput || from >= GetNodeCount() || to < 0 || to >= GetNodeCount() || fromChannel >= kChannelCount || toChannel >= kChannelCount)
+	{
+		return false;
+	}
+
+	const Route route = { from, fromChannel };
+	nodes[to].routes[toChannel].push_back(route);
+	prepared = false;
+	return true;
+}
+
+bool ProgramGraph::SetOutput(const int node)
+{
+	if (node < 0 || node >= GetNodeCount())
+	{
+		return false;
+	}
+
+	output = node;
+	return true;
+}
+
+bool ProgramGraph::Prepare(const Scheduling inScheduling)
+{
+	scheduling = inScheduling;
+	stages.clear();
+	prepared = false;
+
+	if (scheduling == kSchedulingPipelined)
+	{
+		std::vector<int> stage;
+		for (int n = 0; n < GetNodeCount(); ++n)
+		{
+			stage.push_back(n);
+		}
+		stages.push_back(stage);
+		prepared = true;
+		return true;
+	}
+
+	// each node goes in the stage after the last of the nodes it depends on.
+	// a node's stage is only known once all of those are, and nodes that never get one are in a cycle.
+	std::vector<int> stageOf(nodes.size(), -1);
+	size_t placed = 0;
+	for (bool progress = true; progress;)
+	{
+		progress = false;
+		for (int n = 0; n < GetNodeCount(); ++n)
+		{
+			if (stageOf[n] >= 0) continue;
+
+			int stage = 0;
+			bool ready = true;
+			for (size_t c = 0; c < kChannelCount && ready; ++c)
+			{
+				for (const Route& route : nodes[n].routes[c])
+				{
+					if (route.node == kGraphInput) continue;
+					if (stageOf[route.node] < 0) { ready = false; break; }
+					stage = std::max(stage, stageOf[route.node] + 1);
+				}
+			}
+
+			if (ready)
+			{
+				stageOf[n] = stage;
+				if ((size_t)stage >= stages.size()) stages.resize(stage + 1);
+				stages[stage].push_back(n);
+				++placed;
+				progress = true;
+			}
+		}
+	}
+
+	if (placed < nodes.size())
+	{
+		stages.clear();
+		return false;
+	}
+
+	prepared = true;
+	return true;
+}
+
+void ProgramGraph::Set(const Program::Char var, const Value value)
+{
+	for (Node& node : nodes)
+	{
+		node.program->Set(var, value);
+	}
+}
+
+void ProgramGraph::SetCC(const Value idx, const Value value)
+{
+	for (Node& node : nodes)
+	{
+		node.program->SetCC(idx, value);
+	}
+}
+
+void ProgramGraph::Render(const Value* const* inputs, const size_t frameCount, const Clock& clock)
+{
+	if (!prepared)
+	{
+		return;
+	}
+
+	blockInputs = inputs;
+	blockFrames = std::min(frameCount, maxFrames);
+	blockClock = clock;
+	if (scheduling == kSchedulingPipelined)
+	{
+		current = 1 - current;
+	}
+
+	for (const std::vector<int>& nodesInStage : stages)
+	{
+		stage = &nodesInStage;
+		if (pool != nullptr)
+		{
+			pool->Parallel(nodesInStage.size(), &ProgramGraph::RenderStageNode, this);
+		}
+		else
+		{
+			for (const int n : nodesInStage)
+			{
+				RenderNode(n);
+			}
+		}
+	}
+}
+
+const ProgramGraph::Value* ProgramGraph::GetOutput(const size_t channel) const
+{
+	return nodes.empty() ? nullptr : nodes[output].outputs[current][channel % kChannelCount].data();
+}
+
+void ProgramGraph::RenderNode(const int n)
+{
+	Node& node = nodes[n];
+	Program& program = *node.program;
+	const int read = scheduling == kSchedulingPipelined ? 1 - current : current;
+	Value* outputs[kChannelCount];
+	for (size_t c = 0; c < kChannelCount; ++c)
+	{
+		outputs[c] = node.outputs[current][c].data();
+	}
+
+	Value results[kChannelCount];
+	for (size_t f = 0; f < blockFrames; ++f)
+	{
+		const Value tick = blockClock.tick + f;
+		program.Set('t', tick);
+		program.Set('m', (Value)round(tick / blockClock.mdenom));
+		program.Set('q', (Value)round(tick / blockClock.qdenom));
+
+		for (size_t c = 0; c < kChannelCount; ++c)
+		{
+			Value input = 0;
+			for (const Route& route : node.routes[c])
+			{
+				input += route.node == kGraphInput ? blockInputs[route.channel][f] : nodes[route.node].outputs[read][route.channel][f];
+			}
+			results[c] = input;
+		}
+
+		program.Run(results, kChannelCount);
+
+		for (size_t c = 0; c < kChannelCount; ++c)
+		{
+			outputs[c][f] = results[c];
+		}
+	}
+}
+
+void ProgramGraph::RenderStageNode(void* graph, size_t index)
+{
+	ProgramGraph* self = static_cast<ProgramGraph*>(graph);
+	self->RenderNode((*self->stage)[index]);
+}
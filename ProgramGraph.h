@@ -0,0 +1,122 @@
+//
+//  ProgramGraph.h
+//  Evaluator
+//
+//  Several programs running together as one, with the outputs of some of them routed to the [0] and [1] inputs
+//  of others, so that a patch doesn't need a chain of plugin instances. Render runs a block of every node,
+//  with nodes that don't depend on each other running at the same time on the ThreadPool. Nodes read the
+//  outputs of the nodes they depend on straight out of those nodes' buffers, nothing is copied between them.
+//
+//  This is part of the engine, not the plugin. Evaluator runs a single program per instance and doesn't build
+//  this file, the same as GeneratedProgram and ProgramDSL.h. It's for code that embeds Program directly,
+//  eg expression_test, and patching programs together in the plugin is still done with a chain of instances.
+//
+
+#pragma once
+
+#include "Program.h"
+#include "ThreadPool.h"
+#include <vector>
+
+class ProgramGraph
+{
+public:
+	typedef Program::Value Value;
+
+	// every node has the same two inputs and two outputs that a program has in the plugin
+	static const size_t kChannelCount = 2;
+	// stands for the inputs of the graph itself in Connect
+	static const int kGraphInput = -1;
+
+	enum Scheduling
+	{
+		// nodes see what the nodes they depend on rendered in the same block.
+		// the graph runs in stages, the nodes of each stage at the same time, and routes can't make a cycle.
+		kSchedulingImmediate,
+		// nodes see what the nodes they depend on rendered in the previous block, so every route is one block late,
+		// but all of the nodes run at the same time and routes can make cycles.
+		kSchedulingPipelined,
+	};
+
+	// the variables that change every frame, which are set the same way the plugin sets them
+	struct Clock
+	{
+		Value tick; // t for the first frame of the block
+		double mdenom; // frames per millisecond, for m
+		double qdenom; // frames per 128th note, for q
+	};
+
+	// blocks can be up to maxFrames long. when parallel is true the ThreadPool helps the thread that calls Render,
+	// otherwise every node runs on that thread.
+	ProgramGraph(const size_t maxFrames, const bool parallel);
+	~ProgramGraph();
+
+	// the graph takes ownership of program. returns the number of the new node, for Connect and SetOutput.
+	int AddNode(Program* program);
+	int GetNodeCount() const { return (int)nodes.size(); }
+	Program* GetNode(const int node) const { return nodes[node].program; }
+
+	// send an output of one node, or one of the inputs of the graph, to an input of another node.
+	// an input with more than one route gets the sum of them, and an input without any gets 0.
+	bool Connect(const int from, const size_t fromChannel, const int to, const size_t toChannel);
+	// the node whose outputs are the outputs of the graph, which is the first one until this is called
+	bool SetOutput(const int node);
+
+	// work out which nodes can run at the same time. this has to be called after changing the nodes or the routes
+	// and before rendering. fails when the routes make a cycle and scheduling is kSchedulingImmediate.
+	bool Prepare(const Scheduling scheduling);
+	// how many stages run one after the other in each block
+	size_t GetStageCount() const { return stages.size(); }
+
+	// set a variable or a control change in every node, eg n when a note starts
+	void Set(const Program::Char var, const Value value);
+	void SetCC(const Value idx, const Value value);
+
+	// run every node for frameCount frames. inputs has kChannelCount arrays of frameCount values,
+	// which is what a program would find in [0] and [1] before running in the plugin.
+	// this doesn't allocate or lock, so it can be called on the audio thread.
+	void Render(const Value* const* inputs, const size_t frameCount, const Clock& clock);
+
+	// the outputs of the output node in the last block, which stay valid until the next call to Render
+	const Value* GetOutput(const size_t channel) const;
+
+private:
+	struct Route
+	{
+		int node;
+		size_t channel;
+	};
+
+	struct Node
+	{
+		Program* program;
+		// pipelined scheduling writes one of these while the other is read
+		std::vector<Value> outputs[2][kChannelCount];
+		std::vector<Route> routes[kChannelCount];
+	};
+
+	ProgramGraph(const ProgramGraph&);
+	ProgramGraph& operator=(const ProgramGraph&);
+
+	void RenderNode(const int node);
+	// called by ThreadPool::Client::Parallel for each node of the stage being rendered
+	static void RenderStageNode(void* graph, size_t index);
+
+	const size_t maxFrames;
+	std::vector<Node> nodes;
+	std::vector<std::vector<int>> stages;
+	Scheduling scheduling;
+	int output;
+	bool prepared;
+
+	// the block being rendered
+	const Value* const* blockInputs;
+	size_t blockFrames;
+	Clock blockClock;
+	// which of the two outputs of each node is written in this block
+	int current;
+	const std::vector<int>* stage;
+
+	// null when every node runs on the thread that calls Render
+	ThreadPool::Client* pool;
+};
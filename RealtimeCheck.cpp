@@ -0,0 +1,298 @@
+//
+//  RealtimeCheck.cpp
+//  Evaluator
+//
+//  Reports allocation and locking on the audio thread when built with EVALUATOR_REALTIME_CHECK=1.
+//
+
+#include "RealtimeCheck.h"
+
+#if EVALUATOR_REALTIME_CHECK
+
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <dlfcn.h>
+#include <pthread.h>
+#endif
+
+namespace RealtimeCheck
+{
+	static std::atomic<unsigned int> gViolationCount(0);
+	static std::atomic<bool> gAbortOnViolation(false);
+	// how many Scopes the thread is inside of
+	static thread_local int tScopeDepth = 0;
+	// set while reporting, because printing a stack trace can allocate
+	static thread_local bool tReporting = false;
+
+	Scope::Scope() { ++tScopeDepth; }
+	Scope::~Scope() { --tScopeDepth; }
+
+	// write without going through stdio, which can allocate or lock
+	static void Print(const char* text)
+	{
+#if defined(_WIN32)
+		OutputDebugStringA(text);
+		fputs(text, stderr);
+#else
+		const ssize_t written = write(2, text, strlen(text));
+		(void)written;
+#endif
+	}
+
+	static void PrintStackTrace()
+	{
+		void* frames[64];
+#if defined(_WIN32)
+		const int count = CaptureStackBackTrace(2, 64, frames, nullptr);
+		char line[32];
+		for (int i = 0; i < count; ++i)
+		{
+			snprintf(line, sizeof(line), "  %p\n", frames[i]);
+			Print(line);
+		}
+#else
+		const int count = backtrace(frames, 64);
+		backtrace_symbols_fd(frames + 2, count > 2 ? count - 2 : 0, 2);
+#endif
+	}
+
+	static void Report(const char* what)
+	{
+		if (tScopeDepth == 0 || tReporting)
+		{
+			return;
+		}
+
+		tReporting = true;
+		++gViolationCount;
+		Print("realtime violation: ");
+		Print(what);
+		Print(" on the audio thread\n");
+		PrintStackTrace();
+		tReporting = false;
+
+		if (gAbortOnViolation)
+		{
+			abort();
+		}
+	}
+
+	void ReportLock(const char* what)
+	{
+		Report(what);
+	}
+
+	unsigned int GetViolationCount()
+	{
+		return gViolationCount;
+	}
+
+	void SetAbortOnViolation(bool abortOnViolation)
+	{
+		gAbortOnViolation = abortOnViolation;
+	}
+
+#if defined(__linux__)
+	typedef void* (*MallocFunction)(size_t);
+	typedef void* (*CallocFunction)(size_t, size_t);
+	typedef void* (*ReallocFunction)(void*, size_t);
+	typedef void (*FreeFunction)(void*);
+
+	// the allocator that the interposers below forward to
+	static MallocFunction gMalloc = nullptr;
+	static CallocFunction gCalloc = nullptr;
+	static ReallocFunction gRealloc = nullptr;
+	static FreeFunction gFree = nullptr;
+
+	// dlsym can allocate while it looks them up, so those allocations come from here and are never freed.
+	// the first allocation happens while the process is starting and only has one thread, so this doesn't need a lock.
+	alignas(16) static char gBootstrap[4096];
+	static size_t gBootstrapUsed = 0;
+	static bool gResolving = false;
+
+	static bool IsBootstrap(const void* memory)
+	{
+		return memory >= gBootstrap && memory < gBootstrap + sizeof(gBootstrap);
+	}
+
+	static void* AllocateBootstrap(size_t size)
+	{
+		size = (size + 15) & ~(size_t)15;
+		if (gBootstrapUsed + size > sizeof(gBootstrap))
+		{
+			return nullptr;
+		}
+		void* memory = gBootstrap + gBootstrapUsed;
+		gBootstrapUsed += size;
+		return memory;
+	}
+
+	// returns false while the real functions are being looked up
+	static bool Resolve()
+	{
+		if (gFree != nullptr)
+		{
+			return true;
+		}
+		if (gResolving)
+		{
+			return false;
+		}
+
+		gResolving = true;
+		gMalloc = (MallocFunction)dlsym(RTLD_NEXT, "malloc");
+		gCalloc = (CallocFunction)dlsym(RTLD_NEXT, "calloc");
+		gRealloc = (ReallocFunction)dlsym(RTLD_NEXT, "realloc");
+		gFree = (FreeFunction)dlsym(RTLD_NEXT, "free");
+		gResolving = false;
+		return true;
+	}
+#endif
+
+	// allocate and free without going through the interposers, so new and delete are only reported once
+	static void* Allocate(const char* what, size_t size)
+	{
+		Report(what);
+#if defined(__linux__)
+		return Resolve() ? gMalloc(size) : AllocateBootstrap(size);
+#else
+		return malloc(size);
+#endif
+	}
+
+	static void Free(const char* what, void* memory)
+	{
+		if (memory == nullptr)
+		{
+			return;
+		}
+
+		Report(what);
+#if defined(__linux__)
+		if (!IsBootstrap(memory) && Resolve())
+		{
+			gFree(memory);
+		}
+#else
+		free(memory);
+#endif
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	void* memory = RealtimeCheck::Allocate("operator new", size > 0 ? size : 1);
+	if (memory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return RealtimeCheck::Allocate("operator new", size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& nothrow) noexcept
+{
+	return operator new(size, nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+	RealtimeCheck::Free("operator delete", memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+#if defined(__linux__)
+// C code and the C++ runtime allocate with these directly, eg strdup, fopen, and the exceptions thrown by std::thread
+extern "C" void* malloc(size_t size)
+{
+	return RealtimeCheck::Allocate("malloc", size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+	using namespace RealtimeCheck;
+	if (!Resolve())
+	{
+		// the bootstrap buffer is zeros until it's used, and nothing in it is ever reused
+		return size == 0 || count <= sizeof(gBootstrap) / size ? AllocateBootstrap(count * size) : nullptr;
+	}
+	Report("calloc");
+	return gCalloc(count, size);
+}
+
+extern "C" void* realloc(void* memory, size_t size)
+{
+	using namespace RealtimeCheck;
+	Report("realloc");
+	if (IsBootstrap(memory))
+	{
+		// the size of the old allocation isn't known, but it can't go past the end of the buffer
+		void* moved = Resolve() ? gMalloc(size) : AllocateBootstrap(size);
+		if (moved != nullptr)
+		{
+			const size_t available = (size_t)(gBootstrap + sizeof(gBootstrap) - (char*)memory);
+			memmove(moved, memory, size < available ? size : available);
+		}
+		return moved;
+	}
+	return Resolve() ? gRealloc(memory, size) : AllocateBootstrap(size);
+}
+
+extern "C" void free(void* memory)
+{
+	RealtimeCheck::Free("free", memory);
+}
+
+// std::mutex, WDL_Mutex, and everything else that locks on Linux ends up here
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+	typedef int (*LockFunction)(pthread_mutex_t*);
+	static std::atomic<LockFunction> sLock(nullptr);
+	LockFunction lock = sLock.load(std::memory_order_relaxed);
+	if (lock == nullptr)
+	{
+		lock = (LockFunction)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+		sLock.store(lock, std::memory_order_relaxed);
+	}
+
+	RealtimeCheck::Report("pthread_mutex_lock");
+	return lock(mutex);
+}
+#endif
+
+#endif // EVALUATOR_REALTIME_CHECK
@@ -0,0 +1,50 @@
+//
+//  RealtimeCheck.h
+//  Evaluator
+//
+//  Debug instrumentation that reports memory allocation and lock acquisition on the audio thread,
+//  both of which can block for an unbounded amount of time and cause dropouts.
+//
+//  Build with EVALUATOR_REALTIME_CHECK=1 to enable it. operator new and delete are then replaced,
+//  and on Linux so are malloc, calloc, realloc, free, and pthread_mutex_lock, and each one that happens
+//  inside a RealtimeCheck::Scope is reported on stderr with a stack trace. On Windows and macOS the C allocator
+//  can't be replaced this way, so only allocations that go through new and delete are seen there.
+//  Without the flag everything here compiles to nothing.
+//
+
+#pragma once
+
+#ifndef EVALUATOR_REALTIME_CHECK
+#define EVALUATOR_REALTIME_CHECK 0
+#endif
+
+namespace RealtimeCheck
+{
+#if EVALUATOR_REALTIME_CHECK
+	// the calling thread must not allocate or lock while one of these is in scope, eg during ProcessDoubleReplacing.
+	class Scope
+	{
+	public:
+		Scope();
+		~Scope();
+	};
+
+	// report a lock that the interposers can't see, eg one taken with a platform API on Windows or macOS
+	void ReportLock(const char* what);
+
+	// how many allocations and locks have been reported since the process started
+	unsigned int GetViolationCount();
+	// abort as soon as something is reported, so a debugger stops right there
+	void SetAbortOnViolation(bool abortOnViolation);
+#else
+	class Scope
+	{
+	public:
+		Scope() {}
+	};
+
+	inline void ReportLock(const char*) {}
+	inline unsigned int GetViolationCount() { return 0; }
+	inline void SetAbortOnViolation(bool) {}
+#endif
+}
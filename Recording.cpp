@@ -0,0 +1,243 @@
+//
+//  Recording.cpp
+//  Evaluator
+//
+//  Binary log of everything that affects the output of the plugin.
+//
+
+#include "Recording.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+namespace Recording
+{
+	uint64_t HashOutput(const double* left, const double* right, int frameCount)
+	{
+		// FNV-1a over the bytes of both channels
+		uint64_t hash = 14695981039346656037ULL;
+		const double* channels[2] = { left, right };
+		for (int c = 0; c < 2; ++c)
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(channels[c]);
+			const size_t size = sizeof(double) * frameCount;
+			for (size_t i = 0; i < size; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+		}
+		return hash;
+	}
+
+	Recorder::Recorder()
+		: mSize(0)
+		, mRecording(false)
+		, mFull(false)
+	{
+	}
+
+	void Recorder::Start(std::vector<uint8_t>& buffer)
+	{
+		mBuffer.swap(buffer);
+		std::fill(mBus, mBus + MemoryBus::kSize, 0);
+		mSize = 0;
+		mFull = false;
+		mRecording = true;
+		Append(kMagic);
+		Append(kVersion);
+	}
+
+	void Recorder::Stop()
+	{
+		mRecording = false;
+		mFull = false;
+	}
+
+	bool Recorder::Reserve(size_t size)
+	{
+		if (!mRecording)
+		{
+			return false;
+		}
+
+		if (mSize + size > mBuffer.size())
+		{
+			mRecording = false;
+			mFull = true;
+			return false;
+		}
+
+		return true;
+	}
+
+	void Recorder::Append(const void* data, size_t size)
+	{
+		memcpy(&mBuffer[mSize], data, size);
+		mSize += size;
+	}
+
+	void Recorder::RecordProgram(const char* text, int memorySize, uint64_t seed)
+	{
+		const uint32_t length = (uint32_t)strlen(text);
+		if (Reserve(sizeof(RecordType) + sizeof(int32_t) + sizeof(uint64_t) + sizeof(uint32_t) + length))
+		{
+			Append(kRecordProgram);
+			Append((int32_t)memorySize);
+			Append(seed);
+			Append(length);
+			Append(text, length);
+		}
+	}
+
+	void Recorder::RecordParam(int paramIdx, double value)
+	{
+		if (Reserve(sizeof(RecordType) + sizeof(int32_t) + sizeof(double)))
+		{
+			Append(kRecordParam);
+			Append((int32_t)paramIdx);
+			Append(value);
+		}
+	}
+
+	void Recorder::RecordState(Program::Value tick, uint64_t seed, const Program& program, const std::vector<uint8_t>& notes)
+	{
+		const uint32_t memorySize = (uint32_t)program.GetMemorySize();
+		const uint32_t noteCount = (uint32_t)(notes.size() / 2);
+		const size_t size = sizeof(RecordType) + sizeof(Program::Value) + sizeof(uint64_t)
+			+ sizeof(uint32_t) + sizeof(Program::Value) * memorySize
+			+ sizeof(Program::Value) * Program::kCCSize
+			+ sizeof(uint32_t) + noteCount * 2;
+		if (Reserve(size))
+		{
+			Append(kRecordState);
+			Append(tick);
+			Append(seed);
+			Append(memorySize);
+			for (uint32_t i = 0; i < memorySize; ++i)
+			{
+				Append(program.Peek(i));
+			}
+			for (size_t i = 0; i < Program::kCCSize; ++i)
+			{
+				Append(program.GetCC(i));
+			}
+			Append(noteCount);
+			Append(notes.data(), noteCount * 2);
+		}
+	}
+
+	void Recorder::RecordBlock(const BlockInfo& info, const double* inLeft, const double* inRight)
+	{
+		BlockInfo block = info;
+		block.hasInput = 0;
+		for (int i = 0; i < info.frameCount && !block.hasInput; ++i)
+		{
+			block.hasInput = inLeft[i] != 0 || inRight[i] != 0;
+		}
+
+		const size_t inputSize = block.hasInput ? sizeof(double) * info.frameCount : 0;
+		if (Reserve(sizeof(RecordType) + sizeof(BlockInfo) + inputSize * 2))
+		{
+			Append(kRecordBlock);
+			Append(block);
+			if (block.hasInput)
+			{
+				Append(inLeft, inputSize);
+				Append(inRight, inputSize);
+			}
+		}
+	}
+
+	void Recorder::RecordMidi(const MidiEvent& event)
+	{
+		if (Reserve(sizeof(RecordType) + sizeof(MidiEvent)))
+		{
+			Append(kRecordMidi);
+			Append(event);
+		}
+	}
+
+	void Recorder::RecordOutput(const double* left, const double* right, int frameCount)
+	{
+		if (Reserve(sizeof(RecordType) + sizeof(uint64_t)))
+		{
+			Append(kRecordOutput);
+			Append(HashOutput(left, right, frameCount));
+		}
+	}
+
+	void Recorder::RecordBus(const Program::Value* values, size_t count)
+	{
+		count = std::min(count, MemoryBus::kSize);
+		uint32_t changed = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			changed += values[i] != mBus[i];
+		}
+
+		if (Reserve(sizeof(RecordType) + sizeof(uint32_t) + changed * (sizeof(uint32_t) + sizeof(Program::Value))))
+		{
+			Append(kRecordBus);
+			Append(changed);
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (values[i] != mBus[i])
+				{
+					Append((uint32_t)i);
+					Append(values[i]);
+					mBus[i] = values[i];
+				}
+			}
+		}
+	}
+
+	bool Recorder::Write(const char* path) const
+	{
+		FILE* file = fopen(path, "wb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+
+		const bool success = fwrite(mBuffer.data(), 1, mSize, file) == mSize;
+		return fclose(file) == 0 && success;
+	}
+
+	bool Reader::Open(const char* path)
+	{
+		mData.clear();
+		mPosition = 0;
+
+		FILE* file = fopen(path, "rb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+
+		uint8_t chunk[4096];
+		size_t count;
+		while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		{
+			mData.insert(mData.end(), chunk, chunk + count);
+		}
+		fclose(file);
+
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		return Read(magic) && Read(version) && magic == kMagic && version >= 1 && version <= kVersion;
+	}
+
+	bool Reader::Read(void* data, size_t size)
+	{
+		if (mPosition + size > mData.size())
+		{
+			mPosition = mData.size();
+			return false;
+		}
+
+		memcpy(data, &mData[mPosition], size);
+		mPosition += size;
+		return true;
+	}
+}
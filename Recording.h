@@ -0,0 +1,133 @@
+//
+//  Recording.h
+//  Evaluator
+//
+//  Optional recording of everything that affects the output of the plugin: the program, parameter changes,
+//  MIDI, the transport, the size and timing of every block, and what other instances put on the MemoryBus. The replay tool feeds a recording back
+//  through Program headlessly to reproduce a session exactly or to benchmark a real-world workload.
+//
+//  A recording is a header (kMagic, kVersion) followed by records that each begin with a RecordType.
+//  Values are written in the byte order of the machine that made the recording.
+//
+
+#pragma once
+
+#include "MemoryBus.h"
+#include "Program.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace Recording
+{
+	static const uint32_t kMagic = 0x43525645; // "EVRC"
+	// version 2 added kRecordBus. older recordings can still be read, they just don't have any.
+	static const uint32_t kVersion = 2;
+
+	enum RecordType : uint8_t
+	{
+		// int32 memory size, uint64 random seed, uint32 length, program text (not null-terminated)
+		kRecordProgram = 1,
+		// int32 paramIdx, double value. paramIdx is either an EParams value or kTransportState.
+		kRecordParam,
+		// everything the program remembers between samples, so a recording can start in the middle of a session:
+		// uint64 tick, uint64 random seed, uint32 memory size, the memory, the CC values,
+		// uint32 note count, and note number / velocity pairs for the held notes.
+		kRecordState,
+		// BlockInfo, followed by frameCount doubles for each input channel when hasInput is set
+		kRecordBlock,
+		// MidiEvent handled during the preceding block
+		kRecordMidi,
+		// uint64 hash of the output of the preceding block, see HashOutput
+		kRecordOutput,
+		// the MemoryBus values copied into the program at the start of the preceding block, when shared memory is on.
+		// uint32 count, and count pairs of uint32 index and uint64 value, for the values that changed since the last one
+		// of these. the values start out as zeros when recording starts.
+		kRecordBus,
+	};
+
+	struct BlockInfo
+	{
+		int32_t frameCount;
+		uint8_t hasInput; // inputs are only stored when they aren't silent
+		uint8_t transportIsRunning;
+		double  sampleRate;
+		double  tempo;
+		double  samplePos;
+	};
+
+	struct MidiEvent
+	{
+		int32_t offset; // sample in the block where the message was handled
+		uint8_t status;
+		uint8_t data1;
+		uint8_t data2;
+	};
+
+	// used to check that a replay produced exactly the same output as the recording
+	uint64_t HashOutput(const double* left, const double* right, int frameCount);
+
+	// writes records into a buffer that is allocated when recording starts,
+	// so that recording from the audio thread doesn't allocate or touch the file system.
+	class Recorder
+	{
+	public:
+		Recorder();
+
+		// records into buffer, which has to be allocated already and sets the capacity, and hands back the buffer
+		// of the last recording in its place. this way the caller can allocate and free the buffers outside of
+		// whatever lock guards the recorder. starting discards whatever was recorded before.
+		void Start(std::vector<uint8_t>& buffer);
+		// what was recorded is kept until the next Start so that it can still be written
+		void Stop();
+		bool IsRecording() const { return mRecording; }
+		// true if recording stopped because the buffer filled up
+		bool IsFull() const { return mFull; }
+		size_t GetSize() const { return mSize; }
+		size_t GetCapacity() const { return mBuffer.size(); }
+
+		// records are dropped when they don't fit, which also stops the recording,
+		// so a recording always ends with a complete record.
+		void RecordProgram(const char* text, int memorySize, uint64_t seed);
+		void RecordParam(int paramIdx, double value);
+		void RecordState(Program::Value tick, uint64_t seed, const Program& program, const std::vector<uint8_t>& notes);
+		void RecordBlock(const BlockInfo& info, const double* inLeft, const double* inRight);
+		void RecordMidi(const MidiEvent& event);
+		void RecordOutput(const double* left, const double* right, int frameCount);
+		void RecordBus(const Program::Value* values, size_t count);
+
+		// write everything recorded since Start, returns false if the file couldn't be written
+		bool Write(const char* path) const;
+
+	private:
+		// returns false and stops recording if size more bytes won't fit
+		bool Reserve(size_t size);
+		void Append(const void* data, size_t size);
+		template<typename T> void Append(const T& value) { Append(&value, sizeof(T)); }
+
+		std::vector<uint8_t> mBuffer;
+		// the bus values as of the last kRecordBus
+		Program::Value mBus[MemoryBus::kSize];
+		size_t mSize;
+		bool mRecording;
+		bool mFull;
+	};
+
+	// reads a recording back, used by the replay tool
+	class Reader
+	{
+	public:
+		// reads the whole file, returns false if it couldn't be read or isn't a recording we understand
+		bool Open(const char* path);
+		bool AtEnd() const { return mPosition >= mData.size(); }
+		// the type of the next record without reading it
+		RecordType Peek() const { return (RecordType)mData[mPosition]; }
+
+		bool Read(void* data, size_t size);
+		template<typename T> bool Read(T& value) { return Read(&value, sizeof(T)); }
+
+	private:
+		std::vector<uint8_t> mData;
+		size_t mPosition;
+	};
+}
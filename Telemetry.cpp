@@ -0,0 +1,156 @@
+//
+//  Telemetry.cpp
+//  Evaluator
+//
+//  Publishes instance counters to POSIX shared memory.
+//
+
+#include "Telemetry.h"
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Telemetry
+{
+#if !defined(_WIN32)
+	Publisher::Publisher()
+		: mSegment(nullptr)
+		, mSlot(nullptr)
+	{
+		const int fd = shm_open(kSegmentName, O_RDWR | O_CREAT, 0644);
+		if (fd < 0)
+		{
+			return;
+		}
+
+		// a freshly created segment is filled with zeros, which means every slot is free.
+		// if another instance already sized it, this doesn't change anything.
+		void* memory = MAP_FAILED;
+		if (ftruncate(fd, sizeof(Segment)) == 0)
+		{
+			memory = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		close(fd);
+
+		if (memory == MAP_FAILED)
+		{
+			return;
+		}
+
+		// the first publisher stamps the version. a segment stamped with another version has a different layout,
+		// so leave it alone rather than writing over whatever is using it.
+		Segment* segment = static_cast<Segment*>(memory);
+		uint32_t version = 0;
+		if (!segment->version.compare_exchange_strong(version, kSegmentVersion) && version != kSegmentVersion)
+		{
+			munmap(memory, sizeof(Segment));
+			return;
+		}
+
+		mSegment = segment;
+
+		// a free slot is best, otherwise take over one whose owner crashed without releasing it,
+		// so that crashed hosts can't use up all of the slots
+		const int32_t pid = (int32_t)getpid();
+		for (int pass = 0; pass < 2 && mSlot == nullptr; ++pass)
+		{
+			for (int i = 0; i < kMaxInstances && mSlot == nullptr; ++i)
+			{
+				int32_t expected = 0;
+				if (pass == 1)
+				{
+					expected = mSegment->slots[i].pid.load();
+					if (expected == 0 || !(kill(expected, 0) != 0 && errno == ESRCH))
+					{
+						continue;
+					}
+				}
+
+				if (mSegment->slots[i].pid.compare_exchange_strong(expected, pid))
+				{
+					mSlot = &mSegment->slots[i];
+					memset(&mSlot->counters, 0, sizeof(Counters));
+				}
+			}
+		}
+	}
+
+	Publisher::~Publisher()
+	{
+		if (mSlot != nullptr)
+		{
+			mSlot->pid.store(0);
+		}
+
+		if (mSegment != nullptr)
+		{
+			munmap(mSegment, sizeof(Segment));
+		}
+	}
+
+	void Publisher::Publish(const Counters& counters)
+	{
+		if (mSlot == nullptr)
+		{
+			return;
+		}
+
+		const uint32_t sequence = mSlot->sequence.load(std::memory_order_relaxed);
+		mSlot->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		mSlot->counters = counters;
+		mSlot->sequence.store(sequence + 2, std::memory_order_release);
+	}
+#else
+	Publisher::Publisher() : mSegment(nullptr), mSlot(nullptr) {}
+	Publisher::~Publisher() {}
+	void Publisher::Publish(const Counters&) {}
+#endif
+
+	uint64_t Hash(const char* text)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for (; *text != 0; ++text)
+		{
+			hash ^= (uint8_t)*text;
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	bool Read(const Slot& slot, Counters& outCounters)
+	{
+		// the owner publishes once per block, so if we fail this many times something is very wrong
+		static const int kMaxAttempts = 100;
+
+		for (int attempt = 0; attempt < kMaxAttempts; ++attempt)
+		{
+			if (slot.pid.load(std::memory_order_relaxed) == 0)
+			{
+				return false;
+			}
+
+			const uint32_t before = slot.sequence.load(std::memory_order_acquire);
+			if (before & 1)
+			{
+				continue;
+			}
+
+			memcpy(&outCounters, &slot.counters, sizeof(Counters));
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (slot.sequence.load(std::memory_order_relaxed) == before)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
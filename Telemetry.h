@@ -0,0 +1,79 @@
+//
+//  Telemetry.h
+//  Evaluator
+//
+//  Every running instance of Evaluator publishes its counters to a slot in a named shared memory segment
+//  so that an external tool (see telemetry_reader) can monitor all of them without touching the UI.
+//  Only supported on platforms with POSIX shared memory, elsewhere Publisher does nothing.
+//
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+namespace Telemetry
+{
+	// the name ends with the version, so hosts built with different versions of Segment never map the same memory.
+	// change both together.
+	static const char* const kSegmentName = "/evaluator-telemetry-2";
+	static const uint32_t kSegmentVersion = 2;
+	static const int kMaxInstances = 256;
+	// the number of Program::RuntimeError values
+	static const int kRuntimeErrorCount = 8;
+
+	struct Counters
+	{
+		uint64_t samplesRendered;
+		uint64_t blocksRendered;
+		// indexed by Program::RuntimeError, counts samples whose run ended with that error
+		uint64_t runtimeErrors[kRuntimeErrorCount];
+		uint64_t lastBlockMicros;
+		uint64_t maxBlockMicros;
+		// average fraction of the real-time budget used, see Evaluator::mLoadAverage
+		double   averageLoad;
+		// hash of the source code of the running program
+		uint64_t programHash;
+		// which engine runs the program, 0 is the reference interpreter (Program::Run)
+		uint32_t optimizationTier;
+		// total of Evaluator::MemoryFootprint
+		uint64_t memoryBytes;
+	};
+
+	struct Slot
+	{
+		// process id of the owner, or 0 if the slot is free
+		std::atomic<int32_t> pid;
+		// seqlock: odd while the owner is writing counters, readers retry until it is even and unchanged
+		std::atomic<uint32_t> sequence;
+		Counters counters;
+	};
+
+	struct Segment
+	{
+		std::atomic<uint32_t> version;
+		Slot slots[kMaxInstances];
+	};
+
+	// owns a slot in the segment for the lifetime of a plugin instance
+	class Publisher
+	{
+	public:
+		// maps the segment and claims a free slot, which requires system calls, so don't do this on the audio thread
+		Publisher();
+		~Publisher();
+
+		// copy counters into the slot. this doesn't make any system calls, so it is safe on the audio thread.
+		void Publish(const Counters& counters);
+
+	private:
+		Segment* mSegment;
+		Slot*	 mSlot;
+	};
+
+	// FNV-1a hash of a null-terminated string, used for Counters::programHash
+	uint64_t Hash(const char* text);
+
+	// copy the counters out of a slot, returns false if the slot is free or the owner kept changing it.
+	bool Read(const Slot& slot, Counters& outCounters);
+}
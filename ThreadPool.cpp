@@ -0,0 +1,296 @@
+//
+//  ThreadPool.cpp
+//  Evaluator
+//
+//  Worker threads shared by every instance in the process.
+//
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// how many times Parallel yields while waiting for workers to finish their items before it starts to nap, and for how long
+static const int kYieldCount = 256;
+static const int kNapMicroseconds = 20;
+
+std::mutex ThreadPool::sMutex;
+ThreadPool* ThreadPool::sPool = nullptr;
+int ThreadPool::sClientCount = 0;
+
+// wait for a count of items that workers are running to come down to zero
+template<typename T>
+static void WaitForWorkers(const std::atomic<T>& count)
+{
+	for (int attempt = 0; count > 0; ++attempt)
+	{
+		if (attempt < kYieldCount)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(kNapMicroseconds));
+		}
+	}
+}
+
+#pragma region Client
+ThreadPool::Client::Client()
+	: mPool(nullptr)
+	, mRunningTasks(0)
+{
+	std::lock_guard<std::mutex> lifetime(sMutex);
+	if (sPool == nullptr)
+	{
+		// the thread calling Parallel is the last core. the pool always has one worker so that background tasks can run.
+		const int cores = (int)std::thread::hardware_concurrency();
+		sPool = new ThreadPool(std::max(1, cores - 1));
+	}
+	++sClientCount;
+	mPool = sPool;
+
+	std::lock_guard<std::mutex> lock(mPool->mMutex);
+	mPool->mClients.push_back(this);
+}
+
+ThreadPool::Client::~Client()
+{
+	// the pool can't stop while this client is counted, so this doesn't need sMutex,
+	// which a running task might need if it creates a client of its own
+	{
+		std::unique_lock<std::mutex> lock(mPool->mMutex);
+		mPool->mPendingTasks -= (int)mTasks.size();
+		mTasks.clear();
+		mPool->mTaskFinished.wait(lock, [this] { return mRunningTasks == 0; });
+		mPool->mClients.erase(std::find(mPool->mClients.begin(), mPool->mClients.end(), this));
+	}
+
+	std::lock_guard<std::mutex> lifetime(sMutex);
+	if (--sClientCount == 0)
+	{
+		delete sPool;
+		sPool = nullptr;
+	}
+}
+
+void ThreadPool::Client::Parallel(const size_t count, void (*function)(void* context, size_t index), void* context)
+{
+	Job* job = nullptr;
+	if (count > 1)
+	{
+		for (Job& candidate : mPool->mJobs)
+		{
+			bool claimed = false;
+			if (candidate.claimed.compare_exchange_strong(claimed, true))
+			{
+				job = &candidate;
+				break;
+			}
+		}
+	}
+
+	if (job == nullptr)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			function(context, i);
+		}
+		return;
+	}
+
+	job->function = function;
+	job->context = context;
+	job->count = count;
+	job->next = 0;
+	job->remaining = count;
+	const uint64_t number = (job->state.load() >> 1) + 1;
+	job->state = (number << 1) | 1;
+	++mPool->mOpenJobs;
+	++mPool->mJobsOpened;
+	mPool->mWake.notify_all();
+
+	for (size_t i = job->next++; i < count; i = job->next++)
+	{
+		function(context, i);
+		--job->remaining;
+	}
+	WaitForWorkers(job->remaining);
+
+	job->state = number << 1;
+	--mPool->mOpenJobs;
+	WaitForWorkers(job->active);
+	job->claimed = false;
+}
+
+void ThreadPool::Client::Submit(const std::function<void()>& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mPool->mMutex);
+		mTasks.push_back(task);
+		++mPool->mPendingTasks;
+	}
+	mPool->mWake.notify_one();
+}
+#pragma endregion Client
+
+#pragma region ThreadPool
+ThreadPool::ThreadPool(const int workerCount)
+	: mOpenJobs(0)
+	, mJobsOpened(0)
+	, mNextClient(0)
+	, mPendingTasks(0)
+	, mStopping(false)
+{
+	for (Job& job : mJobs)
+	{
+		job.claimed = false;
+		job.state = 0;
+		job.next = 0;
+		job.remaining = 0;
+		job.active = 0;
+		job.count = 0;
+		job.function = nullptr;
+		job.context = nullptr;
+	}
+
+	for (int i = 0; i < workerCount; ++i)
+	{
+		mWorkers.push_back(std::thread(&ThreadPool::Work, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mWake.notify_all();
+	for (std::thread& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+int ThreadPool::RunAudio(const int start)
+{
+	if (mOpenJobs == 0)
+	{
+		return -1;
+	}
+
+	for (int j = 0; j < kMaxJobs; ++j)
+	{
+		const int index = (start + j) % kMaxJobs;
+		Job& job = mJobs[index];
+		const uint64_t state = job.state;
+		if ((state & 1) == 0)
+		{
+			continue;
+		}
+
+		// the job might have closed since it was read, in which case Parallel could already be setting it up again
+		bool ran = false;
+		++job.active;
+		if (job.state == state)
+		{
+			const size_t i = job.next++;
+			if (i < job.count)
+			{
+				job.function(job.context, i);
+				--job.remaining;
+				ran = true;
+			}
+		}
+		--job.active;
+
+		if (ran)
+		{
+			return (index + 1) % kMaxJobs;
+		}
+	}
+
+	return -1;
+}
+
+bool ThreadPool::RunBackground()
+{
+	Client* client = nullptr;
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (size_t c = 0; c < mClients.size() && client == nullptr; ++c)
+		{
+			Client* candidate = mClients[(mNextClient + c) % mClients.size()];
+			if (!candidate->mTasks.empty())
+			{
+				client = candidate;
+				mNextClient = (mNextClient + c + 1) % mClients.size();
+			}
+		}
+
+		if (client == nullptr)
+		{
+			return false;
+		}
+
+		task = client->mTasks.front();
+		client->mTasks.pop_front();
+		--mPendingTasks;
+		++client->mRunningTasks;
+	}
+
+	SetRealtimePriority(false);
+	task();
+	SetRealtimePriority(true);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		--client->mRunningTasks;
+	}
+	mTaskFinished.notify_all();
+	return true;
+}
+
+void ThreadPool::Work()
+{
+	SetRealtimePriority(true);
+
+	int start = 0;
+	while (!mStopping)
+	{
+		const uint64_t opened = mJobsOpened;
+		const int next = RunAudio(start);
+		if (next >= 0)
+		{
+			start = next;
+			continue;
+		}
+
+		if (RunBackground())
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		mWake.wait(lock, [this, opened] { return mStopping || mJobsOpened != opened || mPendingTasks > 0; });
+	}
+}
+
+void ThreadPool::SetRealtimePriority(const bool realtime)
+{
+#if defined(_WIN32)
+	SetThreadPriority(GetCurrentThread(), realtime ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL);
+#else
+	sched_param param;
+	param.sched_priority = realtime ? sched_get_priority_min(SCHED_FIFO) : 0;
+	pthread_setschedparam(pthread_self(), realtime ? SCHED_FIFO : SCHED_OTHER, &param);
+#endif
+}
+#pragma endregion ThreadPool
@@ -0,0 +1,122 @@
+//
+//  ThreadPool.h
+//  Evaluator
+//
+//  Worker threads shared by every instance of Evaluator in the process, so that a session with a hundred instances
+//  doesn't start a hundred times as many threads as there are cores. Instances use it through a Client.
+//  There are two kinds of work: audio work, which is split into items that the calling thread and idle workers
+//  take one at a time, and background tasks. Workers always pick audio work first, and they take
+//  turns between clients for both kinds, so one busy instance can't hold up the others.
+//
+//  Nothing in the plugin uses this yet. ProgramGraph is its only client, and like the graph it is part of the engine
+//  and isn't built into the plugin, so for now it only runs in expression_test.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// the most audio jobs that can run at the same time, Parallel runs any more than this on the calling thread alone
+	static const int kMaxJobs = 64;
+
+	class Client
+	{
+	public:
+		// join the pool, which starts it if this is the first client. starting it starts threads,
+		// so don't do this on the audio thread.
+		Client();
+		// leave the pool after dropping the background tasks of this client that haven't started
+		// and waiting for the ones that have. the pool stops when its last client leaves.
+		~Client();
+
+		// call function(context, index) for every index below count and return when all of the calls have returned.
+		// the calling thread makes calls too, so this finishes even when every worker is busy.
+		// it doesn't allocate or lock, so it can be called on the audio thread. once there is nothing left to take,
+		// it waits for the items that workers are still running: it yields for a while, which is enough when they run
+		// on other cores, and then takes short naps, because under SCHED_FIFO yielding never lets a worker with a lower
+		// priority run on the same core. so it only waits as long as those items take, but it can sleep to do it.
+		void Parallel(const size_t count, void (*function)(void* context, size_t index), void* context);
+
+		// run task on a worker when there isn't any audio work to do. this locks, so don't call it on the audio thread.
+		void Submit(const std::function<void()>& task);
+
+		int GetWorkerCount() const { return (int)mPool->mWorkers.size(); }
+
+	private:
+		friend class ThreadPool;
+
+		Client(const Client&);
+		Client& operator=(const Client&);
+
+		ThreadPool*	mPool;
+		// guarded by the mutex of the pool
+		std::deque<std::function<void()>> mTasks;
+		int			mRunningTasks;
+	};
+
+private:
+	struct Job
+	{
+		// set while a call to Parallel is using this job
+		std::atomic<bool> claimed;
+		// the number of the job shifted left by one, with the low bit set while workers can take items from it.
+		// Parallel closes the job and waits for the workers to leave it before it can be used again,
+		// so a worker can't take an item from a job that is being set up.
+		std::atomic<uint64_t> state;
+		std::atomic<size_t> next;
+		std::atomic<size_t> remaining;
+		std::atomic<int> active;
+		size_t count;
+		void (*function)(void*, size_t);
+		void* context;
+	};
+
+	explicit ThreadPool(const int workerCount);
+	~ThreadPool();
+
+	// take one item from an open job, starting the search at start. returns the job after the one it came from,
+	// so each worker goes round the jobs, or -1 if there wasn't anything to take.
+	int RunAudio(const int start);
+	// take a background task from the next client that has one, returns false if none do
+	bool RunBackground();
+	void Work();
+
+	// the worker threads try to run with real-time priority while they might be doing audio work, and with
+	// normal priority for background tasks. this fails quietly when the process isn't allowed to change it.
+	static void SetRealtimePriority(const bool realtime);
+
+	Job mJobs[kMaxJobs];
+	std::atomic<int> mOpenJobs;
+	// counts every job that Parallel opens. a worker that found nothing to take sleeps until this changes,
+	// rather than while jobs are open, because the last items of an open job can all be taken already.
+	std::atomic<uint64_t> mJobsOpened;
+
+	// guards the clients and their tasks
+	std::mutex mMutex;
+	// workers sleep on this when there is nothing to do. Parallel notifies it without locking, so a worker that was
+	// just going to sleep can miss it, which only means the calling thread does more of that job and the worker
+	// wakes up for the next one. everything else changes what workers wait for while holding mMutex.
+	std::condition_variable mWake;
+	// signalled when a background task finishes, for clients that are leaving
+	std::condition_variable mTaskFinished;
+	std::vector<Client*> mClients;
+	size_t mNextClient;
+	int mPendingTasks;
+	std::atomic<bool> mStopping;
+	std::vector<std::thread> mWorkers;
+
+	// the pool and how many clients it has, guarded by sMutex
+	static std::mutex sMutex;
+	static ThreadPool* sPool;
+	static int sClientCount;
+};
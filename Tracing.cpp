@@ -0,0 +1,223 @@
+//
+//  Tracing.cpp
+//  Evaluator
+//
+//  Optional recording of timestamped events that can be saved in the Chrome trace event format.
+//
+
+#include "Tracing.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+namespace Tracing
+{
+	struct Event
+	{
+		const char* name;
+		uint64_t micros;
+		char phase; // B, E, or i as defined by the trace event format
+	};
+
+	// events recorded by one thread. only the owning thread writes to events and count,
+	// and it publishes each event by incrementing count, so Write can read them without locking.
+	// the events belong to the recording numbered session. Start doesn't touch the buffers, the owning thread
+	// empties its own when it sees that a new recording has started, and until then readers skip it.
+	struct Buffer
+	{
+		static const uint32_t kCapacity = 1 << 16;
+
+		Buffer(int inThreadId) : threadId(inThreadId), threadName(nullptr), session(0), count(0) {}
+
+		const int threadId;
+		std::atomic<const char*> threadName;
+		std::atomic<uint32_t> session;
+		std::atomic<uint32_t> count;
+		Event events[kCapacity];
+	};
+
+	static const int kMaxBuffers = 32;
+	// how many buffers Start keeps ready for threads that haven't recorded anything yet
+	static const int kSpareBuffers = 4;
+
+	static std::atomic<bool> gRecording(false);
+	// the number of the current recording, which Start increments, and when it started in steady_clock ticks
+	static std::atomic<uint32_t> gSession(0);
+	static std::atomic<int64_t> gStartTicks(0);
+	// buffers are only allocated by Start and never deleted, because a thread might still be using one
+	// when another thread calls Write. the first gClaimed of them belong to a thread.
+	static std::atomic<Buffer*> gBuffers[kMaxBuffers];
+	static std::atomic<int> gClaimed(0);
+	// only Start changes this, and it is only used by Start and Write, so recording threads never take it
+	static std::mutex gStartMutex;
+	static int gAllocated = 0;
+	static thread_local Buffer* tBuffer = nullptr;
+
+	static Buffer* GetBuffer()
+	{
+		if (tBuffer == nullptr)
+		{
+			int claimed = gClaimed.load(std::memory_order_acquire);
+			while (claimed < kMaxBuffers && gBuffers[claimed].load(std::memory_order_acquire) != nullptr)
+			{
+				if (gClaimed.compare_exchange_weak(claimed, claimed + 1, std::memory_order_acq_rel))
+				{
+					tBuffer = gBuffers[claimed].load(std::memory_order_acquire);
+					break;
+				}
+			}
+		}
+
+		return tBuffer;
+	}
+
+	static void Record(const char* name, char phase)
+	{
+		if (!gRecording.load(std::memory_order_acquire))
+		{
+			return;
+		}
+
+		Buffer* buffer = GetBuffer();
+		if (buffer == nullptr)
+		{
+			return;
+		}
+
+		// if Start runs while this event is being recorded, it goes into the previous recording, which nobody reads any more
+		const uint32_t session = gSession.load(std::memory_order_acquire);
+		if (buffer->session.load(std::memory_order_relaxed) != session)
+		{
+			buffer->count.store(0, std::memory_order_relaxed);
+			buffer->session.store(session, std::memory_order_release);
+		}
+
+		const uint32_t index = buffer->count.load(std::memory_order_relaxed);
+		// when a buffer fills up we drop events rather than overwrite ones Write might be reading
+		if (index < Buffer::kCapacity)
+		{
+			// the start time can be from a Start that came after loading session, so the difference can be negative
+			const int64_t ticks = std::chrono::steady_clock::now().time_since_epoch().count() - gStartTicks.load(std::memory_order_relaxed);
+			const std::chrono::steady_clock::duration elapsed(std::max(ticks, (int64_t)0));
+			Event& event = buffer->events[index];
+			event.name = name;
+			event.micros = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+			event.phase = phase;
+			buffer->count.store(index + 1, std::memory_order_release);
+		}
+	}
+
+	void Start()
+	{
+		std::lock_guard<std::mutex> lock(gStartMutex);
+		gRecording.store(false);
+		while (gAllocated < kMaxBuffers && gAllocated - gClaimed.load() < kSpareBuffers)
+		{
+			gBuffers[gAllocated].store(new Buffer(gAllocated + 1), std::memory_order_release);
+			++gAllocated;
+		}
+		gStartTicks.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+		gSession.fetch_add(1, std::memory_order_release);
+		gRecording.store(true);
+	}
+
+	void Stop()
+	{
+		gRecording.store(false);
+	}
+
+	bool IsRecording()
+	{
+		return gRecording.load(std::memory_order_relaxed);
+	}
+
+	// how many events a buffer holds for the current recording
+	static uint32_t GetCount(const Buffer& buffer)
+	{
+		const uint32_t session = gSession.load(std::memory_order_acquire);
+		return buffer.session.load(std::memory_order_acquire) == session ? buffer.count.load(std::memory_order_acquire) : 0;
+	}
+
+	unsigned int GetEventCount()
+	{
+		unsigned int total = 0;
+		const int claimed = std::min(gClaimed.load(std::memory_order_acquire), kMaxBuffers);
+		for (int i = 0; i < claimed; ++i)
+		{
+			total += GetCount(*gBuffers[i].load(std::memory_order_acquire));
+		}
+		return total;
+	}
+
+	void Begin(const char* name)
+	{
+		Record(name, 'B');
+	}
+
+	void End(const char* name)
+	{
+		Record(name, 'E');
+	}
+
+	void Instant(const char* name)
+	{
+		Record(name, 'i');
+	}
+
+	void SetThreadName(const char* name)
+	{
+		Buffer* buffer = IsRecording() ? GetBuffer() : nullptr;
+		if (buffer != nullptr)
+		{
+			buffer->threadName.store(name, std::memory_order_relaxed);
+		}
+	}
+
+	bool Write(const char* path)
+	{
+		FILE* file = fopen(path, "w");
+		if (file == nullptr)
+		{
+			return false;
+		}
+
+		// the buffers that threads have taken, which is all that needs the lock.
+		// recording threads only ever add events after the ones counted here, so the file is written without it.
+		std::vector<Buffer*> buffers;
+		{
+			std::lock_guard<std::mutex> lock(gStartMutex);
+			const int claimed = std::min(gClaimed.load(std::memory_order_acquire), kMaxBuffers);
+			for (int i = 0; i < claimed; ++i)
+			{
+				buffers.push_back(gBuffers[i].load(std::memory_order_acquire));
+			}
+		}
+
+		const char* separator = "";
+		fprintf(file, "{\"traceEvents\":[\n");
+		for (Buffer* buffer : buffers)
+		{
+			const char* threadName = buffer->threadName.load(std::memory_order_relaxed);
+			if (threadName != nullptr)
+			{
+				fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", separator, buffer->threadId, threadName);
+				separator = ",\n";
+			}
+
+			const uint32_t count = GetCount(*buffer);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const Event& event = buffer->events[i];
+				fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%d%s}", separator, event.name, event.phase, (unsigned long long)event.micros, buffer->threadId, event.phase == 'i' ? ",\"s\":\"t\"" : "");
+				separator = ",\n";
+			}
+		}
+		fprintf(file, "\n]}\n");
+
+		return fclose(file) == 0;
+	}
+}
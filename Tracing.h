@@ -0,0 +1,47 @@
+//
+//  Tracing.h
+//  Evaluator
+//
+//  Optional recording of timestamped events that can be saved in the Chrome trace event format
+//  and opened with chrome://tracing or ui.perfetto.dev to see how the audio thread, compilation,
+//  and UI updates interact.
+//
+
+#pragma once
+
+namespace Tracing
+{
+	// recording is off by default, in which case recording an event costs one atomic load.
+	// starting a recording discards everything recorded before, and allocates the buffers that threads
+	// recording for the first time will take, so don't call it on the audio thread.
+	void Start();
+	void Stop();
+	bool IsRecording();
+	// how many events have been recorded since Start. this doesn't lock, so it is safe on the audio thread.
+	unsigned int GetEventCount();
+
+	// all names must be string literals (or otherwise live forever) because only the pointer is stored.
+	// each thread records into its own buffer, which it takes from the ones Start allocated, so these never lock
+	// or allocate. a thread that finds none left drops its events until the next Start.
+	void Begin(const char* name);
+	void End(const char* name);
+	// something that happens at a single point in time
+	void Instant(const char* name);
+	// name shown for the calling thread in the trace viewer
+	void SetThreadName(const char* name);
+
+	// write everything recorded since Start, returns false if the file couldn't be written.
+	// events are only read while writing the file, so Start mustn't be called on another thread at the same time.
+	bool Write(const char* path);
+
+	// records Begin when constructed and End when it goes out of scope
+	class Scope
+	{
+	public:
+		Scope(const char* name) : mName(name) { Begin(mName); }
+		~Scope() { End(mName); }
+
+	private:
+		const char* mName;
+	};
+}
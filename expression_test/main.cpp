@@ -8,9 +8,19 @@
 
 #include <iostream>
 #include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <algorithm>
 #include <math.h>
 #include <cassert>
 #include "../Program.h"
+#include "../ProgramDSL.h"
+#include "../ProgramGraph.h"
+#include "../MemoryBus.h"
+#include "../MemoryEncoding.h"
+#include "../ThreadPool.h"
+#include <thread>
 
 // Timer from http://stackoverflow.com/questions/1861294/how-to-calculate-execution-time-of-a-code-snippet-in-c
 class Timer
@@ -112,15 +122,89 @@ Test tests[] = {
     { "[*] = (1 + $(m)%32) ^ (t*128 & t*64 & t*32) | (p/16)<<p%4 | $(p/128)>>p%4", EVAL((1 + $(m)%32) ^ (t*128 & t*64 & t*32) | (p/16)<<p%4 | $(p/128)>>p%4), EEE_NO_ERROR },
     { "[*] = $(t*Fn) | t*n/10>>4 ^ p>>(m/250%12)", EVAL($(t*F(n)) | t*n/10>>4 ^ p>>(m/250%12)), EEE_NO_ERROR },
     { "[*] = (t*128 | t*17>>2) | ((t-4500)*64 | (t-4500)*5>>3) | p<<12", EVAL((t*128 | t*17>>2) | ((t-4500)*64 | (t-4500)*5>>3) | p<<12), EEE_NO_ERROR },
+    { "every 4 { a = t } [*] = a", EVAL(t - t%4), EEE_NO_ERROR },
+    { "every 16 { c = c + 1; }; [*] = c", EVAL(t/16 + 1), EEE_NO_ERROR },
+    { "every 2*2 { every 8 { b = t; } a = t; } [*] = a + b", EVAL((t - t%4) + (t - t%8)), EEE_NO_ERROR },
+    { "a = 0; repeat 4 (i) { a = a + i*t } [*] = a", EVAL(6*t), EEE_NO_ERROR },
+    { "repeat 3 { b = b + 1; } [*] = b", EVAL(3*(t+1)), EEE_NO_ERROR },
+    { "a = 0; repeat 3 (i) { repeat 2 (j) { a = a + (i << j*4); } } [*] = a + -i", EVAL(0x33 - 0), EEE_NO_ERROR },
+    { "def sq(x) = x*x; [*] = sq(t+1)", EVAL((t+1)*(t+1)), EEE_NO_ERROR },
+    { "def mix(a, b) = (a + b)/2; def tri(x) = mix(x, 255 - x); [*] = tri(t & 255) + mix(t, 3)", EVAL(((t&255) + 255 - (t&255))/2 + (t+3)/2), EEE_NO_ERROR },
+    { "def inc(v) = v = v + 1; inc(c); inc(c); [*] = c", EVAL(2*(t+1)), EEE_NO_ERROR },
+    { "a = 0; def fi(x) = x + i; repeat 3 (i) { a = a + fi(i + 1); } [*] = a", EVAL(6), EEE_NO_ERROR },
+    { "rec(0, 8, t); [*] = tap(0, 8, 3)", EVAL(t >= 3 ? t - 3 : 0), EEE_NO_ERROR },
+    { "[*] = tap(100, 5, 4) + rec(100, 5, t*2)", EVAL((t >= 4 ? (t - 4)*2 : 0) + t*2), EEE_NO_ERROR },
+    { "fill(10, 4, t); [*] = copy(20, 10, 4) + @23", EVAL(2*t), EEE_NO_ERROR },
+    // a copy of all of memory moves every value along by one, including the last one, which wraps around to @0
+    { "@1279 = 5; @0 = t; @1 = 9; copy(1, 0, 1000000); [*] = @0 + @1*16 + @2*256", EVAL(5 + t*16 + 9*256), EEE_NO_ERROR },
+    // and one that overlaps both ends of the source wraps around too, but leaves what is outside of the destination alone
+    { "@0 = t; @579 = 5; @999 = 9; @500 = 11; copy(700, 0, 1000); [*] = @700 + @1279*16 + @419*256 + @500*4096", EVAL(t + 5*16 + 9*256 + 11*4096), EEE_NO_ERROR },
+    { "[*] = lpf(a, 1024, 128)", EVAL(t >= 10 ? 1023 : 1024 - (1024 >> (t + 1))), EEE_NO_ERROR },
+    { "[*] = hpf(@100, 1024, 128) + lpf(@101, 1024, 128)", EVAL(1024), EEE_NO_ERROR },
+    // inputs are clamped to leave room for the fraction, and the highpass is taken from the clamped input
+    { "[*] = hpf(@100, 1 << 60, 128) + lpf(@101, 1 << 60, 128)", EVAL(((Program::Value)1 << 48) - 1), EEE_NO_ERROR },
+    { "[*] = slew(a, t*4, 3)", EVAL(3*t), EEE_NO_ERROR },
+    { "def hit(s, r) = env(s, t % 16 == 0 ? 160 : 0, r); [*] = hit(e, 10)", EVAL(160 - 10*(t%16)), EEE_NO_ERROR },
     
     // test syntax errors
     { "[*] = 5*(2*$(1+3+1)", EVAL(0), EEE_PARENTHESIS },
     { "[*] = 5*/2", EVAL(0), Program::CE_FAILED_TO_PARSE_NUMBER },
+    { "every 4 [*] = 1", EVAL(0), Program::CE_MISSING_BLOCK },
+    { "every 4 { [*] = 1;", EVAL(0), Program::CE_MISSING_BRACE },
+    { "repeat 4 (i) { i = 1 } [*] = 0", EVAL(0), Program::CE_ILLEGAL_ASSIGNMENT },
+    { "repeat n { [*] = 1 }", EVAL(0), Program::CE_ILLEGAL_REPEAT_COUNT },
+    { "repeat 1025 { [*] = 1 }", EVAL(0), Program::CE_ILLEGAL_REPEAT_COUNT },
+    { "repeat 1024 { repeat 1024 { [*] = t } }", EVAL(0), Program::CE_PROGRAM_TOO_LONG },
+    { "[*] = sq(t)", EVAL(0), Program::CE_UNKNOWN_FUNCTION },
+    { "def ff(x) = ff(x); [*] = ff(t)", EVAL(0), Program::CE_UNKNOWN_FUNCTION },
+    { "[*] = tap(0, 8)", EVAL(0), Program::CE_WRONG_ARGUMENT_COUNT },
+    { "def fill(x) = x; [*] = fill(t)", EVAL(0), Program::CE_ILLEGAL_FUNCTION_DEFINITION },
+    { "[*] = lpf(3, t, 8)", EVAL(0), Program::CE_ILLEGAL_STATE_ARGUMENT },
+    { "def sq(x) = x*x; [*] = sq(t, 2)", EVAL(0), Program::CE_WRONG_ARGUMENT_COUNT },
+    { "def sq(x) = x*x; def sq(y) = y; [*] = sq(t)", EVAL(0), Program::CE_ILLEGAL_FUNCTION_DEFINITION },
+    { "every 2 { def ff(x) = x; } [*] = t", EVAL(0), Program::CE_ILLEGAL_FUNCTION_DEFINITION },
+    { "def inc(v) = v = v + 1; [*] = inc(t + 1)", EVAL(0), Program::CE_ILLEGAL_ASSIGNMENT },
+    { "def dd(x) = x + x; def gg(x) = dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(dd(x)))))))))))))))))))); [*] = gg(t)", EVAL(0), Program::CE_PROGRAM_TOO_LONG },
 };
 
 const int testCount = sizeof(tests) / sizeof(Test);
 const int testIterations = 1024*8;
 
+// whether running with 32-bit values is expected to be proven to sound the same as running with 64-bit values
+struct WidthTest
+{
+    const char * expr;
+    const bool equivalent;
+};
+
+WidthTest widthTests[] = {
+    { "[*] = t*(42&(t&65535)>>10)", true },
+    { "[*] = t*5&(t&1023)>>7|t*3", true },
+    { "[*] = ((t&65535)/3) % 256", true },
+    { "[*] = $(t&1023) + #(t&1023) + T(t&1023)", true },
+    { "a = (a + 1) % 1000; [*] = a*t ^ a>>3", true },
+    { "[*] = (t*t*t) % 1024", true },
+    { "@10 = t; [0] = @10 * 3; [1] = [0] << 4", true },
+    { "[*] = rec(0, 256, t*t) + tap(0, 256, 100)", true },
+    { "[*] = slew(a, t & 255, 4)", true },
+    // t keeps counting past 32 bits, so anything that moves its high bits down or compares it differs
+    { "[*] = t*(42&t>>10)", false },
+    { "[*] = (t/3) % 256", false },
+    { "[*] = t > 1000 ? t*3 : t/7", false },
+    { "[*] = #(t>>1)", false },
+    { "[*] = (t*t)/3", false },
+    { "[*] = #(t*3)", false },
+    { "a = a + 1; [*] = a>>3", false },
+    { "[*] = t<<40", false },
+    { "[*] = t >> (t % 40)", false },
+    { "[*] = (t*t) > 5000 ? 1 : 2", false },
+    { "[*] = 100 / (t*t)", false },
+    { "[*] = lpf(a, t, 8)", false },
+    { "[*] = @(t*t)", false },
+};
+
+const int widthTestCount = sizeof(widthTests) / sizeof(WidthTest);
+
 void set(Program& e, Program::Value _t, Program::Value _p)
 {
     t = _t;
@@ -132,8 +216,683 @@ void set(Program& e, Program::Value _t, Program::Value _p)
     e.Set('p', _p);
 }
 
+// check that VW_AUTO picks 32 bits for exactly the programs that are expected to be equivalent,
+// and that those give the same low 32 bits as 64-bit values, which is all that can reach the outputs.
+static bool testWidths()
+{
+    bool passed = true;
+    for ( const WidthTest& test : widthTests )
+    {
+        std::cout << '"' << test.expr << '"';
+        Program::CompileError err;
+        int errPos;
+        Program* automatic = Program::Compile(test.expr, 1024, err, errPos, Program::VW_AUTO);
+        Program* wide = Program::Compile(test.expr, 1024, err, errPos, Program::VW_64);
+        Program* narrow = Program::Compile(test.expr, 1024, err, errPos, Program::VW_32);
+        assert( err == EEE_NO_ERROR );
+
+        bool ok = automatic->IsEquivalentAt32Bits() == test.equivalent
+            && automatic->GetValueWidth() == (test.equivalent ? Program::VW_32 : Program::VW_64)
+            && narrow->GetValueWidth() == Program::VW_32 && wide->GetValueWidth() == Program::VW_64;
+        for ( Program* program : { wide, narrow } )
+        {
+            program->Set('w', w);
+            program->SetRandomSeed(1);
+        }
+        for ( Program::Value i = 0; ok && test.equivalent && i < testIterations; ++i )
+        {
+            // far enough along that anything which overflows 32 bits does, and half of the time past where t itself does
+            const Program::Value tick = (i % 2 ? (Program::Value)1 << 32 : 0) + 100000 + i * 97;
+            Program::Value wideResult[2] = { 0, 0 };
+            Program::Value narrowResult[2] = { 0, 0 };
+            wide->Set('t', tick);
+            narrow->Set('t', tick);
+            const Program::RuntimeError wideError = wide->Run(wideResult, 2);
+            const Program::RuntimeError narrowError = narrow->Run(narrowResult, 2);
+            ok = wideError == narrowError && (uint32_t)wideResult[0] == narrowResult[0] && (uint32_t)wideResult[1] == narrowResult[1];
+        }
+
+        std::cout << (ok ? " PASSED" : " FAILED") << (test.equivalent ? " at 32 bits" : " at 64 bits") << std::endl;
+        passed = passed && ok;
+        delete automatic;
+        delete wide;
+        delete narrow;
+    }
+
+    // 32-bit values wrap around at 32 bits, even when the constants don't fit
+    Program::CompileError err;
+    int errPos;
+    Program* narrow = Program::Compile("[*] = 4294967295 + 1 + (1<<32) + 4294967296", 1024, err, errPos, Program::VW_32);
+    Program::Value result[2];
+    narrow->Run(result, 2);
+    std::cout << "\"[*] = 4294967295 + 1 + (1<<32) + 4294967296\" at 32 bits " << (result[0] == 1 ? "PASSED" : "FAILED") << std::endl;
+    passed = passed && result[0] == 1;
+    delete narrow;
+
+    return passed;
+}
+
+// programs written with ProgramDSL.h, which should do exactly what compiling the source does,
+// including the errors, what is left in memory, and the random numbers they use.
+struct NativeTest
+{
+    const char * expr;
+    Program* (*compile)();
+};
+
+namespace Native
+{
+    using DSL::a; using DSL::b; using DSL::c; using DSL::d; using DSL::t; using DSL::w;
+    using DSL::all; using DSL::at; using DSL::out; using DSL::put; using DSL::poke; using DSL::when; using DSL::every; using DSL::program;
+    using DSL::sine; using DSL::square; using DSL::triangle; using DSL::freq; using DSL::rnd; using DSL::cc; using DSL::vc;
+    using DSL::tap; using DSL::rec; using DSL::copy; using DSL::fill; using DSL::lpf; using DSL::hpf; using DSL::slew; using DSL::env;
+
+    NativeTest tests[] = {
+        { "[*] = t*(42&t>>10)", []{ return DSL::Compile(put(all, t*(42&(t>>10))), 1024); } },
+        { "a = t*3 + 7; b = a / (t % 5); [0] = a - b; [1] = a % 13", []{ return DSL::Compile(program(a = t*3 + 7, b = a / (t % 5), put(0, a - b), put(1, a % 13)), 1024); } },
+        { "[0] = -t ^ ~t | !(t % 3); [1] = t << 100 | t >> (t % 9)", []{ return DSL::Compile(program(put(0, (-t ^ ~t) | !(t % 3)), put(1, (t << 100) | (t >> (t % 9)))), 1024); } },
+        { "[*] = (t < 100) + (t <= 100)*2 + (t > 100)*4 + (t >= 100)*8 + (t == 100)*16 + (t != 100)*32",
+            []{ return DSL::Compile(put(all, (t < 100) + (t <= 100)*2 + (t > 100)*4 + (t >= 100)*8 + (t == 100)*16 + (t != 100)*32), 1024); } },
+        { "[0] = $t + #t + Tt; [1] = F(t % 100)", []{ return DSL::Compile(program(put(0, sine(t) + square(t) + triangle(t)), put(1, freq(t % 100))), 1024); } },
+        { "w = t % 50; [*] = $t + #t + Tt", []{ return DSL::Compile(program(w = t % 50, put(all, sine(t) + square(t) + triangle(t))), 1024); } },
+        { "[0] = R(t % 7); [1] = R(1000) + C(t) + V(t)", []{ return DSL::Compile(program(put(0, rnd(t % 7)), put(1, rnd(1000) + cc(t) + vc(t))), 1024); } },
+        { "@(t % 16) = { t, t*2, t*3 }; [0] = @3 + @(t % 5); [1] = [0] + [*]",
+            []{ return DSL::Compile(program(poke(at(t % 16), t, t*2, t*3), put(0, at(3) + at(t % 5)), put(1, out(0) + out(all))), 1024); } },
+        { "a = t % 3 ? t : t*2; t % 4 == 0 ? b = b + 1; every 8 { c = c + t; d = t; } [0] = a + b + c; [1] = b ? d : 0",
+            []{ return DSL::Compile(program(a = when(t % 3, t, t*2), when(t % 4 == 0, b = b + 1), every(8, c = c + t, d = t), put(0, a + b + c), put(1, when(b, d, 0))), 1024); } },
+        { "a = @(t % 2000) = { t, 1 }; every t % 5 { b = t; } [*] = a + b", []{ return DSL::Compile(program(a = poke(at(t % 2000), t, 1), every(t % 5, b = t), put(all, a + b)), 1024); } },
+        { "rec(100, 64, t*t); copy(200, 100, 80); fill(300, t % 20, t); [0] = tap(100, 64, 3) + tap(100, 50, 2) + @210 + @305",
+            []{ return DSL::Compile(program(rec(100, 64, t*t), copy(200, 100, 80), fill(300, t % 20, t), put(0, tap(100, 64, 3) + tap(100, 50, 2) + at(210) + at(305))), 1024); } },
+        { "copy(t % 1300, 5, 40); fill(1270, 30, t); [*] = lpf(a, t*100, 30) + hpf(@7, t, 200) + slew(c, t % 1000, 10) + env(d, t % 977, 3)",
+            []{ return DSL::Compile(program(copy(t % 1300, 5, 40), fill(1270, 30, t), put(all, lpf(a, t*100, 30) + hpf(at(7), t, 200) + slew(c, t % 1000, 10) + env(d, t % 977, 3))), 1024); } },
+        { "@(t % 1280) = t; copy(t % 3, 1, 5000); copy(t % 1280, 300, 1000); [*] = @0 + @2 + @(t % 1280)",
+            []{ return DSL::Compile(program(poke(at(t % 1280), t), copy(t % 3, 1, 5000), copy(t % 1280, 300, 1000), put(all, at(0) + at(2) + at(t % 1280))), 1024); } },
+        { "[*] = { t, t+1 }; [0] = [1] * 2; [t % 3] = 3", []{ return DSL::Compile(program(put(all, t, t + 1), put(0, out(1) * 2), put(t % 3, 3)), 1024); } },
+        { "a = [t % 3]; [*] = a + t", []{ return DSL::Compile(program(a = out(t % 3), put(all, a + t)), 1024); } },
+        { "a = rec(0, t % 4, 1) + R(5); [*] = a", []{ return DSL::Compile(program(a = rec(0, t % 4, 1) + rnd(5), put(all, a)), 1024); } },
+    };
+}
+
+static bool testNative()
+{
+    bool passed = true;
+    Timer timer;
+    for ( const NativeTest& test : Native::tests )
+    {
+        std::cout << '"' << test.expr << "\" native";
+        Program::CompileError err;
+        int errPos;
+        Program* interpreted = Program::Compile(test.expr, 1024, err, errPos);
+        assert( err == EEE_NO_ERROR );
+        Program* native = test.compile();
+
+        double elapsed[2] = { 0, 0 };
+        bool ok = true;
+        Program* programs[2] = { interpreted, native };
+        Program::Value results[2][2] = { { 0, 0 }, { 0, 0 } };
+        for ( int k = 0; k < 2; ++k )
+        {
+            programs[k]->Set('w', w);
+            programs[k]->SetRandomSeed(7);
+            programs[k]->SetVC(3, 5);
+            programs[k]->SetCC(4, 9);
+        }
+        for ( Program::Value i = 0; ok && i < testIterations; ++i )
+        {
+            Program::RuntimeError errors[2];
+            for ( int k = 0; k < 2; ++k )
+            {
+                programs[k]->Set('t', i);
+                timer.reset();
+                errors[k] = programs[k]->Run(results[k], 2);
+                elapsed[k] += timer.elapsed();
+            }
+            ok = errors[0] == errors[1] && results[0][0] == results[1][0] && results[0][1] == results[1][1];
+        }
+        for ( Program::Value i = 0; ok && i < interpreted->GetMemorySize(); ++i )
+        {
+            ok = interpreted->Peek(i) == native->Peek(i);
+        }
+        for ( int e = Program::RE_NONE; ok && e < Program::RE_COUNT; ++e )
+        {
+            ok = interpreted->GetErrorCount((Program::RuntimeError)e) == native->GetErrorCount((Program::RuntimeError)e);
+        }
+
+        if ( ok )
+        {
+            std::cout << " PASSED " << std::setprecision(3) << (elapsed[0] / elapsed[1]) << "x faster than the interpreter" << std::endl;
+        }
+        else
+        {
+            std::cout << " FAILED" << std::endl;
+        }
+        passed = passed && ok;
+        delete interpreted;
+        delete native;
+    }
+
+    return passed;
+}
+
+// programs routed into each other with ProgramGraph, which should do what running them one after the other
+// frame by frame does, with and without the ThreadPool. pipelined scheduling delays every route by one block.
+struct GraphRoute
+{
+    int from;
+    size_t fromChannel;
+    int to;
+    size_t toChannel;
+};
+
+namespace Graph
+{
+    const char * nodes[] = {
+        "[*] = t*3 + [0]",
+        "a = a + [0]; [0] = a; [1] = [1] ^ t",
+        "[0] = [0] * 5 + [1]; [1] = R(100)",
+        "[*] = [0] / 2 + [1]",
+    };
+    const size_t nodeCount = sizeof(nodes) / sizeof(*nodes);
+    const int output = 3;
+
+    const GraphRoute routes[] = {
+        { ProgramGraph::kGraphInput, 0, 0, 0 },
+        { 0, 0, 1, 0 },
+        { 0, 1, 1, 1 },
+        { 0, 0, 2, 0 },
+        { 1, 0, 3, 0 },
+        { 2, 0, 3, 0 },
+        { 1, 1, 3, 1 },
+    };
+    // makes a cycle, which only pipelined scheduling can run
+    const GraphRoute feedback = { 3, 0, 0, 1 };
+
+    const size_t blockSize = 64;
+    const size_t blockCount = 40;
+
+    Program::Value input(size_t block, size_t frame)
+    {
+        return (Program::Value)(block * blockSize + frame) * 7;
+    }
+
+    ProgramGraph::Clock clock(size_t block)
+    {
+        ProgramGraph::Clock clock = { (Program::Value)(block * blockSize), 44.1, 100 };
+        return clock;
+    }
+
+    Program* compile(const char * source)
+    {
+        Program::CompileError err;
+        int errPos;
+        Program* program = Program::Compile(source, 1024, err, errPos);
+        assert( err == EEE_NO_ERROR );
+        program->SetRandomSeed(7);
+        return program;
+    }
+}
+
+// run the nodes one frame at a time in the order they're listed in, which is an order the routes allow
+static std::vector<Program::Value> renderGraphReference(bool pipelined, bool feedback)
+{
+    std::vector<Program*> programs;
+    for ( const char * source : Graph::nodes )
+    {
+        programs.push_back(Graph::compile(source));
+    }
+    std::vector<GraphRoute> routes(std::begin(Graph::routes), std::end(Graph::routes));
+    if ( feedback )
+    {
+        routes.push_back(Graph::feedback);
+    }
+
+    // the outputs of every node in this block and the one before it
+    std::vector<Program::Value> outputs[2];
+    outputs[0].assign(Graph::nodeCount * 2 * Graph::blockSize, 0);
+    outputs[1] = outputs[0];
+    auto slot = [](int node, size_t channel, size_t frame) { return (node * 2 + channel) * Graph::blockSize + frame; };
+
+    std::vector<Program::Value> rendered;
+    for ( size_t block = 0; block < Graph::blockCount; ++block )
+    {
+        const int write = pipelined ? block % 2 : 0;
+        const int read = pipelined ? 1 - write : write;
+        const ProgramGraph::Clock clock = Graph::clock(block);
+        for ( size_t f = 0; f < Graph::blockSize; ++f )
+        {
+            const Program::Value tick = clock.tick + f;
+            for ( int k = 0; k < (int)Graph::nodeCount; ++k )
+            {
+                programs[k]->Set('t', tick);
+                programs[k]->Set('m', (Program::Value)round(tick / clock.mdenom));
+                programs[k]->Set('q', (Program::Value)round(tick / clock.qdenom));
+                Program::Value results[2] = { 0, 0 };
+                for ( const GraphRoute& route : routes )
+                {
+                    if ( route.to == k )
+                    {
+                        results[route.toChannel] += route.from == ProgramGraph::kGraphInput ? Graph::input(block, f) : outputs[read][slot(route.from, route.fromChannel, f)];
+                    }
+                }
+                programs[k]->Run(results, 2);
+                outputs[write][slot(k, 0, f)] = results[0];
+                outputs[write][slot(k, 1, f)] = results[1];
+            }
+            rendered.push_back(outputs[write][slot(Graph::output, 0, f)]);
+            rendered.push_back(outputs[write][slot(Graph::output, 1, f)]);
+        }
+    }
+
+    for ( Program* program : programs )
+    {
+        delete program;
+    }
+    return rendered;
+}
+
+// returns nothing when the graph can't be prepared
+static std::vector<Program::Value> renderGraph(ProgramGraph::Scheduling scheduling, bool feedback, bool parallel, size_t& stageCount)
+{
+    ProgramGraph graph(Graph::blockSize, parallel);
+    for ( const char * source : Graph::nodes )
+    {
+        graph.AddNode(Graph::compile(source));
+    }
+    for ( const GraphRoute& route : Graph::routes )
+    {
+        graph.Connect(route.from, route.fromChannel, route.to, route.toChannel);
+    }
+    if ( feedback )
+    {
+        graph.Connect(Graph::feedback.from, Graph::feedback.fromChannel, Graph::feedback.to, Graph::feedback.toChannel);
+    }
+    graph.SetOutput(Graph::output);
+
+    std::vector<Program::Value> rendered;
+    if ( !graph.Prepare(scheduling) )
+    {
+        return rendered;
+    }
+    stageCount = graph.GetStageCount();
+
+    std::vector<Program::Value> inputs[2] = { std::vector<Program::Value>(Graph::blockSize), std::vector<Program::Value>(Graph::blockSize, 0) };
+    const Program::Value* blockInputs[2] = { inputs[0].data(), inputs[1].data() };
+    for ( size_t block = 0; block < Graph::blockCount; ++block )
+    {
+        for ( size_t f = 0; f < Graph::blockSize; ++f )
+        {
+            inputs[0][f] = Graph::input(block, f);
+        }
+        graph.Render(blockInputs, Graph::blockSize, Graph::clock(block));
+        for ( size_t f = 0; f < Graph::blockSize; ++f )
+        {
+            rendered.push_back(graph.GetOutput(0)[f]);
+            rendered.push_back(graph.GetOutput(1)[f]);
+        }
+    }
+    return rendered;
+}
+
+static bool testGraph()
+{
+    bool passed = true;
+    const std::vector<Program::Value> immediate = renderGraphReference(false, false);
+    const std::vector<Program::Value> pipelined = renderGraphReference(true, true);
+    for ( bool parallel : { false, true } )
+    {
+        size_t stageCount = 0;
+        bool ok = renderGraph(ProgramGraph::kSchedulingImmediate, false, parallel, stageCount) == immediate && stageCount == 3;
+        std::cout << "graph immediate" << (parallel ? " in parallel" : "") << (ok ? " PASSED" : " FAILED") << std::endl;
+        passed = passed && ok;
+
+        ok = renderGraph(ProgramGraph::kSchedulingPipelined, true, parallel, stageCount) == pipelined && stageCount == 1;
+        std::cout << "graph pipelined" << (parallel ? " in parallel" : "") << (ok ? " PASSED" : " FAILED") << std::endl;
+        passed = passed && ok;
+    }
+
+    size_t stageCount = 0;
+    const bool ok = renderGraph(ProgramGraph::kSchedulingImmediate, true, false, stageCount).empty();
+    std::cout << "graph cycle " << (ok ? "PASSED" : "FAILED") << std::endl;
+    return passed && ok;
+}
+
+// memory saved with the plugin state has to come back exactly, and anything that isn't a whole encoding
+// of the expected number of values has to be rejected, because it comes from a file the host gave us.
+static bool testMemoryEncoding()
+{
+    const Program::Value big = ~(Program::Value)0;
+    const Program::Value shapes[][12] = {
+        // nothing but runs, which are the whole point
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 0, 0, 5, 5, 5, 5, 5, 5 },
+        // nothing but literals
+        { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 },
+        // repeats that are too short to be runs, and one that is just long enough
+        { 1, 1, 2, 3, 3, 4, 4, 4, 5, 6, 6, 7 },
+        // runs of values on either side of the varint boundaries
+        { 127, 127, 127, 128, 128, 128, 16383, 16383, 16383, 16384, 16384, 16384 },
+        // literals on either side of the varint boundaries
+        { 127, 128, 16383, 16384, 2097151, 2097152, big >> 1, big, 0, big, 1, big - 1 },
+    };
+
+    bool ok = true;
+    for ( const Program::Value* values : shapes )
+    {
+        for ( size_t count = 0; count <= 12; ++count )
+        {
+            std::vector<uint8_t> data;
+            MemoryEncoding::Encode(values, count, data);
+
+            std::vector<Program::Value> decoded(count + 1, 0xabcd);
+            ok = ok && MemoryEncoding::Decode(data.data(), data.size(), decoded.data(), count)
+                && std::equal(values, values + count, decoded.begin())
+                && decoded[count] == 0xabcd;
+            // the number of values is part of what is checked
+            ok = ok && !MemoryEncoding::Decode(data.data(), data.size(), decoded.data(), count + 1);
+            ok = ok && (count == 0 || !MemoryEncoding::Decode(data.data(), data.size(), decoded.data(), count - 1));
+            // every truncation decodes to too few values or stops in the middle of a varint
+            for ( size_t size = 0; count > 0 && size < data.size(); ++size )
+            {
+                ok = ok && !MemoryEncoding::Decode(data.data(), size, decoded.data(), count);
+            }
+        }
+    }
+
+    // one literal takes a byte per 7 bits, plus a byte each for the run length and literal count
+    const Program::Value boundaries[] = { 127, 128, 16383, 16384, big };
+    const size_t sizes[] = { 3, 4, 4, 5, 12 };
+    for ( size_t i = 0; i < 5; ++i )
+    {
+        std::vector<uint8_t> data;
+        MemoryEncoding::Encode(&boundaries[i], 1, data);
+        ok = ok && data.size() == sizes[i];
+    }
+
+    // a run that is longer than what is left to fill, and a varint that never ends
+    Program::Value decoded[4];
+    const uint8_t longRun[] = { 5, 1, 0 };
+    const uint8_t endless[] = { 0, 1, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01 };
+    ok = ok && !MemoryEncoding::Decode(longRun, sizeof(longRun), decoded, 4);
+    ok = ok && !MemoryEncoding::Decode(endless, sizeof(endless), decoded, 1);
+
+    std::cout << "memory encoding " << (ok ? "PASSED" : "FAILED") << std::endl;
+    return ok;
+}
+
+// instances exchanging values through MemoryBus, which they should see in the block after they were written,
+// without undoing each other's values or seeing half of another instance's block.
+static bool testMemoryBus()
+{
+    const size_t userMemorySize = 2048;
+    const Program::Value bus = MemoryBus::GetAddress(userMemorySize);
+    assert( bus == 1024 );
+    const size_t blockSize = 16;
+
+    Program::CompileError err;
+    int errPos;
+    Program* writer = Program::Compile("@1024 = t*3; @1025 = 1<<40; [*] = @1030", userMemorySize, err, errPos);
+    Program* reader = Program::Compile("[0] = @1024; [1] = @1025; @1030 = t + 5", userMemorySize, err, errPos);
+    Program* narrow = Program::Compile("[0] = @1025; @1031 = 7", userMemorySize, err, errPos, Program::VW_32);
+    assert( err == EEE_NO_ERROR );
+    Program* programs[3] = { writer, reader, narrow };
+    MemoryBus::Port ports[3];
+
+    bool ok = true;
+    for ( size_t block = 0; ok && block < 10; ++block )
+    {
+        for ( int k = 0; k < 3; ++k )
+        {
+            ports[k].Read(*programs[k], userMemorySize);
+        }
+        for ( size_t f = 0; f < blockSize; ++f )
+        {
+            const Program::Value tick = block * blockSize + f;
+            Program::Value results[3][2] = { { 0, 0 }, { 0, 0 }, { 0, 0 } };
+            for ( int k = 0; k < 3; ++k )
+            {
+                programs[k]->Set('t', tick);
+                programs[k]->Run(results[k], 2);
+            }
+            if ( block > 0 )
+            {
+                // what the last frame of the previous block wrote
+                const Program::Value last = block * blockSize - 1;
+                ok = ok && results[1][0] == last * 3 && results[1][1] == (Program::Value)1 << 40
+                    && results[0][0] == last + 5 && results[2][0] == 0;
+            }
+        }
+        for ( int k = 0; k < 3; ++k )
+        {
+            ports[k].Write(*programs[k], userMemorySize);
+        }
+    }
+    // the 32-bit program only ever saw the low bits of @1025, which it didn't change, so it mustn't publish them
+    ok = ok && MemoryBus::Get().values[1].load() == (Program::Value)1 << 40 && MemoryBus::Get().values[7].load() == 7;
+    std::cout << "memory bus " << (ok ? "PASSED" : "FAILED") << std::endl;
+
+    // one instance writes the same value to the whole bus every block, so every consistent read should be all the same value
+    // which starts from a bus of zeros rather than what was left on it above
+    Program* filler = Program::Compile("[*] = 0", userMemorySize, err, errPos);
+    MemoryBus::Port port;
+    port.Read(*filler, userMemorySize);
+    for ( size_t a = 0; a < MemoryBus::kSize; ++a )
+    {
+        filler->Poke(bus + a, 0);
+    }
+    port.Write(*filler, userMemorySize);
+    std::atomic<bool> done(false);
+    std::thread publisher([&] {
+        MemoryBus::Port port;
+        for ( Program::Value i = 1; !done; ++i )
+        {
+            port.Read(*filler, userMemorySize);
+            for ( size_t a = 0; a < MemoryBus::kSize; ++a )
+            {
+                filler->Poke(bus + a, i);
+            }
+            port.Write(*filler, userMemorySize);
+        }
+    });
+    int consistent = 0;
+    bool torn = false;
+    for ( int i = 0; i < 20000; ++i )
+    {
+        if ( port.Read(*reader, userMemorySize) )
+        {
+            ++consistent;
+            for ( size_t a = 1; a < MemoryBus::kSize; ++a )
+            {
+                torn = torn || reader->Peek(bus + a) != reader->Peek(bus);
+            }
+        }
+    }
+    done = true;
+    publisher.join();
+    const bool consistentOk = consistent > 0 && !torn;
+    std::cout << "memory bus consistency " << (consistentOk ? "PASSED" : "FAILED") << std::endl;
+
+    delete writer;
+    delete reader;
+    delete narrow;
+    delete filler;
+    return ok && consistentOk;
+}
+
+// several clients using the ThreadPool at once, from the audio threads of their instances and in the background.
+// every item of audio work has to run exactly once, and every background task has to run unless its client leaves first.
+static bool testThreadPool()
+{
+    const size_t itemCount = 500;
+    const int clientCount = 4;
+    const int jobCount = 200;
+
+    std::vector<std::atomic<int>> calls(clientCount * itemCount);
+    std::vector<std::atomic<int>> tasks(clientCount);
+    std::vector<std::thread> instances;
+    for ( int c = 0; c < clientCount; ++c )
+    {
+        instances.push_back(std::thread([&, c] {
+            ThreadPool::Client client;
+            for ( int t = 0; t < 20; ++t )
+            {
+                client.Submit([&, c] { ++tasks[c]; });
+            }
+            std::atomic<int>* mine = &calls[c * itemCount];
+            for ( int j = 0; j < jobCount; ++j )
+            {
+                client.Parallel(itemCount, [](void* context, size_t index) { ++static_cast<std::atomic<int>*>(context)[index]; }, mine);
+            }
+            // wait for the background tasks so that leaving doesn't drop any
+            while ( tasks[c] < 20 )
+            {
+                std::this_thread::yield();
+            }
+        }));
+    }
+    for ( std::thread& instance : instances )
+    {
+        instance.join();
+    }
+
+    bool ok = true;
+    for ( std::atomic<int>& count : calls )
+    {
+        ok = ok && count == jobCount;
+    }
+    std::cout << "thread pool " << (ok ? "PASSED" : "FAILED") << std::endl;
+
+    // a client leaving waits for its running tasks, and none of its tasks run after it has left
+    std::atomic<bool> started(false);
+    std::atomic<bool> finished(false);
+    std::atomic<int> later(0);
+    {
+        ThreadPool::Client client;
+        client.Submit([&] {
+            started = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            finished = true;
+        });
+        while ( !started )
+        {
+            std::this_thread::yield();
+        }
+        for ( int t = 0; t < 100; ++t )
+        {
+            client.Submit([&] { ++later; });
+        }
+    }
+    const int ranBeforeLeaving = later;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    const bool leaveOk = finished && later == ranBeforeLeaving;
+    std::cout << "thread pool leave " << (leaveOk ? "PASSED" : "FAILED") << std::endl;
+
+    return ok && leaveOk;
+}
+
+// print the disassembly of a program instead of running the tests, eg:
+// expression_test -d "[*] = t*Fn"
+// or with -g instead of -d, the C++ source that GenerateSource makes from it.
+static int disassemble(const char * source, bool generate)
+{
+    Program::CompileError err;
+    int errPos;
+    Program* program = Program::Compile(source, 1024, err, errPos);
+    if ( program == nullptr )
+    {
+        std::cout << "Compile Error: " << Program::GetErrorString(err) << " at " << errPos << std::endl;
+        return 1;
+    }
+    
+    std::cout << (generate ? program->GenerateSource("evaluator_program") : program->Disassemble());
+    delete program;
+    return 0;
+}
+
+// generate a program of roughly size bytes in one of a few shapes that stress different parts of the parser
+static std::string generate(const char * shape, size_t size)
+{
+    std::string source;
+    int line = 0;
+    while ( source.size() < size )
+    {
+        char text[256];
+        if ( strcmp(shape, "statements") == 0 )
+        {
+            snprintf(text, sizeof(text), "a = (t*%d + $(t>>%d)) | b>>3 ^ (c ? @%d : #t);\n", line, line % 16, line % 1024);
+        }
+        else if ( strcmp(shape, "comments") == 0 )
+        {
+            snprintf(text, sizeof(text), "// comment line %d, which used to recurse once per line\n", line);
+        }
+        else // nested
+        {
+            // as deep as the compiler allows for every statement
+            std::string nested;
+            for ( int i = 0; i < Program::kMaxNestingDepth - 2; ++i ) nested += "(t+";
+            nested += "1";
+            for ( int i = 0; i < Program::kMaxNestingDepth - 2; ++i ) nested += ")";
+            source += "a = " + nested + ";\n";
+            ++line;
+            continue;
+        }
+        source += text;
+        ++line;
+    }
+    source += "[*] = a;";
+    return source;
+}
+
+// measure how long it takes to compile programs from 1 KB to 1 MB, eg:
+// expression_test -c
+static int benchmarkCompile()
+{
+    const char * shapes[] = { "statements", "comments", "nested" };
+    std::cout << std::setw(12) << "shape" << std::setw(10) << "size" << std::setw(12) << "ms" << std::setw(12) << "us/KB" << std::endl;
+    for ( const char * shape : shapes )
+    {
+        for ( size_t size = 1024; size <= 1024*1024; size *= 4 )
+        {
+            const std::string source = generate(shape, size);
+            Program::CompileError err;
+            int errPos;
+            // compile a few times and keep the fastest to reduce noise
+            double best = 1e9;
+            for ( int i = 0; i < 5; ++i )
+            {
+                Timer timer;
+                Program* program = Program::Compile(source.c_str(), 1024, err, errPos);
+                best = std::min(best, timer.elapsed());
+                delete program;
+            }
+            if ( err != Program::CE_NONE )
+            {
+                std::cout << shape << " failed to compile: " << Program::GetErrorString(err) << " at " << errPos << std::endl;
+                return 1;
+            }
+            std::cout << std::setw(12) << shape << std::setw(9) << source.size()/1024 << "K" << std::setw(12) << std::fixed << std::setprecision(3) << best*1000
+                      << std::setw(12) << std::setprecision(2) << best*1e6 / (source.size()/1024.0) << std::endl;
+        }
+    }
+    return 0;
+}
+
 int main(int argc, const char * argv[])
 {
+    if ( argc > 2 && strcmp(argv[1], "-d") == 0 )
+    {
+        return disassemble(argv[2], false);
+    }
+
+    if ( argc > 2 && strcmp(argv[1], "-g") == 0 )
+    {
+        return disassemble(argv[2], true);
+    }
+
+    if ( argc > 1 && strcmp(argv[1], "-c") == 0 )
+    {
+        return benchmarkCompile();
+    }
+    
     Timer timer;
     Program::Char str[1024];
     for(int i = 0; i < testCount; ++i)
@@ -159,7 +918,7 @@ int main(int argc, const char * argv[])
                 if ( err != EEE_NO_ERROR )
                 {
                     std::cout << " FAILED with error: "  << Program::GetErrorString(err) << '\n';
-                    auto off = errPos - (int)str;
+                    auto off = errPos;
                     for(int i = 0; i < off; ++i)
                     {
                         std::cout << ' ';
@@ -168,7 +927,7 @@ int main(int argc, const char * argv[])
                 }
                 else
                 {
-                    std::cout << " compiled to " << program->GetInstructionCount() << " instructions.";
+                    std::cout << " compiled to " << program->GetInstructionCount() << " instructions (~" << program->GetEstimatedCost() << " cycles).";
                     set(*program, 0, 0);
                     double elapsed = 0;
 					Program::Value result[2];
@@ -207,5 +966,18 @@ int main(int argc, const char * argv[])
 
 		assert(err == test.error);
     }
-    return 0;
+
+    const bool widthsPassed = testWidths();
+    assert( widthsPassed );
+    const bool nativePassed = testNative();
+    assert( nativePassed );
+    const bool graphPassed = testGraph();
+    assert( graphPassed );
+    const bool encodingPassed = testMemoryEncoding();
+    assert( encodingPassed );
+    const bool busPassed = testMemoryBus();
+    assert( busPassed );
+    const bool poolPassed = testThreadPool();
+    assert( poolPassed );
+    return widthsPassed && nativePassed && graphPassed && encodingPassed && busPassed && poolPassed ? 0 : 1;
 }
@@ -0,0 +1,1220 @@
+//
+//  main.cpp
+//  fuzz_test
+//
+//  Generates random valid programs from the grammar, runs them with random inputs,
+//  and compares the results with an independent evaluator of the program's syntax tree (the model).
+//  Every engine in kEngines is compared with the reference interpreter as well,
+//  so optimized engines can be checked here before they are enabled in the plugin.
+//  Build it with something like:
+//
+//    c++ -std=c++11 -O2 -o fuzz_test main.cpp ../Program.cpp ../GeneratedProgram.cpp -ldl
+//
+//  usage: fuzz_test [-n programs] [-s seed] [-v] [-g]
+//    -n  how many programs to generate (default 10000)
+//    -s  seed for the generator, so a failure can be reproduced (default is the time)
+//    -v  print every program
+//    -g  instead of the model, compare the source made by Program::GenerateSource with the interpreter,
+//        for 64-bit values and for 32-bit values when they are equivalent. all of it is built into fuzz.so
+//
+
+// required to get M_PI on windows
+#define _USE_MATH_DEFINES
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "../GeneratedProgram.h"
+#include "../Program.h"
+
+typedef Program::Value Value;
+
+static const size_t kUserMemorySize = 1024;
+static const size_t kMemorySize = kUserMemorySize + 256; // see GetTotalMemorySize in Program.cpp
+static const size_t kResultCount = 2;
+static const int kRunsPerProgram = 8;
+
+#pragma region Engines
+// a way of running a compiled program. the first one is the reference that all others are compared to.
+struct Engine
+{
+	const char* name;
+	Program::RuntimeError (*run)(Program& program, Value* results, const size_t size);
+};
+
+static Program::RuntimeError RunReference(Program& program, Value* results, const size_t size)
+{
+	return program.Run(results, size);
+}
+
+static const Engine kEngines[] =
+{
+	{ "reference", RunReference },
+};
+static const int kEngineCount = sizeof(kEngines) / sizeof(Engine);
+#pragma endregion
+
+#pragma region Syntax Tree
+struct Node
+{
+	enum Kind
+	{
+		kNumber,
+		kVariable,
+		kUnary,		// op is the operator character
+		kBinary,	// op is the first character of the operator, op2 is the second (or 0)
+		kTernary,	// children are condition, true, and optionally false
+		kPeek,		// @(child)
+		kGet,		// [child], or [*] when there are no children
+		kAssign,	// children are the target followed by the values, which are in braces when there is more than one
+		kBuiltin,	// name(children), where the first child of the functions with state is a variable or a peek
+		kCall,		// a call to the function defined with name, children are the arguments
+		kDefine,	// def name(params) = body, the first child is the body and the rest are the parameters as variables
+		kEvery,		// every child { statements }, the first child is the rate and the rest are the statements
+		kRepeat,	// repeat value (op) { children }, op is the index variable (or 0)
+	};
+
+	Kind kind;
+	char op;
+	char op2;
+	Value value;
+	std::string name;
+	std::vector<const Node*> children;
+};
+
+// state of the program that the model keeps track of
+struct Machine
+{
+	Value mem[kMemorySize];
+	Value cc[Program::kCCSize];
+	Value vc[Program::kVCSize];
+	Value results[kResultCount];
+	std::default_random_engine rng;
+	Program::RuntimeError error;
+
+	Value Peek(Value address) const { return mem[address % kMemorySize]; }
+	void  Poke(Value address, Value value) { mem[address % kMemorySize] = value; }
+	Value Get(char var) const { return Peek(Program::GetAddress(var, kUserMemorySize)); }
+};
+#pragma endregion
+
+#pragma region Generator
+class Generator
+{
+public:
+	Generator(uint64_t seed) : mRandom((std::mt19937_64::result_type)seed) {}
+
+	// a list of statements, the last one always assigns to the output
+	std::vector<const Node*> Program()
+	{
+		mNodes.clear();
+		mFunctions.clear();
+		std::vector<const Node*> statements;
+		const int count = Range(1, 5);
+		for (int i = 0; i < count - 1; ++i)
+		{
+			statements.push_back(Statement(2, true));
+		}
+
+		statements.push_back(Assign(Output(1), 3));
+		return statements;
+	}
+
+	static std::string Print(const std::vector<const Node*>& statements)
+	{
+		std::string source;
+		for (size_t i = 0; i < statements.size(); ++i)
+		{
+			source += Print(statements[i]);
+			source += i + 1 < statements.size() ? ";\n" : "\n";
+		}
+		return source;
+	}
+
+	static bool HasState(const std::string& builtin)
+	{
+		return builtin == "lpf" || builtin == "hpf" || builtin == "slew" || builtin == "env";
+	}
+
+private:
+	int Range(int low, int high) { return std::uniform_int_distribution<int>(low, high)(mRandom); }
+	bool Chance(int oneIn) { return Range(1, oneIn) == 1; }
+
+	Node* Make(Node::Kind kind)
+	{
+		mNodes.push_back(Node());
+		Node* node = &mNodes.back();
+		node->kind = kind;
+		node->op = 0;
+		node->op2 = 0;
+		node->value = 0;
+		return node;
+	}
+
+	Node* Number(int size)
+	{
+		Node* node = Make(Node::kNumber);
+		switch (Range(0, size))
+		{
+		case 0: node->value = Range(0, 16); break;
+		case 1: node->value = Range(0, 1 << 16); break;
+		default: node->value = mRandom(); break;
+		}
+		return node;
+	}
+
+	// i, j, and k are only read, so they can be the indices of repeat blocks, and are 0 everywhere else.
+	// the body of a function mostly uses its parameters.
+	Node* Variable()
+	{
+		static const char kVariables[] = "tmqnvwabcxyzijk";
+		Node* node = Make(Node::kVariable);
+		node->op = !mParams.empty() && Chance(2) ? mParams[Range(0, (int)mParams.size() - 1)] : kVariables[Range(0, sizeof(kVariables) - 2)];
+		return node;
+	}
+
+	// a variable that can be assigned to, which the parameters of the function being defined can't
+	Node* Writable()
+	{
+		static const char kVariables[] = "tmqnvwabcxyz";
+		Node* node = Make(Node::kVariable);
+		do
+		{
+			node->op = kVariables[Range(0, sizeof(kVariables) - 2)];
+		} while (mParams.find(node->op) != std::string::npos);
+		return node;
+	}
+
+	// usually a small number, so that counts and lengths are sometimes less than all of memory
+	Node* Small(int depth)
+	{
+		if (Chance(3))
+		{
+			return Expression(depth);
+		}
+		Node* node = Make(Node::kNumber);
+		node->value = Range(0, (int)kMemorySize + 8);
+		return node;
+	}
+
+	// a statement that can also be a block, or a function definition at the top level
+	Node* Statement(int depth, bool topLevel)
+	{
+		switch (Range(0, 7))
+		{
+		case 0: if (topLevel && mFunctions.size() < 3) return Define(); break;
+		case 1: if (depth > 0) return Every(depth); break;
+		case 2: if (depth > 0) return Repeat(depth); break;
+		}
+		return Chance(4) ? Expression(3) : Assign(Target(2), 3);
+	}
+
+	void Block(Node* node, int depth)
+	{
+		const int count = Range(0, 3);
+		for (int i = 0; i < count; ++i)
+		{
+			node->children.push_back(Statement(depth - 1, false));
+		}
+	}
+
+	Node* Every(int depth)
+	{
+		Node* node = Make(Node::kEvery);
+		if (Chance(3))
+		{
+			node->children.push_back(Expression(2));
+		}
+		else
+		{
+			Node* rate = Make(Node::kNumber);
+			rate->value = Range(0, 8);
+			node->children.push_back(rate);
+		}
+		Block(node, depth);
+		return node;
+	}
+
+	Node* Repeat(int depth)
+	{
+		static const char kIndices[] = "ijk";
+		Node* node = Make(Node::kRepeat);
+		node->value = Range(0, 4);
+		node->op = Chance(4) ? 0 : kIndices[Range(0, sizeof(kIndices) - 2)];
+		Block(node, depth);
+		return node;
+	}
+
+	Node* Define()
+	{
+		static const char kParams[] = "xyz";
+		Node* node = Make(Node::kDefine);
+		node->name = "f" + std::to_string(mFunctions.size());
+		node->children.push_back(nullptr);
+		const int first = Range(0, 2);
+		const int count = Range(0, 3);
+		for (int i = 0; i < count; ++i)
+		{
+			Node* param = Make(Node::kVariable);
+			param->op = kParams[(first + i) % 3];
+			node->children.push_back(param);
+			mParams += param->op;
+		}
+		node->children[0] = Expression(2);
+		mParams.clear();
+		mFunctions.push_back(node);
+		return node;
+	}
+
+	// something that can be on the left side of '='
+	Node* Target(int depth)
+	{
+		switch (Range(0, 3))
+		{
+		case 0:
+		{
+			Node* node = Make(Node::kPeek);
+			node->children.push_back(Expression(depth));
+			return node;
+		}
+		case 1:
+			return Output(depth);
+		default:
+			return Writable();
+		}
+	}
+
+	// [0], [1], [*], and occasionally an index that is computed, which is usually out of bounds
+	Node* Output(int depth)
+	{
+		Node* node = Make(Node::kGet);
+		switch (Range(0, 7))
+		{
+		case 0: break;
+		case 1: node->children.push_back(Expression(depth)); break;
+		default:
+		{
+			Node* index = Make(Node::kNumber);
+			index->value = Range(0, 1);
+			node->children.push_back(index);
+		}
+		break;
+		}
+		return node;
+	}
+
+	Node* Assign(Node* target, int depth)
+	{
+		Node* node = Make(Node::kAssign);
+		node->children.push_back(target);
+		const int count = Chance(3) ? Range(1, 4) : 1;
+		for (int i = 0; i < count; ++i)
+		{
+			node->children.push_back(Expression(depth));
+		}
+		// braces with a single value are allowed too
+		node->op = count > 1 || Chance(8) ? '{' : 0;
+		return node;
+	}
+
+	Node* Expression(int depth)
+	{
+		if (depth <= 0)
+		{
+			return Chance(2) ? Number(2) : Variable();
+		}
+
+		switch (Range(0, 14))
+		{
+		case 0: return Number(2);
+		case 1: return Variable();
+		case 7:
+		case 8:
+		{
+			static const char* kBuiltins[] = { "tap", "rec", "copy", "fill", "lpf", "hpf", "slew", "env" };
+			Node* node = Make(Node::kBuiltin);
+			node->name = kBuiltins[Range(0, sizeof(kBuiltins) / sizeof(kBuiltins[0]) - 1)];
+			if (HasState(node->name))
+			{
+				Node* state = Chance(2) ? Writable() : Make(Node::kPeek);
+				if (state->kind == Node::kPeek) state->children.push_back(Expression(depth - 1));
+				node->children.push_back(state);
+			}
+			else
+			{
+				node->children.push_back(Small(depth - 1));
+			}
+			node->children.push_back(Small(depth - 1));
+			node->children.push_back(Small(depth - 1));
+			return node;
+		}
+		case 9:
+		{
+			if (mFunctions.empty()) return Variable();
+			const Node* function = mFunctions[Range(0, (int)mFunctions.size() - 1)];
+			Node* node = Make(Node::kCall);
+			node->name = function->name;
+			for (size_t i = 1; i < function->children.size(); ++i)
+			{
+				node->children.push_back(Expression(depth - 1));
+			}
+			return node;
+		}
+		case 2:
+		case 3:
+		{
+			static const char kUnary[] = "@F#$T+-~!CVR";
+			Node* node = Make(Node::kUnary);
+			node->op = kUnary[Range(0, sizeof(kUnary) - 2)];
+			node->children.push_back(Expression(depth - 1));
+			return node;
+		}
+		case 4:
+		{
+			Node* node = Make(Node::kTernary);
+			node->children.push_back(Expression(depth - 1));
+			node->children.push_back(Expression(depth - 1));
+			if (!Chance(3)) node->children.push_back(Expression(depth - 1));
+			return node;
+		}
+		case 5:
+			return Output(depth - 1);
+		case 6:
+			return Assign(Target(depth - 1), depth - 1);
+		default:
+		{
+			static const char* kBinary[] = { "+", "-", "*", "/", "%", "<<", ">>", "<", "<=", ">", ">=", "==", "!=", "&", "^", "|" };
+			const char* op = kBinary[Range(0, sizeof(kBinary) / sizeof(kBinary[0]) - 1)];
+			Node* node = Make(Node::kBinary);
+			node->op = op[0];
+			node->op2 = op[1];
+			node->children.push_back(Expression(depth - 1));
+			node->children.push_back(Expression(depth - 1));
+			return node;
+		}
+		}
+	}
+
+	static std::string Print(const Node* node)
+	{
+		char number[32];
+		switch (node->kind)
+		{
+		case Node::kNumber:
+			snprintf(number, sizeof(number), "%llu", (unsigned long long)node->value);
+			return number;
+
+		case Node::kVariable:
+			return std::string(1, node->op);
+
+		case Node::kUnary:
+		{
+			// operators can be chained and applied directly to numbers and variables, eg -~5 or $t
+			const Node* child = node->children[0];
+			const bool bare = child->kind == Node::kNumber || child->kind == Node::kVariable || child->kind == Node::kUnary;
+			return std::string(1, node->op) + (bare ? Print(child) : "(" + Print(child) + ")");
+		}
+
+		case Node::kBinary:
+		{
+			std::string op(1, node->op);
+			if (node->op2) op += node->op2;
+			return "(" + Print(node->children[0]) + ")" + op + "(" + Print(node->children[1]) + ")";
+		}
+
+		case Node::kTernary:
+		{
+			std::string text = "((" + Print(node->children[0]) + ") ? (" + Print(node->children[1]) + ")";
+			if (node->children.size() > 2) text += " : (" + Print(node->children[2]) + ")";
+			return text + ")";
+		}
+
+		case Node::kPeek:
+			return "@(" + Print(node->children[0]) + ")";
+
+		case Node::kGet:
+			return node->children.empty() ? "[*]" : "[" + Print(node->children[0]) + "]";
+
+		case Node::kAssign:
+		{
+			std::string text = Print(node->children[0]) + " = ";
+			if (node->op == '{')
+			{
+				text += "{";
+				for (size_t i = 1; i < node->children.size(); ++i)
+				{
+					text += (i > 1 ? ", " : "") + Print(node->children[i]);
+				}
+				text += "}";
+			}
+			else
+			{
+				text += Print(node->children[1]);
+			}
+			// assignments used as values need to be in parens, statements don't mind
+			return "(" + text + ")";
+		}
+
+		case Node::kBuiltin:
+		case Node::kCall:
+		{
+			std::string text = node->name + "(";
+			for (size_t i = 0; i < node->children.size(); ++i)
+			{
+				text += (i > 0 ? ", " : "") + Print(node->children[i]);
+			}
+			return text + ")";
+		}
+
+		case Node::kDefine:
+		{
+			std::string text = "def " + node->name + "(";
+			for (size_t i = 1; i < node->children.size(); ++i)
+			{
+				text += (i > 1 ? ", " : "") + Print(node->children[i]);
+			}
+			return text + ") = " + Print(node->children[0]);
+		}
+
+		case Node::kEvery:
+			return "every (" + Print(node->children[0]) + ") {\n" + PrintBlock(node, 1) + "}";
+
+		case Node::kRepeat:
+			snprintf(number, sizeof(number), "%llu", (unsigned long long)node->value);
+			return std::string("repeat ") + number + (node->op ? std::string(" (") + node->op + ")" : "") + " {\n" + PrintBlock(node, 0) + "}";
+		}
+
+		return "";
+	}
+
+	static std::string PrintBlock(const Node* node, size_t first)
+	{
+		std::string text;
+		for (size_t i = first; i < node->children.size(); ++i)
+		{
+			text += Print(node->children[i]) + ";\n";
+		}
+		return text;
+	}
+
+	std::mt19937_64 mRandom;
+	// deque so that pointers to nodes stay valid as more are added
+	std::deque<Node> mNodes;
+	std::vector<const Node*> mFunctions;
+	// the parameters of the function being defined
+	std::string mParams;
+};
+#pragma endregion
+
+#pragma region Model
+// evaluates the syntax tree the way the language is documented to work.
+// when a runtime error happens we stop evaluating, just like Program::Run does.
+class Model
+{
+public:
+	Model(Machine& machine) : m(machine) {}
+
+	void Run(const std::vector<const Node*>& statements)
+	{
+		m.error = Program::RE_NONE;
+		Context context;
+		std::fill(context.index, context.index + 26, -1);
+		context.function = nullptr;
+		context.call = nullptr;
+		context.caller = nullptr;
+		for (const Node* statement : statements)
+		{
+			Eval(statement, context);
+			if (m.error != Program::RE_NONE) return;
+		}
+	}
+
+private:
+	// what the variables are where something is evaluated, which is different in repeat blocks and in the bodies of functions
+	struct Context
+	{
+		// the iteration of the repeat block using each variable as its index, or -1 when it's a normal variable
+		int index[26];
+		// in the body of a function, its definition and the call, whose arguments are evaluated in the caller's context each time
+		// the parameter is used, like the compiler inlines them
+		const Node* function;
+		const Node* call;
+		const Context* caller;
+	};
+
+	bool Variable(char var, const Context& context, Value& v)
+	{
+		if (context.function != nullptr)
+		{
+			for (size_t i = 1; i < context.function->children.size(); ++i)
+			{
+				if (context.function->children[i]->op == var) return Eval(context.call->children[i - 1], *context.caller, &v);
+			}
+		}
+		v = context.index[var - 'a'] >= 0 ? (Value)context.index[var - 'a'] : m.Get(var);
+		return true;
+	}
+
+	// the address of the state of lpf, hpf, slew, and env, which is given as a variable or a peek
+	bool StateAddress(const Node* node, const Context& context, Value& address)
+	{
+		if (node->kind == Node::kVariable)
+		{
+			address = Program::GetAddress(node->op, kUserMemorySize);
+			return true;
+		}
+		return Eval(node->children[0], context, &address);
+	}
+
+	bool Statements(const Node* node, size_t first, const Context& context)
+	{
+		for (size_t i = first; i < node->children.size(); ++i)
+		{
+			if (!Eval(node->children[i], context)) return false;
+		}
+		return true;
+	}
+	bool Fault(Program::RuntimeError error)
+	{
+		m.error = error;
+		return false;
+	}
+
+	// returns false if evaluation stopped because of an error
+	bool Eval(const Node* node, const Context& context, Value* out = nullptr)
+	{
+		Value scratch;
+		Value& v = out ? *out : scratch;
+
+		switch (node->kind)
+		{
+		case Node::kNumber:
+			v = node->value;
+			return true;
+
+		case Node::kVariable:
+			return Variable(node->op, context, v);
+
+		case Node::kPeek:
+		{
+			Value a;
+			if (!Eval(node->children[0], context, &a)) return false;
+			v = m.Peek(a);
+			return true;
+		}
+
+		case Node::kGet:
+		{
+			Value a = (Value)-1;
+			if (!node->children.empty() && !Eval(node->children[0], context, &a)) return false;
+			if (a == (Value)-1)
+			{
+				v = 0;
+				for (size_t i = 0; i < kResultCount; ++i) v += m.results[i];
+			}
+			else if (a < kResultCount)
+			{
+				v = m.results[a];
+			}
+			else
+			{
+				return Fault(Program::RE_GET_OUT_OF_BOUNDS);
+			}
+			return true;
+		}
+
+		case Node::kUnary:
+		{
+			Value a;
+			if (!Eval(node->children[0], context, &a)) return false;
+			return Unary(node->op, a, v);
+		}
+
+		case Node::kBinary:
+		{
+			Value a, b;
+			if (!Eval(node->children[0], context, &a) || !Eval(node->children[1], context, &b)) return false;
+			return Binary(node->op, node->op2, a, b, v);
+		}
+
+		case Node::kTernary:
+		{
+			Value c;
+			if (!Eval(node->children[0], context, &c)) return false;
+			if (c) return Eval(node->children[1], context, &v);
+			if (node->children.size() > 2) return Eval(node->children[2], context, &v);
+			v = 0;
+			return true;
+		}
+
+		case Node::kAssign:
+			return Assign(node, context, v);
+
+		case Node::kBuiltin:
+		{
+			Value a, b, c;
+			const bool hasState = Generator::HasState(node->name);
+			if (!(hasState ? StateAddress(node->children[0], context, a) : Eval(node->children[0], context, &a))) return false;
+			if (!Eval(node->children[1], context, &b) || !Eval(node->children[2], context, &c)) return false;
+			return Builtin(node->name, a, b, c, v);
+		}
+
+		case Node::kCall:
+		{
+			Context body;
+			std::fill(body.index, body.index + 26, -1);
+			body.function = mFunctions[node->name];
+			body.call = node;
+			body.caller = &context;
+			return Eval(body.function->children[0], body, &v);
+		}
+
+		case Node::kDefine:
+			mFunctions[node->name] = node;
+			return true;
+
+		case Node::kEvery:
+		{
+			// t is read before the rate is evaluated
+			const Value t = m.Get('t');
+			Value rate;
+			if (!Eval(node->children[0], context, &rate)) return false;
+			if (rate == 0) return Fault(Program::RE_DIVIDE_BY_ZERO);
+			return t % rate != 0 || Statements(node, 1, context);
+		}
+
+		case Node::kRepeat:
+		{
+			Context block = context;
+			for (Value i = 0; i < node->value; ++i)
+			{
+				if (node->op) block.index[node->op - 'a'] = (int)i;
+				if (!Statements(node, 0, block)) return false;
+			}
+			return true;
+		}
+		}
+
+		return false;
+	}
+
+	bool Unary(char op, Value a, Value& v)
+	{
+		switch (op)
+		{
+		case '@': v = m.Peek(a); break;
+		case '+': v = a; break;
+		case '-': v = -a; break;
+		case '~': v = ~a; break;
+		case '!': v = !a; break;
+		case 'C': v = m.cc[a % Program::kCCSize]; break;
+		case 'V': v = m.vc[a % Program::kVCSize]; break;
+		case 'R':
+			if (a == 0) return Fault(Program::RE_DIVIDE_BY_ZERO);
+			v = m.rng() % a;
+			break;
+		case '$':
+		{
+			Value r = m.Get('w');
+			const Value hr = r / 2;
+			r += 1;
+			if (r == 0) return Fault(Program::RE_DIVIDE_BY_ZERO);
+			const double s = sin(2 * M_PI * ((double)(a%r) / r));
+			v = Value(s*hr + hr);
+		}
+		break;
+		case '#':
+		{
+			const Value r = m.Get('w');
+			if (r == 0) return Fault(Program::RE_DIVIDE_BY_ZERO);
+			v = a%r < r / 2 ? 0 : r - 1;
+		}
+		break;
+		case 'T':
+		{
+			a *= 2;
+			const Value r = m.Get('w');
+			if (r == 0) return Fault(Program::RE_DIVIDE_BY_ZERO);
+			v = a*((a / r) % 2) + (r - a - 1)*(1 - (a / r) % 2);
+		}
+		break;
+		case 'F':
+			v = a == 0 ? 0 : (Value)round(4.0 * 3.023625 * pow(2.0, (double)a / 12.0) * (44100.0 / m.Get('~')));
+			break;
+		}
+		return true;
+	}
+
+	bool Binary(char op, char op2, Value a, Value b, Value& v)
+	{
+		switch (op)
+		{
+		case '+': v = a + b; break;
+		case '-': v = a - b; break;
+		case '*': v = a * b; break;
+		case '/': if (!b) return Fault(Program::RE_DIVIDE_BY_ZERO); v = a / b; break;
+		case '%': if (!b) return Fault(Program::RE_DIVIDE_BY_ZERO); v = a % b; break;
+		case '&': v = a & b; break;
+		case '^': v = a ^ b; break;
+		case '|': v = a | b; break;
+		case '=': v = a == b; break;
+		case '!': v = a != b; break;
+		case '<': v = op2 == '<' ? a << (b % 64) : op2 == '=' ? a <= b : a < b; break;
+		case '>': v = op2 == '>' ? a >> (b % 64) : op2 == '=' ? a >= b : a > b; break;
+		}
+		return true;
+	}
+
+	bool Assign(const Node* node, const Context& context, Value& v)
+	{
+		const Node* target = node->children[0];
+		Value address = (Value)-1;
+		if (target->kind == Node::kVariable)
+		{
+			address = Program::GetAddress(target->op, kUserMemorySize);
+		}
+		else if (!target->children.empty() && !Eval(target->children[0], context, &address))
+		{
+			return false;
+		}
+
+		std::vector<Value> values;
+		for (size_t i = 1; i < node->children.size(); ++i)
+		{
+			Value value;
+			if (!Eval(node->children[i], context, &value)) return false;
+			values.push_back(value);
+		}
+
+		if (target->kind != Node::kGet)
+		{
+			for (size_t i = 0; i < values.size(); ++i)
+			{
+				m.Poke(address + i, values[i]);
+			}
+			v = m.Peek(address);
+		}
+		else if (address == (Value)-1)
+		{
+			// [*] repeats the last value to fill all of the outputs and evaluates to the sum
+			v = 0;
+			for (size_t i = 0; i < kResultCount; ++i)
+			{
+				m.results[i] = values[std::min(i, values.size() - 1)];
+				v += m.results[i];
+			}
+		}
+		else if (address < kResultCount)
+		{
+			for (size_t i = 0; i < values.size() && address + i < kResultCount; ++i)
+			{
+				m.results[address + i] = values[i];
+			}
+			v = values[0];
+		}
+		else
+		{
+			return Fault(Program::RE_PUT_OUT_OF_BOUNDS);
+		}
+		return true;
+	}
+
+	bool Builtin(const std::string& name, Value a, Value b, Value c, Value& v)
+	{
+		const Value t = m.Get('t');
+		if (name == "tap" || name == "rec")
+		{
+			// a ring buffer of b values at a, where t is the slot written now
+			if (b == 0) return Fault(Program::RE_DIVIDE_BY_ZERO);
+			if (name == "tap")
+			{
+				v = m.Peek(a + (t - c) % b);
+			}
+			else
+			{
+				m.Poke(a + t % b, c);
+				v = c;
+			}
+		}
+		else if (name == "copy" || name == "fill")
+		{
+			// every value is read before any is written, however the two ranges overlap
+			const Value count = std::min(name == "copy" ? c : b, (Value)kMemorySize);
+			std::vector<Value> values;
+			for (Value i = 0; i < count; ++i)
+			{
+				values.push_back(name == "copy" ? m.Peek(b % kMemorySize + i) : c);
+			}
+			for (Value i = 0; i < count; ++i)
+			{
+				m.Poke(a % kMemorySize + i, values[i]);
+			}
+			v = m.Peek(a);
+		}
+		else
+		{
+			Value& s = m.mem[a % kMemorySize];
+			if (name == "slew")
+			{
+				s = b > s ? s + std::min(b - s, c) : s - std::min(s - b, c);
+				v = s;
+			}
+			else if (name == "env")
+			{
+				s = b > s ? b : s - std::min(s - b, c);
+				v = s;
+			}
+			else
+			{
+				// the lowpass has 16 bits of fraction, so the input is clamped to 48 bits, and it moves c/256 of
+				// the way to the input, rounded towards the state
+				const Value input = std::min(b, ((Value)1 << 48) - 1);
+				const Value target = input << 16;
+				const Value rate = std::min(c, (Value)256);
+				const Value distance = target > s ? target - s : s - target;
+				const Value step = distance / 256 * rate + distance % 256 * rate / 256;
+				s = target > s ? s + step : s - step;
+				v = name == "lpf" ? s >> 16 : input - (s >> 16);
+			}
+		}
+		return true;
+	}
+
+	Machine& m;
+	// functions defined so far, by name
+	std::map<std::string, const Node*> mFunctions;
+};
+#pragma endregion
+
+// set up the program and the model with the same random inputs
+static void Randomize(std::mt19937_64& random, Program& program, Machine& machine, uint64_t seed)
+{
+	memset(machine.mem, 0, sizeof(machine.mem));
+	for (size_t i = 0; i < kMemorySize; ++i)
+	{
+		machine.mem[i] = program.Peek(i);
+	}
+
+	static const char kInputs[] = "tmqnvw";
+	for (const char* var = kInputs; *var; ++var)
+	{
+		const Value value = random() % 4 == 0 ? random() : random() % 100000;
+		program.Set(*var, value);
+		machine.mem[Program::GetAddress(*var, kUserMemorySize)] = value;
+	}
+
+	for (size_t i = 0; i < Program::kCCSize; ++i)
+	{
+		machine.cc[i] = random() % 128;
+		program.SetCC(i, machine.cc[i]);
+	}
+
+	for (size_t i = 0; i < Program::kVCSize; ++i)
+	{
+		machine.vc[i] = random() % 256;
+		program.SetVC(i, machine.vc[i]);
+	}
+
+	for (size_t i = 0; i < kResultCount; ++i)
+	{
+		machine.results[i] = random() % 65536;
+	}
+
+	program.SetRandomSeed(seed);
+	machine.rng.seed((std::default_random_engine::result_type)seed);
+}
+
+static bool Same(const Program& program, const Value* results, Program::RuntimeError error, const Machine& machine)
+{
+	if (error != machine.error || memcmp(results, machine.results, sizeof(machine.results)) != 0)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < kMemorySize; ++i)
+	{
+		if (program.Peek(i) != machine.mem[i]) return false;
+	}
+
+	return true;
+}
+
+// give both programs the same inputs, which IsEquivalentAt32Bits allows to be anything for the clocks and small for the rest,
+// and check that the low 32 bits of the outputs match.
+// memory isn't compared, because values that never reach an output are allowed to differ above the low 32 bits.
+static bool SameAt32Bits(std::mt19937_64& random, Program& wide, Program& narrow, const uint64_t seed)
+{
+	static const char kInputs[] = "tmqnvw";
+	for (const char* var = kInputs; *var; ++var)
+	{
+		const Value value = strchr("tmq", *var) != nullptr ? random() : random() % 0x80000000;
+		wide.Set(*var, value);
+		narrow.Set(*var, value);
+	}
+
+	for (size_t i = 0; i < Program::kCCSize; ++i)
+	{
+		const Value value = random() % 128;
+		wide.SetCC(i, value);
+		narrow.SetCC(i, value);
+	}
+
+	Value wideResults[kResultCount];
+	Value narrowResults[kResultCount];
+	for (size_t i = 0; i < kResultCount; ++i)
+	{
+		wideResults[i] = narrowResults[i] = random() % 65536;
+	}
+
+	wide.SetRandomSeed(seed);
+	narrow.SetRandomSeed(seed);
+	const Program::RuntimeError wideError = wide.Run(wideResults, kResultCount);
+	const Program::RuntimeError narrowError = narrow.Run(narrowResults, kResultCount);
+	for (size_t i = 0; i < kResultCount; ++i)
+	{
+		if ((uint32_t)wideResults[i] != (uint32_t)narrowResults[i]) return false;
+	}
+	return wideError == narrowError;
+}
+
+static void Report(const char* what, const std::string& source, const Value* results, Program::RuntimeError error, const Machine& machine)
+{
+	printf("\n%s\n----\n%s----\n", what, source.c_str());
+	printf("expected [0]=%llu [1]=%llu error=%s\n", (unsigned long long)machine.results[0], (unsigned long long)machine.results[1], Program::GetErrorString(machine.error));
+	printf("actual   [0]=%llu [1]=%llu error=%s\n", (unsigned long long)results[0], (unsigned long long)results[1], Program::GetErrorString(error));
+}
+
+// run the interpreted and the generated program with the same inputs, and check that everything they can change is the same
+static bool SameGenerated(const uint64_t runSeed, Program& interpreted, Program& generated)
+{
+	static Machine machine;
+	Value results[2][kResultCount];
+	Program::RuntimeError errors[2];
+	Program* programs[2] = { &interpreted, &generated };
+	for (int k = 0; k < 2; ++k)
+	{
+		std::mt19937_64 inputs(runSeed);
+		Randomize(inputs, *programs[k], machine, runSeed);
+		memcpy(results[k], machine.results, sizeof(results[k]));
+		errors[k] = programs[k]->Run(results[k], kResultCount);
+	}
+
+	if (errors[0] != errors[1] || memcmp(results[0], results[1], sizeof(results[0])) != 0) return false;
+	for (size_t i = 0; i < kMemorySize; ++i)
+	{
+		if (interpreted.Peek(i) != generated.Peek(i)) return false;
+	}
+	for (int e = Program::RE_NONE; e < Program::RE_COUNT; ++e)
+	{
+		const Program::RuntimeError error = (Program::RuntimeError)e;
+		if (interpreted.GetErrorCount(error) != generated.GetErrorCount(error) || interpreted.GetErrorLine(error) != generated.GetErrorLine(error)) return false;
+	}
+	return true;
+}
+
+static int FuzzGenerated(Generator& generator, std::mt19937_64& random, const int count, const bool verbose)
+{
+	static const char* kLibraryPath = "fuzz.so";
+
+	// every program that narrows is generated twice, once for each width
+	std::vector<std::string> sources;
+	std::vector<Program*> programs;
+	std::string source;
+	int failures = 0;
+	for (int p = 0; p < count; ++p)
+	{
+		sources.push_back(Generator::Print(generator.Program()));
+		if (verbose)
+		{
+			printf("----\n%s", sources.back().c_str());
+		}
+
+		Program::CompileError error;
+		int errorPosition;
+		for (Program::ValueWidth width : { Program::VW_64, Program::VW_32 })
+		{
+			Program* program = Program::Compile(sources.back().c_str(), kUserMemorySize, error, errorPosition, width);
+			if (error != Program::CE_NONE || (width == Program::VW_32 && !program->IsEquivalentAt32Bits()))
+			{
+				delete program;
+				program = nullptr;
+			}
+
+			char name[64];
+			snprintf(name, sizeof(name), "fuzz_program_%d_%d", p, width == Program::VW_32 ? 32 : 64);
+			const std::string generated = program != nullptr ? program->GenerateSource(name) : std::string();
+			if (program != nullptr && generated.empty())
+			{
+				printf("\nprogram %d couldn't be generated\n----\n%s----\n", p, sources.back().c_str());
+				++failures;
+			}
+			source += generated;
+			programs.push_back(program);
+		}
+	}
+
+	std::string error;
+	if (!GeneratedProgram::Build(source, kLibraryPath, error))
+	{
+		printf("couldn't build %s:\n%s\n", kLibraryPath, error.c_str());
+		return 1;
+	}
+
+	int narrowed = 0;
+	for (size_t i = 0; i < programs.size() && failures < 10; ++i)
+	{
+		Program* interpreted = programs[i];
+		if (interpreted == nullptr) continue;
+
+		const int bits = interpreted->GetValueWidth() == Program::VW_32 ? 32 : 64;
+		narrowed += bits == 32;
+		char name[64];
+		snprintf(name, sizeof(name), "fuzz_program_%d_%d", (int)(i / 2), bits);
+		Program::GeneratedFunction function = GeneratedProgram::Load(kLibraryPath, name, error);
+		if (function == nullptr)
+		{
+			printf("%s\n", error.c_str());
+			return 1;
+		}
+
+		Program* generated = GeneratedProgram::Create(*interpreted, function);
+		for (int r = 0; r < kRunsPerProgram; ++r)
+		{
+			if (!SameGenerated(random(), *interpreted, *generated))
+			{
+				printf("\ngenerated code with %d-bit values doesn't match the interpreter\n----\n%s----\n", bits, sources[i / 2].c_str());
+				++failures;
+				break;
+			}
+		}
+		delete generated;
+	}
+
+	for (Program* program : programs) delete program;
+	printf("%d failures (%d programs also generated with 32-bit values)\n", failures, narrowed);
+	return failures > 0 ? 1 : 0;
+}
+
+int main(int argc, const char * argv[])
+{
+	int count = 10000;
+	uint64_t seed = (uint64_t)std::chrono::system_clock::now().time_since_epoch().count();
+	bool verbose = false;
+	bool generate = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 0);
+		else if (strcmp(argv[i], "-v") == 0) verbose = true;
+		else if (strcmp(argv[i], "-g") == 0) generate = true;
+	}
+
+	printf("fuzzing %d programs with seed %llu\n", count, (unsigned long long)seed);
+
+	Generator generator(seed);
+	std::mt19937_64 random((std::mt19937_64::result_type)seed);
+	if (generate)
+	{
+		return FuzzGenerated(generator, random, count, verbose);
+	}
+	static Machine machine;
+	static Machine engineMachine;
+	int failures = 0;
+	int faults = 0;
+	int narrowed = 0;
+	for (int p = 0; p < count && failures < 10; ++p)
+	{
+		const std::vector<const Node*> statements = generator.Program();
+		const std::string source = Generator::Print(statements);
+		if (verbose)
+		{
+			printf("----\n%s", source.c_str());
+		}
+
+		Program::CompileError error;
+		int errorPosition;
+		Program* reference = Program::Compile(source.c_str(), kUserMemorySize, error, errorPosition);
+		if (error != Program::CE_NONE)
+		{
+			printf("\nprogram %d failed to compile: %s at %d\n----\n%s----\n", p, Program::GetErrorString(error), errorPosition, source.c_str());
+			++failures;
+			continue;
+		}
+
+		std::vector<Program*> engines;
+		for (int e = 1; e < kEngineCount; ++e)
+		{
+			engines.push_back(Program::Compile(source.c_str(), kUserMemorySize, error, errorPosition));
+		}
+
+		Program* wide = nullptr;
+		Program* narrow = nullptr;
+		if (reference->IsEquivalentAt32Bits())
+		{
+			wide = Program::Compile(source.c_str(), kUserMemorySize, error, errorPosition, Program::VW_64);
+			narrow = Program::Compile(source.c_str(), kUserMemorySize, error, errorPosition, Program::VW_32);
+			++narrowed;
+		}
+
+		// run several times so that values left in memory by one run feed into the next
+		for (int r = 0; r < kRunsPerProgram; ++r)
+		{
+			const uint64_t runSeed = random();
+			std::mt19937_64 inputs(runSeed);
+			Randomize(inputs, *reference, machine, runSeed);
+			Value results[kResultCount];
+			memcpy(results, machine.results, sizeof(results));
+
+			Model(machine).Run(statements);
+			const Program::RuntimeError runError = kEngines[0].run(*reference, results, kResultCount);
+			faults += runError != Program::RE_NONE;
+			if (!Same(*reference, results, runError, machine))
+			{
+				Report("reference doesn't match the model", source, results, runError, machine);
+				++failures;
+				break;
+			}
+
+			for (int e = 1; e < kEngineCount; ++e)
+			{
+				std::mt19937_64 engineInputs(runSeed);
+				Randomize(engineInputs, *engines[e - 1], engineMachine, runSeed);
+				Value engineResults[kResultCount];
+				memcpy(engineResults, engineMachine.results, sizeof(engineResults));
+				const Program::RuntimeError engineError = kEngines[e].run(*engines[e - 1], engineResults, kResultCount);
+				if (!Same(*engines[e - 1], engineResults, engineError, machine))
+				{
+					Report(kEngines[e].name, source, engineResults, engineError, machine);
+					++failures;
+				}
+			}
+
+			if (narrow != nullptr)
+			{
+				std::mt19937_64 narrowInputs(runSeed);
+				if (!SameAt32Bits(narrowInputs, *wide, *narrow, runSeed))
+				{
+					printf("\n32-bit values don't match 64-bit values\n----\n%s----\n", source.c_str());
+					++failures;
+					break;
+				}
+			}
+		}
+
+		delete wide;
+		delete narrow;
+		for (Program* engine : engines) delete engine;
+		delete reference;
+	}
+
+	printf("%d failures (%d runs ended with a runtime error, %d programs also ran with 32-bit values)\n", failures, faults, narrowed);
+	return failures > 0 ? 1 : 0;
+}
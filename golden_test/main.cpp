@@ -0,0 +1,458 @@
+//
+//  main.cpp
+//  golden_test
+//
+//  Renders every preset and every program in corpus.txt with each execution engine
+//  and checks that the output is bit-exact with the hashes in golden.txt,
+//  which were made with the reference interpreter. The native engine runs the presets (and a few corpus programs) that have been written
+//  with ProgramDSL.h below instead, and is skipped for everything else. With -g every program is also turned into
+//  C++ with Program::GenerateSource, built with the system compiler, and run by the generated engine. Also reports how much faster each engine is
+//  than the reference for every program. Build and run it from this directory with something like:
+//
+//    c++ -std=c++11 -O2 -o golden_test main.cpp ../Program.cpp ../Presets.cpp ../GeneratedProgram.cpp -ldl && ./golden_test
+//
+//  usage: golden_test [-s seconds] [-u] [-g]
+//    -s  how many seconds of audio to render for each program (default 5)
+//    -u  rewrite golden.txt with the output of the reference interpreter
+//    -g  build every program into generated.so and run it with the generated engine
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "../Params.h"
+#include "../Presets.h"
+#include "../GeneratedProgram.h"
+#include "../Program.h"
+#include "../ProgramDSL.h"
+
+static const char* kGoldenPath = "golden.txt";
+static const char* kCorpusPath = "corpus.txt";
+static const double kSampleRate = 44100;
+static const double kBeatsPerMinute = 120;
+
+struct TestProgram
+{
+	std::string name;
+	std::string source;
+	int bitDepth;
+	int vc[Program::kVCSize];
+};
+
+// a way of compiling and running a program. the first one is the reference that all others are compared to.
+// compile returns nullptr when the program doesn't compile, or when a partial engine doesn't have a version of it.
+struct Engine
+{
+	const char* name;
+	bool partial;
+	Program* (*compile)(const TestProgram& test);
+	Program::RuntimeError (*run)(Program& program, Program::Value* results, const size_t size);
+};
+
+static const size_t kMemorySize = 1024 * 64;
+
+static Program* Compile(const TestProgram& test, const Program::ValueWidth width)
+{
+	Program::CompileError error;
+	int errorPosition;
+	Program* program = Program::Compile(test.source.c_str(), kMemorySize, error, errorPosition, width);
+	if (error != Program::CE_NONE)
+	{
+		delete program;
+		return nullptr;
+	}
+	return program;
+}
+
+static Program* CompileReference(const TestProgram& test)
+{
+	return Compile(test, Program::VW_64);
+}
+
+static Program* CompileAuto(const TestProgram& test)
+{
+	return Compile(test, Program::VW_AUTO);
+}
+
+// the presets written in C++, which should be bit-exact with the source
+namespace Native
+{
+	using namespace DSL;
+
+	struct Preset
+	{
+		const char* name;
+		Program* (*compile)();
+	};
+
+	static const Preset kPresets[] =
+	{
+		{ "the sierpinsky harmony", []{ return DSL::Compile(program(t = t/5, put(all, t & (t >> 8))), kMemorySize); } },
+		{ "the forty-two melody", []{ return DSL::Compile(program(t = t/5, put(all, t*(42 & (t >> 10)))), kMemorySize); } },
+		{ "visy's tune", []{ return DSL::Compile(program(t = t/5, put(all, t*(((t >> 9) | (t >> 13)) & 25 & (t >> 6)))), kMemorySize); } },
+		{ "little ditty", []{ return DSL::Compile(program(a = t*128 + sine(t), b = t >> (t % (8*w)) / w, c = t >> 128, put(all, a | b | c)), kMemorySize); } },
+		{ "overtone waterfall", []{ return DSL::Compile(program(a = t*128, b = a*(32 - (m/50) % 32), c = a*((m/100) % 64), put(all, a | b | c)), kMemorySize); } },
+		{ "aggressive texture", []{ return DSL::Compile(program(s = sine(m/2000), a = sine(t ^ s), put(all, (t*64 + a*s) | t*32)), kMemorySize); } },
+		{ "blurp", []{ return DSL::Compile(program(a = t << t/(1024*8), b = t >> t/16, c = t >> t/32, e = (a | (b & c)), d = t % (t/512 + 1) + 1, put(all, e/d*32)), kMemorySize); } },
+		{ "garbage trash", []{ return DSL::Compile(program(r = m/(vc(0) + 1), s = r % 16, put(all, (256*s + t*s % (512*s + 1))*r)), kMemorySize); } },
+		{ "nonsense can", []{ return DSL::Compile(program(a = 1 + sine(m) % 32, b = t*128 & t*64 & t*32, c = (p/16) << p % 4, d = sine(p/128) >> p % 4, p = (a ^ b) | c | d, put(all, p)), kMemorySize); } },
+		{ "oink oink ribbit", []{ return DSL::Compile(program(o = t*128, a = t*vc(0) >> vc(1), b = t - vc(2)*100, c = b*64 | b*vc(3) >> vc(4), p = (o | a) | c | p << 12, put(all, p)), kMemorySize); } },
+		{ "moving average", []{ return DSL::Compile(program(x = t + 1, f = x*256 ^ (x*64 & x*32), p = p + (f - p)/x, put(all, p)), kMemorySize); } },
+		{ "stereo ellipse", []{ return DSL::Compile(program(a = vc(0) + 1, b = vc(1) + 1, c = sine((t + w/2)*128), s = sine(t*128), put(0, a*c), put(1, b*s)), kMemorySize); } },
+		{ "sample and hold effect", []{ return DSL::Compile(program(s = vc(0) + 2, r = (p == 0) & (p < t % s), p = t % s, when(r, a = out(0)), when(r, b = out(1)), put(0, a), put(1, b)), kMemorySize); } },
+		{ "saw wave", []{ return DSL::Compile(put(all, t*freq(n)), kMemorySize); } },
+		{ "square wave", []{ return DSL::Compile(put(all, square(t*freq(n))), kMemorySize); } },
+		{ "sine wave", []{ return DSL::Compile(put(all, sine(t*freq(n))), kMemorySize); } },
+		{ "triangle wave", []{ return DSL::Compile(put(all, triangle(t*freq(n))), kMemorySize); } },
+		{ "pulse wave", []{ return DSL::Compile(program(a = (t*freq(n)) % w, b = a < 8800, put(all, (w - 1)*b)), kMemorySize); } },
+		{ "ternary arp", []{ return DSL::Compile(program(s = q/32, a = n + when(s % 2, 12, 0), put(all, t*freq(a))), kMemorySize); } },
+		{ "frequency modulation", []{ return DSL::Compile(put(all, t*freq(n) + sine(t*vc(0))), kMemorySize); } },
+		{ "amplitude modulation", []{ return DSL::Compile(program(o = (t*freq(n)) % w, when(m % 8 == 0, p = p + vc(0)*2), when(n == 0, p = 3*w/4), m = sine(p), o = o*m/w, put(all, o + ((w/2) - (w/2)*m/w))), kMemorySize); } },
+		{ "midi pitch sweep", []{ return DSL::Compile(program(a = freq(n) + (freq(n + 12) - freq(n))*cc(1)/127, o = when(n > 0, o + a, w/2), put(all, o)), kMemorySize); } },
+		{ "computer music", []{ return DSL::Compile(program(r = 125, when((p == 0) & (p < m % r), a = rnd(22)), p = m % r, put(all, sine(t*freq(n + a)))), kMemorySize); } },
+		{ "rhythmic glitch sine", []{ return DSL::Compile(program(c = 1024*4, s = t % c, r = (t + 512) % c, poke(at(s), when(n > 0, sine(t*freq(n)) + at(r), w/2)), put(all, at(s))), kMemorySize); } },
+		{ "memory sequence", []{ return DSL::Compile(program(poke(at(0), 0, 4, 7, 12), i = q/32 % 4, put(all, when(n > 0, t*freq(n + at(i)), w/2))), kMemorySize); } },
+		// from corpus.txt, for filters with inputs far beyond 32 bits
+		{ "huge filters", []{ return DSL::Compile(program(put(0, lpf(a, t*t*t, 8) + hpf(b, t*t*t*t, 200)), put(1, lpf(c, ~t*977, 256) + hpf(d, t << 40, 3))), kMemorySize); } },
+	};
+}
+
+// filled in by BuildGenerated when running with -g
+static std::map<std::string, Program::GeneratedFunction> gGenerated;
+static const char* kGeneratedPath = "generated.so";
+
+static Program* CompileGenerated(const TestProgram& test)
+{
+	const auto generated = gGenerated.find(test.name);
+	Program* program = Compile(test, Program::VW_64);
+	if (generated == gGenerated.end() || program == nullptr)
+	{
+		delete program;
+		return nullptr;
+	}
+
+	Program* result = GeneratedProgram::Create(*program, generated->second);
+	delete program;
+	return result;
+}
+
+// generate the source for every program that compiles and build all of them into one library
+static bool BuildGenerated(const std::vector<TestProgram>& programs)
+{
+	std::string source;
+	std::vector<std::string> names(programs.size());
+	for (size_t i = 0; i < programs.size(); ++i)
+	{
+		Program* program = Compile(programs[i], Program::VW_64);
+		if (program == nullptr)
+		{
+			continue;
+		}
+
+		char name[64];
+		snprintf(name, sizeof(name), "golden_program_%zu", i);
+		const std::string generated = program->GenerateSource(name);
+		if (!generated.empty())
+		{
+			source += generated;
+			names[i] = name;
+		}
+		delete program;
+	}
+
+	std::string error;
+	const auto start = std::chrono::steady_clock::now();
+	if (!GeneratedProgram::Build(source, kGeneratedPath, error))
+	{
+		printf("couldn't build %s:\n%s\n", kGeneratedPath, error.c_str());
+		return false;
+	}
+	printf("built %s in %.1fs\n\n", kGeneratedPath, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+	for (size_t i = 0; i < programs.size(); ++i)
+	{
+		if (names[i].empty())
+		{
+			continue;
+		}
+
+		Program::GeneratedFunction function = GeneratedProgram::Load(kGeneratedPath, names[i].c_str(), error);
+		if (function == nullptr)
+		{
+			printf("%s\n", error.c_str());
+			return false;
+		}
+		gGenerated[programs[i].name] = function;
+	}
+	return true;
+}
+
+static Program* CompileNative(const TestProgram& test)
+{
+	for (const Native::Preset& preset : Native::kPresets)
+	{
+		if (test.name == preset.name)
+		{
+			return preset.compile();
+		}
+	}
+	return nullptr;
+}
+
+static Program::RuntimeError RunReference(Program& program, Program::Value* results, const size_t size)
+{
+	return program.Run(results, size);
+}
+
+static const Engine kEngines[] =
+{
+	{ "reference", false, CompileReference, RunReference },
+	// 32-bit values for the programs that are proven to sound the same with them
+	{ "auto", false, CompileAuto, RunReference },
+	{ "native", true, CompileNative, RunReference },
+	// only has programs with -g
+	{ "generated", true, CompileGenerated, RunReference },
+};
+static const int kEngineCount = sizeof(kEngines) / sizeof(Engine);
+
+struct Render
+{
+	bool compiled;
+	uint64_t hash;
+	double seconds;
+};
+
+// render the program the same way the plugin would with the transport running, no audio input,
+// and a single note held down, and hash what would be sent to the outputs.
+static Render RenderProgram(const TestProgram& test, const Engine& engine, const int frameCount)
+{
+	Render render = { false, 14695981039346656037ULL, 0 };
+
+	Program* program = engine.compile(test);
+	if (program == nullptr)
+	{
+		return render;
+	}
+	render.compiled = true;
+
+	const Program::Value range = (Program::Value)1 << test.bitDepth;
+	const double mdenom = kSampleRate / 1000.0;
+	const double qdenom = (kSampleRate / (kBeatsPerMinute / 60.0)) / 128.0;
+	program->SetRandomSeed(1);
+	program->Set('w', range);
+	program->Set('~', (Program::Value)kSampleRate);
+	program->Set('n', 60);
+	program->Set('v', 100);
+	for (size_t i = 0; i < Program::kVCSize; ++i)
+	{
+		program->SetVC(i, test.vc[i]);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	Program::Value results[2];
+	for (Program::Value t = 0; t < (Program::Value)frameCount; ++t)
+	{
+		program->Set('t', t);
+		program->Set('m', (Program::Value)round(t / mdenom));
+		program->Set('q', (Program::Value)round(t / qdenom));
+		results[0] = results[1] = range / 2;
+		engine.run(*program, results, 2);
+
+		for (int c = 0; c < 2; ++c)
+		{
+			const Program::Value sample = results[c] % range;
+			for (size_t b = 0; b < sizeof(sample); ++b)
+			{
+				render.hash ^= (sample >> (b * 8)) & 0xff;
+				render.hash *= 1099511628211ULL;
+			}
+		}
+	}
+	render.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	delete program;
+	return render;
+}
+
+static void AddPresets(std::vector<TestProgram>& programs)
+{
+	for (int i = 0; i < Presets::Count(); ++i)
+	{
+		const Presets::Data& preset = Presets::Get(i);
+		TestProgram test;
+		test.name = preset.name;
+		test.source = preset.program;
+		test.bitDepth = preset.bitDepth;
+		const int* vc = &preset.V0;
+		for (size_t v = 0; v < Program::kVCSize; ++v)
+		{
+			test.vc[v] = vc[v];
+		}
+		programs.push_back(test);
+	}
+}
+
+static bool AddCorpus(std::vector<TestProgram>& programs)
+{
+	std::ifstream file(kCorpusPath);
+	if (!file)
+	{
+		printf("couldn't read %s, run this from the golden_test directory\n", kCorpusPath);
+		return false;
+	}
+
+	std::string line;
+	TestProgram* test = nullptr;
+	while (std::getline(file, line))
+	{
+		if (line.compare(0, 3, "===") == 0)
+		{
+			programs.push_back(TestProgram());
+			test = &programs.back();
+			test->name = line.substr(line.find_first_not_of("= "));
+			test->bitDepth = 16;
+			for (size_t v = 0; v < Program::kVCSize; ++v)
+			{
+				test->vc[v] = (int)v;
+			}
+		}
+		else if (test != nullptr)
+		{
+			test->source += line + "\n";
+		}
+	}
+
+	return true;
+}
+
+static std::map<std::string, uint64_t> ReadGolden()
+{
+	std::map<std::string, uint64_t> golden;
+	std::ifstream file(kGoldenPath);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const size_t space = line.find(' ');
+		if (space != std::string::npos)
+		{
+			golden[line.substr(space + 1)] = strtoull(line.substr(0, space).c_str(), nullptr, 16);
+		}
+	}
+	return golden;
+}
+
+int main(int argc, const char * argv[])
+{
+	double seconds = 5;
+	bool update = false;
+	bool generate = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+		{
+			seconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-u") == 0)
+		{
+			update = true;
+		}
+		else if (strcmp(argv[i], "-g") == 0)
+		{
+			generate = true;
+		}
+	}
+
+	std::vector<TestProgram> programs;
+	AddPresets(programs);
+	if (!AddCorpus(programs))
+	{
+		return 1;
+	}
+	if (generate && !BuildGenerated(programs))
+	{
+		return 1;
+	}
+
+	const int frameCount = (int)(seconds * kSampleRate);
+	std::map<std::string, uint64_t> golden = ReadGolden();
+	int failures = 0;
+
+	printf("%-28s", "program");
+	for (int e = 0; e < kEngineCount; ++e)
+	{
+		printf(" %12s", kEngines[e].name);
+	}
+	printf("\n");
+
+	for (const TestProgram& test : programs)
+	{
+		printf("%-28s", test.name.c_str());
+		double referenceSeconds = 0;
+		for (int e = 0; e < kEngineCount; ++e)
+		{
+			const Render render = RenderProgram(test, kEngines[e], frameCount);
+			if (!render.compiled && kEngines[e].partial)
+			{
+				printf(" %12s", "-");
+				continue;
+			}
+
+			if (!render.compiled)
+			{
+				printf(" %12s", "COMPILE ERR");
+				++failures;
+				break;
+			}
+
+			if (e == 0)
+			{
+				referenceSeconds = render.seconds;
+				if (update)
+				{
+					golden[test.name] = render.hash;
+				}
+			}
+
+			const auto expected = golden.find(test.name);
+			if (expected == golden.end() || expected->second != render.hash)
+			{
+				printf(" %12s", expected == golden.end() ? "NO GOLDEN" : "MISMATCH");
+				++failures;
+			}
+			else if (e == 0)
+			{
+				printf(" %10.1fms", render.seconds * 1000);
+			}
+			else
+			{
+				printf(" %11.2fx", render.seconds > 0 ? referenceSeconds / render.seconds : 0);
+			}
+		}
+		printf("\n");
+	}
+
+	if (update)
+	{
+		FILE* file = fopen(kGoldenPath, "w");
+		if (file == nullptr)
+		{
+			printf("couldn't write %s\n", kGoldenPath);
+			return 1;
+		}
+		fprintf(file, "# hash of %g seconds of reference interpreter output for each program, made by golden_test -u\n", seconds);
+		for (const auto& entry : golden)
+		{
+			fprintf(file, "%016llx %s\n", (unsigned long long)entry.second, entry.first.c_str());
+		}
+		fclose(file);
+	}
+
+	printf("\n%d programs, %d engines, %d failures\n", (int)programs.size(), kEngineCount, failures);
+	return failures > 0 ? 1 : 0;
+}
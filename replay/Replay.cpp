@@ -0,0 +1,115 @@
+//
+//  Replay.cpp
+//  replay
+//
+
+#include "Replay.h"
+#include "../RealtimeCheck.h"
+#include <chrono>
+
+bool Replay(const char* path, Stats& stats)
+{
+	Recording::Reader reader;
+	if (!reader.Open(path))
+	{
+		printf("%s is not a recording\n", path);
+		return false;
+	}
+
+	Engine engine;
+	std::vector<double> inputs[2];
+	std::vector<double> outputs[2];
+	std::vector<Recording::MidiEvent> midi;
+	Recording::RecordType type;
+	while (reader.Read(type))
+	{
+		switch (type)
+		{
+		case Recording::kRecordProgram:
+		{
+			int32_t memorySize;
+			uint64_t seed;
+			uint32_t length;
+			if (!reader.Read(memorySize) || !reader.Read(seed) || !reader.Read(length)) return false;
+			std::string text(length, '\0');
+			if (!reader.Read(&text[0], length)) return false;
+			engine.Compile(text, memorySize, seed);
+		}
+		break;
+
+		case Recording::kRecordParam:
+		{
+			int32_t paramIdx;
+			double value;
+			if (!reader.Read(paramIdx) || !reader.Read(value)) return false;
+			engine.OnParamChange(paramIdx, value);
+		}
+		break;
+
+		case Recording::kRecordState:
+			if (!engine.RestoreState(reader)) return false;
+			break;
+
+		case Recording::kRecordBlock:
+		{
+			Recording::BlockInfo block;
+			if (!reader.Read(block)) return false;
+			for (int c = 0; c < 2; ++c)
+			{
+				inputs[c].resize(block.frameCount);
+				outputs[c].resize(block.frameCount);
+				if (block.hasInput && !reader.Read(inputs[c].data(), sizeof(double) * block.frameCount)) return false;
+			}
+
+			if (!reader.AtEnd() && reader.Peek() == Recording::kRecordBus && (!reader.Read(type) || !engine.ReadBus(reader))) return false;
+
+			// midi events handled during the block were recorded after it
+			midi.clear();
+			Recording::MidiEvent event;
+			while (!reader.AtEnd() && reader.Peek() == Recording::kRecordMidi && reader.Read(type) && reader.Read(event))
+			{
+				midi.push_back(event);
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			{
+				RealtimeCheck::Scope realtime;
+				engine.ProcessDoubleReplacing(block, inputs[0].data(), inputs[1].data(), midi, outputs[0].data(), outputs[1].data());
+			}
+			const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			const double audioSeconds = block.frameCount / block.sampleRate;
+			stats.blocks += 1;
+			stats.samples += block.frameCount;
+			stats.seconds += elapsed;
+			stats.audioSeconds += audioSeconds;
+			if (audioSeconds > 0 && elapsed / audioSeconds > stats.maxLoad)
+			{
+				stats.maxLoad = elapsed / audioSeconds;
+			}
+		}
+		break;
+
+		case Recording::kRecordOutput:
+		{
+			uint64_t hash;
+			if (!reader.Read(hash)) return false;
+			if (hash != Recording::HashOutput(outputs[0].data(), outputs[1].data(), (int)outputs[0].size()))
+			{
+				if (stats.mismatches == 0)
+				{
+					printf("block %d doesn't match the recording\n", stats.blocks);
+				}
+				stats.mismatches += 1;
+			}
+		}
+		break;
+
+		default:
+			printf("unknown record type %d\n", type);
+			return false;
+		}
+	}
+
+	return true;
+}
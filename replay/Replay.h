@@ -0,0 +1,342 @@
+//
+//  Replay.h
+//  replay
+//
+//  The part of the replay tool that plays a recording back, which replay_test also uses.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../MemoryBus.h"
+#include "../Params.h"
+#include "../Program.h"
+#include "../Recording.h"
+
+// the parts of Evaluator that determine the output.
+// the methods here do the same thing as the Evaluator methods they are named after,
+// so if one of those changes, this needs to change too.
+class Engine
+{
+public:
+	Engine()
+		: mProgram(nullptr)
+		, mProgramSeed(0)
+		, mProgramMemorySize(0)
+		, mProgramIsValid(false)
+		, mTransport(kTransportPlaying)
+		, mGain(1.)
+		, mBitDepth(15)
+		, mRunMode(kRunModeAlways)
+		, mMidiNoteResetsTick(false)
+		, mTick(0)
+		, mBusIsPending(false)
+	{
+		memset(mParams, 0, sizeof(mParams));
+		memset(mBus, 0, sizeof(mBus));
+		mNotes.reserve(128);
+	}
+
+	~Engine()
+	{
+		delete mProgram;
+	}
+
+	// replay_test drives an Engine the way the plugin drives itself, to make recordings that it then replays
+	Program* GetProgram() const { return mProgram; }
+	Program::Value GetTick() const { return mTick; }
+
+	void Compile(const std::string& text, int memorySize, uint64_t seed)
+	{
+		delete mProgram;
+
+		Program::CompileError error;
+		int errorPosition;
+		mProgramText = text;
+		mProgramSeed = seed;
+		mProgramMemorySize = memorySize;
+		mProgram = Program::Compile(text.c_str(), mProgramMemorySize, error, errorPosition, (Program::ValueWidth)(int)mParams[kValueWidth]);
+		mProgramIsValid = error == Program::CE_NONE;
+		if (!mProgramIsValid)
+		{
+			mProgram = Program::Compile("[*] = w/2", 0, error, errorPosition);
+		}
+
+		mTick = 0;
+		if (mProgramIsValid)
+		{
+			for (int paramIdx = kVControl0; paramIdx <= kVControl7; ++paramIdx)
+			{
+				mProgram->SetVC(paramIdx - kVControl0, (Program::Value)mParams[paramIdx]);
+			}
+		}
+		mProgram->SetRandomSeed(seed);
+	}
+
+	void OnParamChange(int paramIdx, double value)
+	{
+		if (paramIdx >= 0 && paramIdx < kNumParams)
+		{
+			mParams[paramIdx] = value;
+		}
+
+		switch (paramIdx)
+		{
+		case kGain:
+			mGain = value / 100.;
+			break;
+
+		case kBitDepth:
+			mBitDepth = (int)value;
+			break;
+
+		case kRunMode:
+			mRunMode = (RunMode)(int)value;
+			break;
+
+		case kMidiNoteResetsTime:
+			mMidiNoteResetsTick = value >= 0.5;
+			break;
+
+		// the plugin compiles the program again, and records it, but recordings used to start with the program
+		// before the parameters, so this can't wait for that
+		case kValueWidth:
+			if (mProgram != nullptr)
+			{
+				Compile(std::string(mProgramText), mProgramMemorySize, mProgramSeed);
+			}
+			break;
+
+		case kTransportState:
+		{
+			const TransportState newState = (TransportState)(int)value;
+			if (newState == kTransportStopped || (newState == kTransportPlaying && mTransport != kTransportPaused))
+			{
+				mTick = 0;
+			}
+			mTransport = newState;
+		}
+		break;
+
+		default:
+			if (paramIdx >= kVControl0 && paramIdx <= kVControl7 && mProgramIsValid)
+			{
+				mProgram->SetVC(paramIdx - kVControl0, (Program::Value)value);
+			}
+			break;
+		}
+	}
+
+	bool RestoreState(Recording::Reader& reader)
+	{
+		uint64_t seed;
+		uint32_t memorySize;
+		if (!reader.Read(mTick) || !reader.Read(seed) || !reader.Read(memorySize))
+		{
+			return false;
+		}
+
+		mProgram->SetRandomSeed(seed);
+		for (uint32_t i = 0; i < memorySize; ++i)
+		{
+			Program::Value value;
+			if (!reader.Read(value)) return false;
+			mProgram->Poke(i, value);
+		}
+
+		for (size_t i = 0; i < Program::kCCSize; ++i)
+		{
+			Program::Value value;
+			if (!reader.Read(value)) return false;
+			mProgram->SetCC(i, value);
+		}
+
+		uint32_t noteCount;
+		if (!reader.Read(noteCount)) return false;
+		mNotes.resize(noteCount);
+		for (uint32_t i = 0; i < noteCount; ++i)
+		{
+			if (!reader.Read(mNotes[i].number) || !reader.Read(mNotes[i].velocity)) return false;
+		}
+
+		return true;
+	}
+
+	// what the other instances had put on the bus when the next block started, instead of reading MemoryBus
+	bool ReadBus(Recording::Reader& reader)
+	{
+		uint32_t count;
+		if (!reader.Read(count)) return false;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t index;
+			Program::Value value;
+			if (!reader.Read(index) || !reader.Read(value) || index >= MemoryBus::kSize) return false;
+			mBus[index] = value;
+		}
+		mBusIsPending = true;
+		return true;
+	}
+
+	void ProcessDoubleReplacing(const Recording::BlockInfo& block, const double* in1, const double* in2,
+								const std::vector<Recording::MidiEvent>& midi, double* out1, double* out2)
+	{
+		// the same values that MemoryBus::Port::Read copied in for the plugin
+		if (mBusIsPending)
+		{
+			const Program::Value address = MemoryBus::GetAddress(mProgramMemorySize);
+			const size_t count = std::min(MemoryBus::kSize, (size_t)mProgramMemorySize);
+			for (size_t i = 0; i < count; ++i)
+			{
+				mProgram->Poke(address + i, mBus[i]);
+			}
+			mBusIsPending = false;
+		}
+
+		const Program::Value range = (Program::Value)1 << mBitDepth;
+		const double mdenom = block.sampleRate / 1000.0;
+		const double qdenom = (block.sampleRate / (block.tempo / 60.0)) / 128.0;
+
+		mProgram->Set('w', range);
+		mProgram->Set('~', (Program::Value)block.sampleRate);
+
+		size_t nextEvent = 0;
+		Program::Value results[2];
+		for (int s = 0; s < block.frameCount; ++s)
+		{
+			for (; nextEvent < midi.size() && midi[nextEvent].offset <= s; ++nextEvent)
+			{
+				ProcessMidi(midi[nextEvent]);
+			}
+
+			bool run = mTransport == kTransportPlaying;
+
+			switch (mRunMode)
+			{
+			case kRunModeMIDI:
+				run = run && !mNotes.empty(); break;
+			case kRunModeProjectTime:
+				run = block.transportIsRunning != 0;
+				if (run) mTick = (Program::Value)(block.samplePos + s);
+				break;
+			default: break;
+			}
+
+			double left = 0;
+			double right = 0;
+			if (run)
+			{
+				const double inLeft = block.hasInput ? in1[s] : 0;
+				const double inRight = block.hasInput ? in2[s] : 0;
+				mProgram->Set('t', mTick);
+				mProgram->Set('m', (Program::Value)round(mTick / mdenom));
+				mProgram->Set('q', (Program::Value)round(mTick / qdenom));
+				results[0] = (Program::Value)((inLeft + 1) * (range / 2));
+				results[1] = (Program::Value)((inRight + 1) * (range / 2));
+				mProgram->Run(results, 2);
+				left = mGain * (-1.0 + 2.0*((double)(results[0] % range) / (range - 1)));
+				right = mGain * (-1.0 + 2.0*((double)(results[1] % range) / (range - 1)));
+				++mTick;
+			}
+
+			out1[s] = left;
+			out2[s] = right;
+		}
+	}
+
+private:
+	struct Note
+	{
+		uint8_t number;
+		uint8_t velocity;
+	};
+
+	void ProcessMidi(const Recording::MidiEvent& event)
+	{
+		// a note on with a velocity of zero is handled as a note off
+		const int type = (event.status >> 4) == 9 && event.data2 == 0 ? 8 : event.status >> 4;
+		switch (type)
+		{
+		case 9: // note on
+			{
+				if (mMidiNoteResetsTick)
+				{
+					mTick = 0;
+				}
+				const Note note = { event.data1, event.data2 };
+				mNotes.push_back(note);
+				mProgram->Set('n', note.number);
+				mProgram->Set('v', note.velocity);
+			}
+			break;
+
+		case 8: // note off
+			for (auto iter = mNotes.begin(); iter != mNotes.end(); ++iter)
+			{
+				if (iter->number == event.data1)
+				{
+					iter = mNotes.erase(iter);
+					if (iter == mNotes.end())
+					{
+						break;
+					}
+				}
+			}
+
+			if (mNotes.empty())
+			{
+				mProgram->Set('n', 0);
+				mProgram->Set('v', 0);
+			}
+			else
+			{
+				mProgram->Set('n', mNotes.back().number);
+				mProgram->Set('v', mNotes.back().velocity);
+			}
+			break;
+
+		case 11: // control change
+			mProgram->SetCC(event.data1, event.data2);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	Program*		mProgram;
+	std::string		mProgramText;
+	uint64_t		mProgramSeed;
+	int				mProgramMemorySize;
+	bool			mProgramIsValid;
+	TransportState	mTransport;
+	double			mGain;
+	int				mBitDepth;
+	RunMode			mRunMode;
+	bool			mMidiNoteResetsTick;
+	Program::Value	mTick;
+	double			mParams[kNumParams];
+	std::vector<Note> mNotes;
+	// the bus as of the last kRecordBus, which is copied into the program before the next block
+	Program::Value	mBus[MemoryBus::kSize];
+	bool			mBusIsPending;
+};
+
+struct Stats
+{
+	int blocks;
+	int mismatches;
+	uint64_t samples;
+	double seconds; // time spent generating blocks
+	double audioSeconds; // how long the generated blocks take to play
+	double maxLoad; // highest fraction of the real-time budget used by a block
+};
+
+// play the recording at path back, adding to stats. returns false if it couldn't be read.
+bool Replay(const char* path, Stats& stats);
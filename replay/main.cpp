@@ -0,0 +1,86 @@
+//
+//  main.cpp
+//  replay
+//
+//  Plays back a recording made with the RECORD console mode of the plugin without a host or UI,
+//  checks that every block produces exactly the same output as when it was recorded,
+//  and reports how long it took to generate the blocks. Build it with something like:
+//
+//    c++ -std=c++11 -O2 -o replay main.cpp Replay.cpp ../Program.cpp ../Recording.cpp ../MemoryBus.cpp ../RealtimeCheck.cpp
+//
+//  usage: replay [-n iterations] [-r] recording.evr
+//
+//  -r fails the run if anything allocates or locks while generating a block,
+//  which needs a build with -DEVALUATOR_REALTIME_CHECK=1 (and -ldl on Linux).
+//  The blocks are generated by the Engine in Replay.h, not by Evaluator::ProcessDoubleReplacing itself,
+//  which can't run without IPlug and a host. So -r checks the programs and the engine's copy of the block loop,
+//  and anything that only the plugin does around them, eg the scope and the MIDI queue, isn't covered.
+//  To check the plugin, build it with EVALUATOR_REALTIME_CHECK=1 and run it in a host, where the Scope in
+//  ProcessDoubleReplacing reports to stderr.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "../RealtimeCheck.h"
+#include "Replay.h"
+
+int main(int argc, const char * argv[])
+{
+	int iterations = 1;
+	bool realtimeCheck = false;
+	const char* path = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+		{
+			iterations = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-r") == 0)
+		{
+			realtimeCheck = true;
+		}
+		else
+		{
+			path = argv[i];
+		}
+	}
+
+	if (path == nullptr || iterations < 1)
+	{
+		printf("usage: replay [-n iterations] [-r] recording.evr\n");
+		return 1;
+	}
+
+	if (realtimeCheck && !EVALUATOR_REALTIME_CHECK)
+	{
+		printf("-r needs replay to be built with -DEVALUATOR_REALTIME_CHECK=1\n");
+		return 1;
+	}
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		Stats stats = {};
+		if (!Replay(path, stats))
+		{
+			return 1;
+		}
+
+		printf("%d blocks, %llu samples, %.3f s of audio in %.3f s (%.1fx real-time), max block load %.1f%%, %d mismatched\n",
+			stats.blocks, (unsigned long long)stats.samples, stats.audioSeconds, stats.seconds,
+			stats.seconds > 0 ? stats.audioSeconds / stats.seconds : 0, stats.maxLoad * 100, stats.mismatches);
+
+		if (stats.mismatches > 0)
+		{
+			return 2;
+		}
+	}
+
+	if (realtimeCheck && RealtimeCheck::GetViolationCount() > 0)
+	{
+		printf("%u allocations or locks while generating blocks\n", RealtimeCheck::GetViolationCount());
+		return 3;
+	}
+
+	return 0;
+}
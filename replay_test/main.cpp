@@ -0,0 +1,142 @@
+//
+//  main.cpp
+//  replay_test
+//
+//  Makes recordings the same way the plugin does, with a replay Engine standing in for Evaluator,
+//  and checks that replaying them reproduces every block. Each test follows the order that Evaluator
+//  writes records in, so a change to that order belongs here as well. Build and run it from this directory with something like:
+//
+//    c++ -std=c++11 -O2 -o replay_test main.cpp ../replay/Replay.cpp ../Program.cpp ../Recording.cpp ../MemoryBus.cpp && ./replay_test
+//
+
+#include <stdio.h>
+#include <vector>
+#include "../replay/Replay.h"
+
+static const int kMemorySize = 1024 * 64;
+static const int kBlockSize = 64;
+static const char* kPath = "replay_test.evr";
+
+// the plugin side of a recording: an Engine doing what Evaluator does, and the records Evaluator writes about it
+struct Session
+{
+	Engine engine;
+	Recording::Recorder recorder;
+
+	Session()
+	{
+		std::vector<uint8_t> buffer(1 << 22);
+		recorder.Start(buffer);
+	}
+
+	// what Evaluator::RecordState does
+	void RecordState(const uint64_t seed)
+	{
+		engine.GetProgram()->SetRandomSeed(seed);
+		recorder.RecordState(engine.GetTick(), seed, *engine.GetProgram(), std::vector<uint8_t>());
+	}
+
+	void Render(const int blockCount)
+	{
+		Recording::BlockInfo block = { kBlockSize, 0, 1, 44100, 120, 0 };
+		std::vector<double> silence(kBlockSize, 0);
+		std::vector<double> outputs[2] = { std::vector<double>(kBlockSize), std::vector<double>(kBlockSize) };
+		const std::vector<Recording::MidiEvent> midi;
+		for (int b = 0; b < blockCount; ++b)
+		{
+			recorder.RecordBlock(block, silence.data(), silence.data());
+			engine.ProcessDoubleReplacing(block, silence.data(), silence.data(), midi, outputs[0].data(), outputs[1].data());
+			recorder.RecordOutput(outputs[0].data(), outputs[1].data(), kBlockSize);
+			block.samplePos += kBlockSize;
+		}
+	}
+
+	// how many blocks didn't match when replaying what was recorded, or -1 if it couldn't be replayed
+	int Replay()
+	{
+		recorder.Stop();
+		Stats stats = {};
+		if (!recorder.Write(kPath) || !::Replay(kPath, stats))
+		{
+			return -1;
+		}
+		remove(kPath);
+		return stats.mismatches;
+	}
+};
+
+// a preset with saved memory loaded while recording: the program is compiled again, which clears its memory,
+// and then the saved memory is put back, which replay only knows about from the state recorded after it.
+static int LoadMemory(const bool recordState)
+{
+	const char* text = "a = a + 1; [0] = a*3 + @5 + t; [1] = @(t % 64)";
+	Session session;
+	session.engine.Compile(text, kMemorySize, 1);
+	session.recorder.RecordProgram(text, kMemorySize, 1);
+	session.RecordState(2);
+	session.Render(4);
+
+	session.engine.Compile(text, kMemorySize, 3);
+	session.recorder.RecordProgram(text, kMemorySize, 3);
+	std::vector<Program::Value> saved(Program::GetTotalMemorySize(kMemorySize));
+	for (size_t i = 0; i < saved.size(); ++i)
+	{
+		saved[i] = i * 7919;
+	}
+	session.engine.GetProgram()->SetMemory(saved.data());
+	if (recordState)
+	{
+		session.RecordState(4);
+	}
+	session.Render(4);
+
+	return session.Replay();
+}
+
+// a recording started with the value width forced to 32 bits, in the order Evaluator::StartRecording writes it,
+// and in the order it used to, with the program before the parameters, which replay also has to handle.
+static int StartWithWidth(const bool paramsFirst)
+{
+	// the high bits of t*t*t*t*t reach the output through the shift, so the widths sound different
+	const char* text = "[*] = (t*t*t*t*t) >> 20";
+	Session session;
+	session.engine.OnParamChange(kValueWidth, Program::VW_32);
+	session.engine.Compile(text, kMemorySize, 1);
+
+	if (!paramsFirst)
+	{
+		session.recorder.RecordProgram(text, kMemorySize, 0);
+	}
+	session.recorder.RecordParam(kValueWidth, Program::VW_32);
+	if (paramsFirst)
+	{
+		session.recorder.RecordProgram(text, kMemorySize, 0);
+	}
+	session.RecordState(5);
+	session.Render(4);
+
+	return session.Replay();
+}
+
+int main()
+{
+	int failures = 0;
+
+	const int loaded = LoadMemory(true);
+	printf("load memory while recording: %d mismatched %s\n", loaded, loaded == 0 ? "PASSED" : "FAILED");
+	failures += loaded != 0;
+	// without the state after loading, replay has to get it wrong, otherwise the test above doesn't show anything
+	const int unrecorded = LoadMemory(false);
+	printf("load memory without recording it: %d mismatched %s\n", unrecorded, unrecorded > 0 ? "PASSED" : "FAILED");
+	failures += unrecorded <= 0;
+
+	for (int paramsFirst = 1; paramsFirst >= 0; --paramsFirst)
+	{
+		const int narrow = StartWithWidth(paramsFirst != 0);
+		printf("start recording at 32 bits, %s: %d mismatched %s\n", paramsFirst ? "parameters first" : "program first",
+			narrow, narrow == 0 ? "PASSED" : "FAILED");
+		failures += narrow != 0;
+	}
+
+	return failures == 0 ? 0 : 1;
+}
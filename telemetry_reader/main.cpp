@@ -0,0 +1,102 @@
+//
+//  main.cpp
+//  telemetry_reader
+//
+//  Prints the counters that running instances of Evaluator publish to shared memory.
+//  This only works on platforms with POSIX shared memory, build it with something like:
+//
+//    c++ -std=c++11 -o telemetry_reader main.cpp ../Telemetry.cpp
+//
+//  (add -lrt on older Linux systems). Run with -w to keep printing once a second.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../Telemetry.h"
+
+static const char* kErrorNames[Telemetry::kRuntimeErrorCount] =
+{
+	"none", "divide by zero", "missing operand", "missing opcode",
+	"inconsistent stack", "empty program", "get out of bounds", "put out of bounds"
+};
+
+static void PrintInstances(const Telemetry::Segment& segment)
+{
+	int instances = 0;
+	uint64_t memoryBytes = 0;
+	for (int i = 0; i < Telemetry::kMaxInstances; ++i)
+	{
+		const Telemetry::Slot& slot = segment.slots[i];
+		const int pid = slot.pid.load();
+		Telemetry::Counters counters;
+		if (pid == 0 || !Telemetry::Read(slot, counters))
+		{
+			continue;
+		}
+
+		// the owner crashed without releasing its slot
+		if (kill(pid, 0) != 0)
+		{
+			continue;
+		}
+
+		++instances;
+		printf("slot %d (pid %d) program %016llx tier %u\n", i, pid, (unsigned long long)counters.programHash, counters.optimizationTier);
+		printf("  samples %llu in %llu blocks\n", (unsigned long long)counters.samplesRendered, (unsigned long long)counters.blocksRendered);
+		printf("  block time %llu us (max %llu us) load %5.1f%%\n",
+			(unsigned long long)counters.lastBlockMicros,
+			(unsigned long long)counters.maxBlockMicros,
+			counters.averageLoad * 100);
+		printf("  memory %.1f KB\n", counters.memoryBytes / 1024.0);
+		memoryBytes += counters.memoryBytes;
+		for (int e = 1; e < Telemetry::kRuntimeErrorCount; ++e)
+		{
+			if (counters.runtimeErrors[e] > 0)
+			{
+				printf("  %s: %llu\n", kErrorNames[e], (unsigned long long)counters.runtimeErrors[e]);
+			}
+		}
+	}
+
+	printf("%d running instance(s) using %.1f KB\n\n", instances, memoryBytes / 1024.0);
+	fflush(stdout);
+}
+
+int main(int argc, const char * argv[])
+{
+	const bool watch = argc > 1 && strcmp(argv[1], "-w") == 0;
+
+	const int fd = shm_open(Telemetry::kSegmentName, O_RDONLY, 0);
+	if (fd < 0)
+	{
+		printf("No telemetry found, is Evaluator running?\n");
+		return 1;
+	}
+
+	void* memory = mmap(nullptr, sizeof(Telemetry::Segment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED)
+	{
+		printf("Couldn't map %s\n", Telemetry::kSegmentName);
+		return 1;
+	}
+
+	const Telemetry::Segment& segment = *static_cast<const Telemetry::Segment*>(memory);
+	if (segment.version.load() != Telemetry::kSegmentVersion)
+	{
+		printf("Telemetry version %u is not supported, expected %u\n", segment.version.load(), Telemetry::kSegmentVersion);
+		return 1;
+	}
+
+	do
+	{
+		PrintInstances(segment);
+	} while (watch && sleep(1) == 0);
+
+	munmap(memory, sizeof(Telemetry::Segment));
+	return 0;
+}